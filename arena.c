@@ -0,0 +1,126 @@
+#include "arena.h"
+#include <stdio.h>
+#if defined(WIN32)
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+arena_t null_arena(void)
+{
+	arena_t result;
+	result.base = NULL;
+	result.capacity = 0;
+	result.used = 0;
+	result.mapped_size = 0;
+	result.huge_pages = false;
+	return result;
+}
+
+#if defined(WIN32)
+static void* map_pages(size_t capacity, bool huge_pages, size_t* mapped_size)
+{
+	// Large pages need the lock pages privilege; without it, map normally
+	const size_t large_page_size = GetLargePageMinimum();
+	if (huge_pages && (large_page_size > 0))
+	{
+		const size_t size = ((capacity + large_page_size - 1) / large_page_size) * large_page_size;
+		void* pages = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (pages != NULL)
+		{
+			*mapped_size = size;
+			return pages;
+		}
+	}
+	*mapped_size = capacity;
+	return VirtualAlloc(NULL, capacity, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+static void unmap_pages(void* pages, size_t mapped_size)
+{
+	(void)mapped_size;
+	VirtualFree(pages, 0, MEM_RELEASE);
+}
+#else
+static void* map_pages(size_t capacity, bool huge_pages, size_t* mapped_size)
+{
+	const size_t huge_size = ((capacity + ARENA_HUGE_PAGE_SIZE - 1) / ARENA_HUGE_PAGE_SIZE) * ARENA_HUGE_PAGE_SIZE;
+#if defined(MAP_HUGETLB)
+	// Explicit huge pages only exist if some were reserved
+	if (huge_pages)
+	{
+		void* pages = mmap(NULL, huge_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (pages != MAP_FAILED)
+		{
+			*mapped_size = huge_size;
+			return pages;
+		}
+	}
+#endif
+
+	// Otherwise ask for transparent ones over a whole number of them
+	const size_t size = (huge_pages ? huge_size : capacity);
+	void* pages = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pages == MAP_FAILED)
+	{
+		return NULL;
+	}
+	*mapped_size = size;
+#if defined(MADV_HUGEPAGE)
+	if (huge_pages)
+	{
+		madvise(pages, size, MADV_HUGEPAGE);
+	}
+#endif
+	return pages;
+}
+
+static void unmap_pages(void* pages, size_t mapped_size)
+{
+	munmap(pages, mapped_size);
+}
+#endif
+
+bool create_arena(size_t capacity, bool huge_pages, arena_t* out)
+{
+	*out = null_arena();
+	if (capacity == 0)
+	{
+		return true;
+	}
+
+	size_t mapped_size;
+	void* pages = map_pages(capacity, huge_pages, &mapped_size);
+	if (pages == NULL)
+	{
+		printf("Failed to map arena of %u bytes.\n", (unsigned int)capacity);
+		return false;
+	}
+	out->base = (uint8_t*)pages;
+	out->capacity = capacity;
+	out->mapped_size = mapped_size;
+	out->huge_pages = huge_pages;
+	return true;
+}
+
+void destroy_arena(arena_t* arena)
+{
+	if (arena->base != NULL)
+	{
+		unmap_pages(arena->base, arena->mapped_size);
+	}
+	*arena = null_arena();
+}
+
+void* allocate_arena(arena_t* arena, size_t size)
+{
+	// Fresh pages are zeroed, and nothing carved out is ever handed back
+	const size_t aligned_size = ALIGN_ARENA(size);
+	if ((arena->base == NULL) || (aligned_size > arena->capacity - arena->used))
+	{
+		return NULL;
+	}
+	void* result = arena->base + arena->used;
+	arena->used += aligned_size;
+	return result;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Every allocation starts on its own cache line
+#define ARENA_ALIGNMENT 64
+#define ALIGN_ARENA(size) (((size) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+// Size of the pages huge mappings are rounded up to
+#define ARENA_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// One mapping that buffers living as long as their owner are carved from in
+// order, so they sit together in memory rather than scattered over the heap.
+// With huge pages, explicit ones are tried first, then transparent ones.
+typedef struct arena
+{
+	uint8_t* base;
+	size_t capacity;
+	size_t used;
+	size_t mapped_size;
+	bool huge_pages;
+} arena_t;
+
+arena_t null_arena(void);
+
+// Capacity is the sum of ALIGN_ARENA of every allocation to be made
+bool create_arena(size_t capacity, bool huge_pages, arena_t* out);
+void destroy_arena(arena_t* arena);
+
+// Zeroed and aligned to ARENA_ALIGNMENT; NULL once the capacity is used up
+void* allocate_arena(arena_t* arena, size_t size);
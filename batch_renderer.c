@@ -0,0 +1,535 @@
+#include "batch_renderer.h"
+#include "chord_cache.h"
+#include "reduce.h"
+#include "shared.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BATCH_LINE_VERTEX_SHADER "batch_line.vertex"
+#define BATCH_LINE_GEOMETRY_SHADER "batch_line.geometry"
+#define BATCH_LINE_FRAGMENT_SHADER "batch_line.fragment"
+#define BATCH_QUAD_VERTEX_SHADER "batch_quad.vertex"
+#define BATCH_QUAD_GEOMETRY_SHADER "batch_quad.geometry"
+#define BATCH_BLUR_FRAGMENT_SHADER "batch_blur.fragment"
+#define BATCH_TEXTURE_FRAGMENT_SHADER "batch_texture.fragment"
+#define BATCH_REDUCE_FRAGMENT_SHADER "batch_reduce.fragment"
+
+// Every quad is a four vertex strip built from the vertex index
+#define QUAD_VERTEX_COUNT 4
+
+batch_renderer_t null_batch_renderer(void)
+{
+	batch_renderer_t result;
+	result.line_material = null_material();
+	result.blur_material = null_material();
+	result.texture_material = null_material();
+	result.reduce_material = null_material();
+	result.vertex_array = INVALID_VERTEX_ARRAY;
+	result.vertices = NULL;
+	result.vertex_count = 0;
+	result.chord_buffer = INVALID_BUFFER;
+	result.chords = NULL;
+	result.chord_capacity = 0;
+	result.layer_count = 0;
+	result.line_texture = INVALID_TEXTURE;
+	result.line_frame_buffer = INVALID_BUFFER;
+	result.blur_texture = INVALID_TEXTURE;
+	result.blur_frame_buffer = INVALID_BUFFER;
+	result.score_texture = INVALID_TEXTURE;
+	result.score_frame_buffer = INVALID_BUFFER;
+	const blur_kernel_t no_blur = { 0 };
+	result.blur_across = no_blur;
+	result.blur_down = no_blur;
+	result.gpu_reduce = false;
+	result.readback_buffer = INVALID_BUFFER;
+	for (size_t i = 0; i < MAXIMUM_REDUCE_LEVELS; ++i)
+	{
+		result.reduce_frame_buffers[i] = INVALID_BUFFER;
+		result.reduce_textures[i] = INVALID_TEXTURE;
+		result.reduce_widths[i] = 0;
+		result.reduce_heights[i] = 0;
+	}
+	result.reduce_level_count = 0;
+	result.score_texels = NULL;
+	result.profiler = NULL;
+	return result;
+}
+
+// Texture array with a frame buffer drawing into every layer at once
+static bool create_layered_target
+(
+	GLsizei width,
+	GLsizei height,
+	GLsizei layer_count,
+	GLint internal_format,
+	GLenum format,
+	GLenum type,
+	GLuint* texture_out,
+	GLuint* frame_buffer_out
+)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internal_format, width, height, layer_count, 0, format, type, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	*texture_out = texture;
+
+	GLuint frame_buffer;
+	glGenFramebuffers(1, &frame_buffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0);
+	*frame_buffer_out = frame_buffer;
+	const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		printf("Layered render target incomplete (0x%x).\n", status);
+		return false;
+	}
+	return true;
+}
+
+static bool create_batch_reduction(batch_renderer_t* renderer)
+{
+	if (!create_layered_material(BATCH_QUAD_MATERIAL, BATCH_QUAD_VERTEX_SHADER, BATCH_QUAD_GEOMETRY_SHADER, BATCH_REDUCE_FRAGMENT_SHADER, &renderer->reduce_material))
+	{
+		printf("Failed to create batch reduce material.\n");
+		return false;
+	}
+
+	// Every pass down to the small levels read back and summed in double
+	GLint width = APPLICATION_WIDTH;
+	GLint height = APPLICATION_HEIGHT;
+	while ((width > REDUCE_READBACK_SIZE) || (height > REDUCE_READBACK_SIZE))
+	{
+		width = (width + REDUCE_FACTOR - 1) / REDUCE_FACTOR;
+		height = (height + REDUCE_FACTOR - 1) / REDUCE_FACTOR;
+		const size_t level = renderer->reduce_level_count;
+		if (level == MAXIMUM_REDUCE_LEVELS)
+		{
+			printf("Too many batch reduction levels.\n");
+			return false;
+		}
+		if (!create_layered_target(width, height, (GLsizei)renderer->layer_count, GL_R32F, GL_RED, GL_FLOAT, &renderer->reduce_textures[level], &renderer->reduce_frame_buffers[level]))
+		{
+			printf("Failed to create batch reduction level.\n");
+			return false;
+		}
+		renderer->reduce_widths[level] = width;
+		renderer->reduce_heights[level] = height;
+		++renderer->reduce_level_count;
+	}
+
+	renderer->score_texels = (GLfloat*)malloc(renderer->layer_count * (size_t)(width * height) * sizeof(GLfloat));
+	if (renderer->score_texels == NULL)
+	{
+		printf("Failed to allocate batch scores.\n");
+		return false;
+	}
+	return true;
+}
+
+bool create_batch_renderer
+(
+	const vector2d_t* vertices,
+	size_t vertex_count,
+	size_t layer_count,
+	bool gpu_reduce,
+	batch_renderer_t* out
+)
+{
+	out->vertices = vertices;
+	out->vertex_count = vertex_count;
+	out->layer_count = layer_count;
+	out->gpu_reduce = gpu_reduce;
+
+	GLint maximum_layers = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maximum_layers);
+	if ((size_t)maximum_layers < layer_count)
+	{
+		printf("Batch of %u candidates exceeds %d texture array layers.\n", (unsigned int)layer_count, maximum_layers);
+		return false;
+	}
+
+	if (!create_layered_material(BATCH_LINE_MATERIAL, BATCH_LINE_VERTEX_SHADER, BATCH_LINE_GEOMETRY_SHADER, BATCH_LINE_FRAGMENT_SHADER, &out->line_material))
+	{
+		printf("Failed to create batch line material.\n");
+		return false;
+	}
+	else if (!create_layered_material(BATCH_QUAD_MATERIAL, BATCH_QUAD_VERTEX_SHADER, BATCH_QUAD_GEOMETRY_SHADER, BATCH_BLUR_FRAGMENT_SHADER, &out->blur_material))
+	{
+		printf("Failed to create batch blur material.\n");
+		return false;
+	}
+	else if (!create_layered_material(BATCH_QUAD_MATERIAL, BATCH_QUAD_VERTEX_SHADER, BATCH_QUAD_GEOMETRY_SHADER, BATCH_TEXTURE_FRAGMENT_SHADER, &out->texture_material))
+	{
+		printf("Failed to create batch texture material.\n");
+		return false;
+	}
+
+	// Instance attributes live in their own vertex array, away from the
+	// per-vertex layout the other materials use; the quads need none
+	glGenBuffers(1, &out->chord_buffer);
+	if (!create_vertex_array(BATCH_LINE_MATERIAL, out->chord_buffer, 0, &out->vertex_array))
+	{
+		printf("Failed to create batch vertex array.\n");
+		return false;
+	}
+	out->chord_capacity = layer_count * LINES_INDEX_COUNT;
+	out->chords = (batch_chord_t*)malloc(out->chord_capacity * sizeof(batch_chord_t));
+	if (out->chords == NULL)
+	{
+		printf("Failed to allocate batch chords.\n");
+		return false;
+	}
+
+	if (!create_layered_target(TEXTURE_WIDTH, TEXTURE_HEIGHT, (GLsizei)layer_count, GL_R8, GL_RED, GL_UNSIGNED_BYTE, &out->line_texture, &out->line_frame_buffer))
+	{
+		printf("Failed to create batch line target.\n");
+		return false;
+	}
+	else if (!create_layered_target(APPLICATION_WIDTH, TEXTURE_HEIGHT, (GLsizei)layer_count, GL_R32F, GL_RED, GL_FLOAT, &out->blur_texture, &out->blur_frame_buffer))
+	{
+		printf("Failed to create batch blur target.\n");
+		return false;
+	}
+	else if (!create_layered_target(APPLICATION_WIDTH, APPLICATION_HEIGHT, (GLsizei)layer_count, GL_R32F, GL_RED, GL_FLOAT, &out->score_texture, &out->score_frame_buffer))
+	{
+		printf("Failed to create batch score target.\n");
+		return false;
+	}
+
+	// Both blur passes read between texels, with the same kernels the
+	// single-candidate path uses at full size
+	glBindTexture(GL_TEXTURE_2D_ARRAY, out->line_texture);
+	set_texture_filtering(GL_TEXTURE_2D_ARRAY, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, out->blur_texture);
+	set_texture_filtering(GL_TEXTURE_2D_ARRAY, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	const float sigma = get_blur_sigma(SAMPLE_RADIUS);
+	out->blur_across = create_blur_kernel((float)TEXTURE_WIDTH / (float)APPLICATION_WIDTH, sigma);
+	out->blur_down = create_blur_kernel((float)TEXTURE_HEIGHT / (float)APPLICATION_HEIGHT, sigma);
+
+	if (gpu_reduce)
+	{
+		if (!create_batch_reduction(out))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		// Every layer's difference image is read back with one copy
+		const GLsizeiptr readback_size = (GLsizeiptr)(layer_count * APPLICATION_PIXEL_COUNT * sizeof(GLfloat));
+		glGenBuffers(1, &out->readback_buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, out->readback_buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, readback_size, NULL, GL_STREAM_READ);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+	const GLenum error = glGetError();
+	if (error != GL_NO_ERROR)
+	{
+		printf("Failed to create batch renderer: %d (0x%x)\n", error, error);
+		return false;
+	}
+	return true;
+}
+
+void destroy_batch_renderer(batch_renderer_t* renderer)
+{
+	destroy_material(&renderer->line_material);
+	destroy_material(&renderer->blur_material);
+	destroy_material(&renderer->texture_material);
+	destroy_material(&renderer->reduce_material);
+	destroy_vertex_array(&renderer->vertex_array);
+	if (renderer->chord_buffer != INVALID_BUFFER)
+	{
+		glDeleteBuffers(1, &renderer->chord_buffer);
+		renderer->chord_buffer = INVALID_BUFFER;
+	}
+	free(renderer->chords);
+	renderer->chords = NULL;
+	renderer->chord_capacity = 0;
+
+	if (renderer->line_texture != INVALID_TEXTURE)
+	{
+		glDeleteTextures(1, &renderer->line_texture);
+		renderer->line_texture = INVALID_TEXTURE;
+	}
+	if (renderer->line_frame_buffer != INVALID_BUFFER)
+	{
+		glDeleteFramebuffers(1, &renderer->line_frame_buffer);
+		renderer->line_frame_buffer = INVALID_BUFFER;
+	}
+	if (renderer->blur_texture != INVALID_TEXTURE)
+	{
+		glDeleteTextures(1, &renderer->blur_texture);
+		renderer->blur_texture = INVALID_TEXTURE;
+	}
+	if (renderer->blur_frame_buffer != INVALID_BUFFER)
+	{
+		glDeleteFramebuffers(1, &renderer->blur_frame_buffer);
+		renderer->blur_frame_buffer = INVALID_BUFFER;
+	}
+	if (renderer->score_texture != INVALID_TEXTURE)
+	{
+		glDeleteTextures(1, &renderer->score_texture);
+		renderer->score_texture = INVALID_TEXTURE;
+	}
+	if (renderer->score_frame_buffer != INVALID_BUFFER)
+	{
+		glDeleteFramebuffers(1, &renderer->score_frame_buffer);
+		renderer->score_frame_buffer = INVALID_BUFFER;
+	}
+
+	if (renderer->readback_buffer != INVALID_BUFFER)
+	{
+		glDeleteBuffers(1, &renderer->readback_buffer);
+		renderer->readback_buffer = INVALID_BUFFER;
+	}
+	for (size_t i = 0; i < renderer->reduce_level_count; ++i)
+	{
+		glDeleteTextures(1, &renderer->reduce_textures[i]);
+		glDeleteFramebuffers(1, &renderer->reduce_frame_buffers[i]);
+		renderer->reduce_textures[i] = INVALID_TEXTURE;
+		renderer->reduce_frame_buffers[i] = INVALID_BUFFER;
+	}
+	renderer->reduce_level_count = 0;
+	free(renderer->score_texels);
+	renderer->score_texels = NULL;
+}
+
+// Collects the chords of every candidate, tagged with the candidate's layer
+static bool gather_chords(batch_renderer_t* renderer, generation_t* candidates, size_t candidate_count, size_t* out)
+{
+	const vector2d_t* vertices = renderer->vertices;
+	batch_chord_t* chords = renderer->chords;
+	size_t chord_count = 0;
+	for (size_t i = 0; i < candidate_count; ++i)
+	{
+		generation_t* candidate = &candidates[i];
+		const nail_t* nails = get_generation_nails(candidate);
+		if (nails == NULL)
+		{
+			printf("Failed to export candidate nails.\n");
+			return false;
+		}
+		const size_t nail_count = get_generation_length(candidate);
+		const GLfloat layer = (GLfloat)i;
+		for (size_t j = 1; j < nail_count; ++j)
+		{
+			assert(chord_count < renderer->chord_capacity);
+			batch_chord_t* chord = &chords[chord_count++];
+			chord->start = vertices[nails[j - 1]];
+			chord->end = vertices[nails[j]];
+			chord->layer = layer;
+		}
+	}
+	*out = chord_count;
+	return true;
+}
+
+bool render_batch(batch_renderer_t* renderer, generation_t* candidates, size_t candidate_count, GLuint image_texture)
+{
+	assert(candidate_count <= renderer->layer_count);
+	profile_span_t span = begin_span(renderer->profiler, PROFILE_UPLOAD);
+	size_t chord_count;
+	if (!gather_chords(renderer, candidates, candidate_count, &chord_count))
+	{
+		end_span(renderer->profiler, span);
+		return false;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, renderer->chord_buffer);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(chord_count * sizeof(batch_chord_t)), renderer->chords, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	end_span(renderer->profiler, span);
+
+	// Every chord of every candidate in one draw
+	span = begin_span(renderer->profiler, PROFILE_LINES);
+	material_t* line_material = &renderer->line_material;
+	activate_material(line_material, renderer->vertex_array);
+	bool success = set_canvas_size(line_material, (GLfloat)TEXTURE_WIDTH, (GLfloat)TEXTURE_HEIGHT)
+		&& set_line_reach(line_material, LINE_REACH);
+	if (success)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, renderer->line_frame_buffer);
+		glViewport(0, 0, TEXTURE_WIDTH, TEXTURE_HEIGHT);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, QUAD_VERTEX_COUNT, (GLsizei)chord_count);
+	}
+	else
+	{
+		printf("Failed to set batch line shader parameters.\n");
+	}
+	end_span(renderer->profiler, span);
+
+	// Every layer blurred across in one draw, then down as the difference is
+	// taken in another
+	span = begin_span(renderer->profiler, PROFILE_BLUR);
+	material_t* blur_material = &renderer->blur_material;
+	activate_material(blur_material, renderer->vertex_array);
+	success = success
+		&& set_line_texture(blur_material, GL_TEXTURE_2D_ARRAY, renderer->line_texture)
+		&& set_blur_kernel(blur_material, &renderer->blur_across)
+		&& set_layer_offset(blur_material, 0);
+	if (success)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, renderer->blur_frame_buffer);
+		glViewport(0, 0, APPLICATION_WIDTH, TEXTURE_HEIGHT);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, QUAD_VERTEX_COUNT, (GLsizei)candidate_count);
+	}
+	else
+	{
+		printf("Failed to set batch blur shader parameters.\n");
+	}
+
+	material_t* texture_material = &renderer->texture_material;
+	activate_material(texture_material, renderer->vertex_array);
+	success = success
+		&& set_texture_array(texture_material, renderer->blur_texture, image_texture)
+		&& set_blur_kernel(texture_material, &renderer->blur_down)
+		&& set_mode(texture_material, 0)
+		&& set_layer_offset(texture_material, 0);
+	if (success)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, renderer->score_frame_buffer);
+		glViewport(0, 0, APPLICATION_WIDTH, APPLICATION_HEIGHT);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, QUAD_VERTEX_COUNT, (GLsizei)candidate_count);
+	}
+	else
+	{
+		printf("Failed to set batch texture shader parameters.\n");
+	}
+	end_span(renderer->profiler, span);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	return success;
+}
+
+// Sums each layer down to a small level, reads them all at once and
+// finishes the sums in double
+static bool reduce_batch(batch_renderer_t* renderer, generation_t* candidates, size_t candidate_count)
+{
+	material_t* material = &renderer->reduce_material;
+	activate_material(material, renderer->vertex_array);
+	if (!set_layer_offset(material, 0))
+	{
+		printf("Failed to activate batch reduce material.\n");
+		return false;
+	}
+
+	// Sums are written as they are
+	profile_span_t span = begin_span(renderer->profiler, PROFILE_SCORE);
+	glDisable(GL_BLEND);
+	GLuint source = renderer->score_texture;
+	GLint source_width = APPLICATION_WIDTH;
+	GLint source_height = APPLICATION_HEIGHT;
+	bool success = true;
+	for (size_t i = 0; success && (i < renderer->reduce_level_count); ++i)
+	{
+		success = set_reduce_source(material, GL_TEXTURE_2D_ARRAY, source, source_width, source_height);
+		if (success)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, renderer->reduce_frame_buffers[i]);
+			glViewport(0, 0, renderer->reduce_widths[i], renderer->reduce_heights[i]);
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, QUAD_VERTEX_COUNT, (GLsizei)candidate_count);
+		}
+		source = renderer->reduce_textures[i];
+		source_width = renderer->reduce_widths[i];
+		source_height = renderer->reduce_heights[i];
+	}
+	glEnable(GL_BLEND);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	end_span(renderer->profiler, span);
+	if (!success)
+	{
+		return false;
+	}
+
+	span = begin_span(renderer->profiler, PROFILE_READBACK);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, source);
+	glGetTexImage(GL_TEXTURE_2D_ARRAY, 0, GL_RED, GL_FLOAT, renderer->score_texels);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	end_span(renderer->profiler, span);
+	const GLenum error = glGetError();
+	if (error != GL_NO_ERROR)
+	{
+		printf("Failed to read batch scores: %d (0x%x)\n", error, error);
+		return false;
+	}
+	const size_t texel_count = (size_t)(source_width * source_height);
+	for (size_t i = 0; i < candidate_count; ++i)
+	{
+		candidates[i].score = sum_floats(renderer->score_texels + (i * texel_count), texel_count);
+	}
+	return true;
+}
+
+bool score_batch(batch_renderer_t* renderer, thread_pool_t* pool, generation_t* candidates, size_t candidate_count)
+{
+	assert(candidate_count <= renderer->layer_count);
+	if (renderer->gpu_reduce)
+	{
+		return reduce_batch(renderer, candidates, candidate_count);
+	}
+
+	// Copy every layer, then sum them in parallel straight from the mapping
+	const GLsizeiptr readback_size = (GLsizeiptr)(renderer->layer_count * APPLICATION_PIXEL_COUNT * sizeof(GLfloat));
+	profile_span_t span = begin_span(renderer->profiler, PROFILE_READBACK);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, renderer->score_texture);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, renderer->readback_buffer);
+	glGetTexImage(GL_TEXTURE_2D_ARRAY, 0, GL_RED, GL_FLOAT, NULL);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	const GLfloat* pixels = (const GLfloat*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, readback_size, GL_MAP_READ_BIT);
+	end_span(renderer->profiler, span);
+	if (pixels == NULL)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		printf("Failed to map batch readback buffer.\n");
+		return false;
+	}
+
+	span = begin_cpu_span(renderer->profiler, PROFILE_SCORE);
+	for (size_t i = 0; i < candidate_count; ++i)
+	{
+		candidates[i].score_pixels = pixels + (i * APPLICATION_PIXEL_COUNT);
+		candidates[i].score_pixel_count = APPLICATION_PIXEL_COUNT;
+	}
+	set_score_cutoffs(candidates, candidate_count, true);
+	run_tasks(pool, &compute_score, candidates, sizeof(generation_t), candidate_count);
+	for (size_t i = 0; i < candidate_count; ++i)
+	{
+		candidates[i].score_pixels = NULL;
+	}
+
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	end_span(renderer->profiler, span);
+	return true;
+}
+
+bool draw_batch_layer(batch_renderer_t* renderer, size_t layer, GLint mode, GLuint image_texture)
+{
+	assert(layer < renderer->layer_count);
+	material_t* material = &renderer->texture_material;
+	activate_material(material, renderer->vertex_array);
+	const bool success = set_texture_array(material, renderer->blur_texture, image_texture)
+		&& set_blur_kernel(material, &renderer->blur_down)
+		&& set_mode(material, mode)
+		&& set_layer_offset(material, (GLint)layer);
+	if (!success)
+	{
+		printf("Failed to set batch texture shader parameters.\n");
+		return false;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, APPLICATION_WIDTH, APPLICATION_HEIGHT);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, QUAD_VERTEX_COUNT, 1);
+	return true;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "blur.h"
+#include "generation.h"
+#include "graphics.h"
+#include "material.h"
+#include "profiler.h"
+#include "thread_pool.h"
+#include "vector2d.h"
+#include <GL/glew.h>
+#include <GL/gl.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Line between two nails, drawn as one quad instance into a candidate's layer
+typedef struct batch_chord
+{
+	vector2d_t start;
+	vector2d_t end;
+	GLfloat layer;
+} batch_chord_t;
+
+// Renders and scores a whole generation at once. Each candidate draws into
+// its own layer of a texture array, so the line, blur and difference passes
+// take the same number of draw calls however many candidates there are.
+typedef struct batch_renderer
+{
+	material_t line_material;
+	material_t blur_material;
+	material_t texture_material;
+	material_t reduce_material;
+	GLuint vertex_array;
+
+	// Nail positions in texture space; owned by the caller
+	const vector2d_t* vertices;
+	size_t vertex_count;
+
+	// Chords of every candidate, uploaded once per generation
+	GLuint chord_buffer;
+	batch_chord_t* chords;
+	size_t chord_capacity;
+
+	// One line canvas, lines blurred across at the output width and one
+	// difference image per candidate
+	size_t layer_count;
+	GLuint line_texture;
+	GLuint line_frame_buffer;
+	GLuint blur_texture;
+	GLuint blur_frame_buffer;
+	GLuint score_texture;
+	GLuint score_frame_buffer;
+
+	// Kernels of both passes of the separable blur, as the GL context's
+	blur_kernel_t blur_across;
+	blur_kernel_t blur_down;
+
+	// Difference images are either read back together and summed on the
+	// pool, or reduced on the GPU down to a small level per layer that is
+	// read back and summed in double
+	bool gpu_reduce;
+	GLuint readback_buffer;
+	GLuint reduce_frame_buffers[MAXIMUM_REDUCE_LEVELS];
+	GLuint reduce_textures[MAXIMUM_REDUCE_LEVELS];
+	GLint reduce_widths[MAXIMUM_REDUCE_LEVELS];
+	GLint reduce_heights[MAXIMUM_REDUCE_LEVELS];
+	size_t reduce_level_count;
+	GLfloat* score_texels;
+
+	// Stages are timed here when set; owned by the caller
+	profiler_t* profiler;
+} batch_renderer_t;
+
+batch_renderer_t null_batch_renderer(void);
+bool create_batch_renderer
+(
+	const vector2d_t* vertices,
+	size_t vertex_count,
+	size_t layer_count,
+	bool gpu_reduce,
+	batch_renderer_t* out
+);
+void destroy_batch_renderer(batch_renderer_t* renderer);
+
+// Draws every candidate into its layer, then its difference image against
+// the target. Leaves the window frame buffer bound.
+bool render_batch(batch_renderer_t* renderer, generation_t* candidates, size_t candidate_count, GLuint image_texture);
+
+// Sets the score of every candidate rendered by the last batch. Offspring
+// worse than every survivor get partial scores that still rank after them.
+bool score_batch(batch_renderer_t* renderer, thread_pool_t* pool, generation_t* candidates, size_t candidate_count);
+
+// Draws a layer to the window with the texture shader's mode
+bool draw_batch_layer(batch_renderer_t* renderer, size_t layer, GLint mode, GLuint image_texture);
@@ -0,0 +1,656 @@
+#include "batch_renderer.h"
+#include "config.h"
+#include "generation.h"
+#include "graphics.h"
+#include "image.h"
+#include "island.h"
+#include "random.h"
+#include "reduce.h"
+#include "shared.h"
+#include "software_renderer.h"
+#include "target.h"
+#include "thread_pool.h"
+#include <SDL.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Calls timed per measurement; the fastest run is reported
+#define BENCHMARK_ITERATIONS 200
+#define BENCHMARK_SEED 12345u
+
+// Genome edits timed per run, and runs of them per measurement
+#define BENCHMARK_EDITS 10000
+#define BENCHMARK_EDIT_RUNS 20
+
+// Target uploads and batch renders per measurement; each waits on the GPU
+#define BENCHMARK_GL_ITERATIONS 20
+
+// Target preparations per measurement
+#define BENCHMARK_TARGET_ITERATIONS 20
+
+// Generations each search workload runs unless told otherwise
+#define BENCHMARK_GENERATIONS 100
+
+// Size of the synthetic target, independent of the resolution scored at
+#define BENCHMARK_TARGET_SIZE 512
+
+#define GENERATIONS_ARGUMENT "--generations"
+#define OUTPUT_ARGUMENT "--output"
+#define GL_ARGUMENT "--gl"
+#define BENCHMARK_OUTPUT "benchmark.json"
+
+#define MAXIMUM_RESULTS 32
+#define MAXIMUM_METRICS 8
+#define RESULT_NAME_LENGTH 32
+
+typedef struct benchmark_metric
+{
+	const char* name;
+	double value;
+} benchmark_metric_t;
+
+// Named measurement with the metrics it reports
+typedef struct benchmark_result
+{
+	char name[RESULT_NAME_LENGTH];
+	benchmark_metric_t metrics[MAXIMUM_METRICS];
+	size_t metric_count;
+} benchmark_result_t;
+
+typedef struct benchmark_report
+{
+	benchmark_result_t results[MAXIMUM_RESULTS];
+	size_t result_count;
+} benchmark_report_t;
+
+static double get_seconds(void)
+{
+	return (double)SDL_GetPerformanceCounter() / (double)SDL_GetPerformanceFrequency();
+}
+
+static benchmark_result_t* add_result(benchmark_report_t* report, const char* name)
+{
+	if (report->result_count == MAXIMUM_RESULTS)
+	{
+		return NULL;
+	}
+	benchmark_result_t* result = &report->results[report->result_count++];
+	snprintf(result->name, RESULT_NAME_LENGTH, "%s", name);
+	result->metric_count = 0;
+	return result;
+}
+
+static void add_metric(benchmark_result_t* result, const char* name, double value)
+{
+	if ((result != NULL) && (result->metric_count < MAXIMUM_METRICS))
+	{
+		benchmark_metric_t* metric = &result->metrics[result->metric_count++];
+		metric->name = name;
+		metric->value = value;
+	}
+}
+
+static void print_result(const benchmark_result_t* result)
+{
+	if (result == NULL)
+	{
+		return;
+	}
+	printf("%-22s", result->name);
+	for (size_t i = 0; i < result->metric_count; ++i)
+	{
+		printf(" %s %.6g", result->metrics[i].name, result->metrics[i].value);
+	}
+	printf("\n");
+}
+
+// One object per result, keyed by name, so runs can be diffed by script
+static bool write_report(const benchmark_report_t* report, const char* filename, uint64_t seed, bool gl)
+{
+	FILE* file = fopen(filename, "w");
+	if (file == NULL)
+	{
+		printf("Failed to open benchmark output %s.\n", filename);
+		return false;
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"seed\": %llu,\n", (unsigned long long)seed);
+	fprintf(file, "\t\"threads\": %d,\n", (int)get_processor_count());
+	fprintf(file, "\t\"simd\": \"%s\",\n", get_simd_level_name(get_supported_simd_level()));
+	fprintf(file, "\t\"gl\": %s,\n", gl ? "true" : "false");
+	fprintf(file, "\t\"config\": {\"width\": %d, \"height\": %d, \"scale\": %d, \"nails\": %d, \"lines\": %d, \"fittest\": %d, \"offspring\": %d, \"sample_radius\": %d},\n",
+		config.application_width,
+		config.application_height,
+		config.scale_factor,
+		config.point_count,
+		config.lines,
+		config.fittest_count,
+		config.offspring_per_fittest,
+		config.sample_radius);
+	fprintf(file, "\t\"results\": {\n");
+	for (size_t i = 0; i < report->result_count; ++i)
+	{
+		const benchmark_result_t* result = &report->results[i];
+		fprintf(file, "\t\t\"%s\": {", result->name);
+		for (size_t j = 0; j < result->metric_count; ++j)
+		{
+			// JSON has no infinities or NaNs
+			const double value = result->metrics[j].value;
+			fprintf(file, "%s\"%s\": %.17g", (j == 0) ? "" : ", ", result->metrics[j].name, isfinite(value) ? value : 0.0);
+		}
+		fprintf(file, "}%s\n", (i + 1 < report->result_count) ? "," : "");
+	}
+	fprintf(file, "\t}\n");
+	fprintf(file, "}\n");
+
+	const bool success = (fclose(file) == 0);
+	if (!success)
+	{
+		printf("Failed to write benchmark output %s.\n", filename);
+	}
+	return success;
+}
+
+static int parse_generations(int argc, char** argv)
+{
+	const char* text = find_argument_value(argc, argv, GENERATIONS_ARGUMENT);
+	const int generations = (text != NULL ? atoi(text) : 0);
+	return (generations > 0) ? generations : BENCHMARK_GENERATIONS;
+}
+
+static const char* parse_output(int argc, char** argv)
+{
+	const char* output = find_argument_value(argc, argv, OUTPUT_ARGUMENT);
+	return (output != NULL ? output : BENCHMARK_OUTPUT);
+}
+
+// Fixed sequence so every run sums the same values
+static void fill_errors(float* values, size_t count)
+{
+	uint32_t state = BENCHMARK_SEED;
+	for (size_t i = 0; i < count; ++i)
+	{
+		state = (state * 1664525u) + 1013904223u;
+		values[i] = (float)(state >> 8) / (float)(1u << 24);
+	}
+}
+
+// Concentric rings with a soft radial falloff, so every run searches
+// towards the same picture without needing an image file
+static bool create_benchmark_target(image_t* out)
+{
+	const int size = BENCHMARK_TARGET_SIZE;
+	float* pixels = (float*)malloc((size_t)size * (size_t)size * sizeof(float));
+	if (pixels == NULL)
+	{
+		printf("Failed to allocate benchmark target.\n");
+		return false;
+	}
+
+	const float centre = (float)size * 0.5f;
+	for (int y = 0; y < size; ++y)
+	{
+		for (int x = 0; x < size; ++x)
+		{
+			const float dx = ((float)x + 0.5f - centre) / centre;
+			const float dy = ((float)y + 0.5f - centre) / centre;
+			const float radius = sqrtf((dx * dx) + (dy * dy));
+			const float rings = 0.5f + (0.5f * cosf(radius * 18.f));
+			const float falloff = (radius < 1.f) ? radius : 1.f;
+			pixels[(y * size) + x] = (rings * (1.f - falloff)) + falloff;
+		}
+	}
+
+	out->pixels = pixels;
+	out->width = size;
+	out->height = size;
+	return true;
+}
+
+// Summation compute_score used before the reduction kernel
+static double sum_floats_sequential(const float* values, size_t count)
+{
+	float sum = 0.f;
+	for (size_t i = 0; i < count; ++i)
+	{
+		sum += values[i];
+	}
+	return (double)sum;
+}
+
+typedef double (*sum_function_t)(const float* values, size_t count);
+
+static double time_sum(sum_function_t function, const float* values, size_t count, double* result)
+{
+	double best = 1e30;
+	for (size_t i = 0; i < BENCHMARK_ITERATIONS; ++i)
+	{
+		const double start = get_seconds();
+		*result = function(values, count);
+		const double elapsed = get_seconds() - start;
+		best = (elapsed < best ? elapsed : best);
+	}
+	return best;
+}
+
+static double time_sum_parallel(thread_pool_t* pool, const float* values, size_t count, double* result)
+{
+	double best = 1e30;
+	for (size_t i = 0; i < BENCHMARK_ITERATIONS; ++i)
+	{
+		const double start = get_seconds();
+		*result = sum_floats_parallel(pool, values, count);
+		const double elapsed = get_seconds() - start;
+		best = (elapsed < best ? elapsed : best);
+	}
+	return best;
+}
+
+static void add_sum_result(benchmark_report_t* report, const char* name, double elapsed, double baseline, double sum, size_t count)
+{
+	char result_name[RESULT_NAME_LENGTH];
+	snprintf(result_name, RESULT_NAME_LENGTH, "sum_%s", name);
+	benchmark_result_t* result = add_result(report, result_name);
+	add_metric(result, "ms", elapsed * 1e3);
+	add_metric(result, "ns_per_pixel", elapsed * 1e9 / (double)count);
+	add_metric(result, "speedup", baseline / elapsed);
+	add_metric(result, "sum", sum);
+	print_result(result);
+}
+
+static bool benchmark_reduce(benchmark_report_t* report, thread_pool_t* pool)
+{
+	const size_t count = APPLICATION_PIXEL_COUNT;
+	float* values = (float*)malloc(count * sizeof(float));
+	if (values == NULL)
+	{
+		printf("Failed to allocate benchmark values.\n");
+		return false;
+	}
+	fill_errors(values, count);
+
+	double sequential_sum;
+	const double sequential_time = time_sum(&sum_floats_sequential, values, count, &sequential_sum);
+	add_sum_result(report, "sequential", sequential_time, sequential_time, sequential_sum, count);
+
+	// Every instruction set must give exactly the scalar result
+	bool matches = true;
+	double reference = 0.0;
+	const simd_level_t supported = get_supported_simd_level();
+	for (int level = SIMD_SCALAR; level <= (int)supported; ++level)
+	{
+		set_simd_level((simd_level_t)level);
+		double sum;
+		const double elapsed = time_sum(&sum_floats, values, count, &sum);
+		if (level == SIMD_SCALAR)
+		{
+			reference = sum;
+		}
+		matches = (matches && (sum == reference));
+		add_sum_result(report, get_simd_level_name((simd_level_t)level), elapsed, sequential_time, sum, count);
+	}
+
+	double parallel_sum;
+	const double parallel_time = time_sum_parallel(pool, values, count, &parallel_sum);
+	matches = (matches && (parallel_sum == reference));
+	add_sum_result(report, "parallel", parallel_time, sequential_time, parallel_sum, count);
+	printf("Sequential float error %.3g, results %s.\n", sequential_sum - reference, matches ? "identical" : "DIFFER");
+
+	// Through compute_score itself, as the readback path calls it
+	generation_t generation = create_generation(NULL);
+	generation.score_pixels = values;
+	double best = 1e30;
+	for (size_t i = 0; i < BENCHMARK_ITERATIONS; ++i)
+	{
+		const double start = get_seconds();
+		compute_score(&generation);
+		const double elapsed = get_seconds() - start;
+		best = (elapsed < best ? elapsed : best);
+	}
+	matches = (matches && (generation.score == reference));
+	benchmark_result_t* result = add_result(report, "compute_score");
+	add_metric(result, "ms", best * 1e3);
+	add_metric(result, "ns_per_pixel", best * 1e9 / (double)count);
+	add_metric(result, "score", generation.score);
+	print_result(result);
+
+	// An offspring worse than the survivors stops part way; a cutoff at
+	// the score itself must still sum everything
+	generation.score_cutoff = reference;
+	compute_score(&generation);
+	matches = (matches && (generation.score == reference));
+	generation.score_cutoff = reference * 0.5;
+	best = 1e30;
+	for (size_t i = 0; i < BENCHMARK_ITERATIONS; ++i)
+	{
+		const double start = get_seconds();
+		compute_score(&generation);
+		const double elapsed = get_seconds() - start;
+		best = (elapsed < best ? elapsed : best);
+	}
+	matches = (matches && (generation.score > generation.score_cutoff) && (generation.score <= reference));
+	result = add_result(report, "compute_score_bounded");
+	add_metric(result, "ms", best * 1e3);
+	add_metric(result, "ns_per_pixel", best * 1e9 / (double)count);
+	add_metric(result, "score", generation.score);
+	print_result(result);
+	destroy_generation(&generation);
+
+	free(values);
+	return matches;
+}
+
+// Times resampling the synthetic target and building its levels, keeping the
+// last one prepared for the searches
+static bool benchmark_target(benchmark_report_t* report, const image_t* source, thread_pool_t* pool, target_t* out)
+{
+	double best = 1e30;
+	for (size_t i = 0; i < BENCHMARK_TARGET_ITERATIONS; ++i)
+	{
+		destroy_target(out);
+		const double start = get_seconds();
+		const bool created = create_target(source, pool, out);
+		const double elapsed = get_seconds() - start;
+		if (!created)
+		{
+			return false;
+		}
+		best = (elapsed < best ? elapsed : best);
+	}
+	benchmark_result_t* result = add_result(report, "create_target");
+	add_metric(result, "ms", best * 1e3);
+	add_metric(result, "ns_per_source_pixel", best * 1e9 / ((double)source->width * (double)source->height));
+	print_result(result);
+	return true;
+}
+
+// Times mutating and copying a half-length genome, starting from the same
+// genome and generator state every run
+static void benchmark_genome(benchmark_report_t* report)
+{
+	random_state_t random = seed_random(BENCHMARK_SEED);
+	generation_t source = create_generation(NULL);
+	generation_t destination = create_generation(NULL);
+	const size_t index_count = LINES_INDEX_COUNT / 2;
+	nail_t* nails = (nail_t*)malloc(index_count * sizeof(nail_t));
+	if (nails == NULL)
+	{
+		printf("Failed to allocate genome benchmark.\n");
+		destroy_generation(&destination);
+		destroy_generation(&source);
+		return;
+	}
+	for (size_t i = 0; i < index_count; ++i)
+	{
+		nails[i] = (nail_t)random_below(&random, POINT_COUNT);
+	}
+	const bool created = set_generation_nails(&source, nails, index_count);
+	free(nails);
+	if (!created)
+	{
+		printf("Failed to allocate genome benchmark.\n");
+		destroy_generation(&destination);
+		destroy_generation(&source);
+		return;
+	}
+
+	double best_mutate = 1e30;
+	uint64_t checksum = 0;
+	for (size_t run = 0; run < BENCHMARK_EDIT_RUNS; ++run)
+	{
+		random = seed_random(BENCHMARK_SEED);
+		checksum = 0;
+		const double start = get_seconds();
+		for (size_t i = 0; i < BENCHMARK_EDITS; ++i)
+		{
+			mutate_generation(&source, &destination, &random);
+			checksum += get_generation_length(&destination);
+		}
+		const double elapsed = get_seconds() - start;
+		best_mutate = (elapsed < best_mutate ? elapsed : best_mutate);
+	}
+
+	double best_copy = 1e30;
+	for (size_t run = 0; run < BENCHMARK_EDIT_RUNS; ++run)
+	{
+		const double start = get_seconds();
+		for (size_t i = 0; i < BENCHMARK_EDITS; ++i)
+		{
+			copy_generation(&source, &destination);
+		}
+		const double elapsed = get_seconds() - start;
+		best_copy = (elapsed < best_copy ? elapsed : best_copy);
+	}
+
+	benchmark_result_t* result = add_result(report, "mutate_generation");
+	add_metric(result, "ns_per_call", best_mutate * 1e9 / BENCHMARK_EDITS);
+	add_metric(result, "indices", (double)index_count);
+	add_metric(result, "checksum", (double)checksum);
+	print_result(result);
+
+	result = add_result(report, "copy_generation");
+	add_metric(result, "ns_per_call", best_copy * 1e9 / BENCHMARK_EDITS);
+	add_metric(result, "indices", (double)index_count);
+	print_result(result);
+
+	destroy_generation(&destination);
+	destroy_generation(&source);
+}
+
+static void add_search_result
+(
+	benchmark_report_t* report,
+	const char* name,
+	int generations,
+	size_t evaluations_per_generation,
+	double elapsed,
+	double best_score
+)
+{
+	const double evaluations = (double)generations * (double)evaluations_per_generation;
+	benchmark_result_t* result = add_result(report, name);
+	add_metric(result, "generations", (double)generations);
+	add_metric(result, "seconds", elapsed);
+	add_metric(result, "generations_per_second", (double)generations / elapsed);
+	add_metric(result, "evaluations_per_second", evaluations / elapsed);
+	add_metric(result, "ns_per_pixel", elapsed * 1e9 / (evaluations * (double)APPLICATION_PIXEL_COUNT));
+	add_metric(result, "best_score", best_score);
+	print_result(result);
+}
+
+// Runs the software search on one island, seeded the same way every time.
+// Full rendering redraws the whole population each generation; incremental
+// scoring only evaluates the offspring.
+static bool benchmark_software_search(benchmark_report_t* report, const software_renderer_t* renderer, bool incremental, int generations)
+{
+	archipelago_t archipelago = null_archipelago();
+	if (!create_archipelago(renderer, 1, MIGRATION_INTERVAL, incremental, BENCHMARK_SEED, &archipelago))
+	{
+		destroy_archipelago(&archipelago);
+		return false;
+	}
+
+	const double start = get_seconds();
+	const bool success = run_archipelago(&archipelago, generations);
+	const double elapsed = get_seconds() - start;
+	if (success)
+	{
+		const size_t evaluations = incremental ? (CANDIDATE_COUNT - FITTEST_COUNT) : CANDIDATE_COUNT;
+		add_search_result(report, incremental ? "software_incremental" : "software_full", generations, evaluations, elapsed, get_island_best(&archipelago, 0)->score);
+	}
+	destroy_archipelago(&archipelago);
+	return success;
+}
+
+// Times uploading the target and a whole batch render with its readback,
+// then runs the batched search loop main does, minus drawing to the window
+static bool benchmark_gl(benchmark_report_t* report, const target_t* target, const vector2d_t* vertices, thread_pool_t* pool, int generations, bool headless)
+{
+	graphics_context_t graphics_context = null_graphics_context();
+	if (!initialize_graphics(&graphics_context, target, headless))
+	{
+		return false;
+	}
+
+	// Uploads replace the context's textures, so the originals are put back
+	const GLuint original_texture = graphics_context.texture_image;
+	const GLuint original_pyramid = graphics_context.texture_pyramid;
+	double best_upload = 1e30;
+	for (size_t i = 0; i < BENCHMARK_GL_ITERATIONS; ++i)
+	{
+		glFinish();
+		const double start = get_seconds();
+		load_texture_image(&graphics_context, target);
+		glFinish();
+		const double elapsed = get_seconds() - start;
+		best_upload = (elapsed < best_upload ? elapsed : best_upload);
+		glDeleteTextures(1, &graphics_context.texture_image);
+		glDeleteTextures(1, &graphics_context.texture_pyramid);
+	}
+	graphics_context.texture_image = original_texture;
+	graphics_context.texture_pyramid = original_pyramid;
+	benchmark_result_t* result = add_result(report, "load_texture_image");
+	add_metric(result, "ms", best_upload * 1e3);
+	add_metric(result, "ns_per_pixel", best_upload * 1e9 / ((double)target->levels[0].width * (double)target->levels[0].height));
+	print_result(result);
+
+	batch_renderer_t batch_renderer = null_batch_renderer();
+	generation_t* candidates = (generation_t*)malloc(CANDIDATE_COUNT * sizeof(generation_t));
+	generation_rank_t* ranks = (generation_rank_t*)malloc(CANDIDATE_COUNT * sizeof(generation_rank_t));
+	if ((candidates == NULL) || (ranks == NULL) || !create_batch_renderer(vertices, POINT_COUNT, CANDIDATE_COUNT, false, &batch_renderer))
+	{
+		printf("Failed to set up batch benchmark.\n");
+		free(ranks);
+		free(candidates);
+		destroy_graphics(&graphics_context);
+		return false;
+	}
+	random_state_t random = seed_random(BENCHMARK_SEED);
+	for (size_t i = 0; i < CANDIDATE_COUNT; ++i)
+	{
+		candidates[i] = create_generation(&random);
+		candidates[i].parent_slot = i;
+	}
+
+	bool success = true;
+	double best_render = 1e30;
+	for (size_t i = 0; (i < BENCHMARK_GL_ITERATIONS) && success; ++i)
+	{
+		const double start = get_seconds();
+		success = render_batch(&batch_renderer, candidates, CANDIDATE_COUNT, graphics_context.texture_image)
+			&& score_batch(&batch_renderer, pool, candidates, CANDIDATE_COUNT);
+		const double elapsed = get_seconds() - start;
+		best_render = (elapsed < best_render ? elapsed : best_render);
+	}
+	if (success)
+	{
+		result = add_result(report, "render_readback");
+		add_metric(result, "ms", best_render * 1e3);
+		add_metric(result, "ms_per_candidate", best_render * 1e3 / CANDIDATE_COUNT);
+		add_metric(result, "ns_per_pixel", best_render * 1e9 / ((double)CANDIDATE_COUNT * (double)APPLICATION_PIXEL_COUNT));
+		print_result(result);
+	}
+
+	const double start = get_seconds();
+	for (int generation = 0; (generation < generations) && success; ++generation)
+	{
+		success = render_batch(&batch_renderer, candidates, CANDIDATE_COUNT, graphics_context.texture_image)
+			&& score_batch(&batch_renderer, pool, candidates, CANDIDATE_COUNT);
+		if (success)
+		{
+			sort_generations(candidates, ranks, CANDIDATE_COUNT);
+			breed_offspring(candidates, &random, pool);
+		}
+	}
+	const double elapsed = get_seconds() - start;
+	if (success)
+	{
+		add_search_result(report, "gl_batch", generations, CANDIDATE_COUNT, elapsed, candidates[0].score);
+	}
+
+	for (size_t i = 0; i < CANDIDATE_COUNT; ++i)
+	{
+		destroy_generation(&candidates[i]);
+	}
+	free(ranks);
+	free(candidates);
+	destroy_batch_renderer(&batch_renderer);
+	destroy_graphics(&graphics_context);
+	return success;
+}
+
+int main(int argc, char** argv)
+{
+	if (!parse_config_arguments(argc, argv, &config) || !validate_config(&config))
+	{
+		return -1;
+	}
+	print_config(&config);
+	const int generations = parse_generations(argc, argv);
+	const char* output = parse_output(argc, argv);
+	const bool gl = has_argument(argc, argv, GL_ARGUMENT);
+
+	thread_pool_t thread_pool = null_thread_pool();
+	if (!create_thread_pool(get_processor_count(), false, &thread_pool))
+	{
+		return -1;
+	}
+
+	image_t source = null_image();
+	vector2d_t* vertices = (vector2d_t*)malloc(POINT_COUNT * sizeof(vector2d_t));
+	if ((vertices == NULL) || !create_benchmark_target(&source))
+	{
+		printf("Failed to set up benchmark.\n");
+		free(vertices);
+		destroy_thread_pool(&thread_pool);
+		return -1;
+	}
+	place_nails(vertices);
+
+	static benchmark_report_t report;
+	report.result_count = 0;
+
+	printf("Preparing a %dx%d target, best of %d:\n", BENCHMARK_TARGET_SIZE, BENCHMARK_TARGET_SIZE, BENCHMARK_TARGET_ITERATIONS);
+	target_t target = null_target();
+	if (!benchmark_target(&report, &source, &thread_pool, &target))
+	{
+		printf("Failed to set up benchmark.\n");
+		free(vertices);
+		destroy_image(&source);
+		destroy_thread_pool(&thread_pool);
+		return -1;
+	}
+
+	printf("Summing %d floats, best of %d:\n", (int)APPLICATION_PIXEL_COUNT, BENCHMARK_ITERATIONS);
+	bool success = benchmark_reduce(&report, &thread_pool);
+	benchmark_genome(&report);
+
+	printf("Searching for %d generations:\n", generations);
+	software_renderer_t software_renderer = null_software_renderer();
+	if (create_software_renderer(vertices, POINT_COUNT, &target.levels[0], true, false, &thread_pool, &software_renderer))
+	{
+		success = (benchmark_software_search(&report, &software_renderer, false, generations) && success);
+		success = (benchmark_software_search(&report, &software_renderer, true, generations) && success);
+		destroy_software_renderer(&software_renderer);
+	}
+	else
+	{
+		success = false;
+	}
+
+	if (gl)
+	{
+		success = (benchmark_gl(&report, &target, vertices, &thread_pool, generations, has_argument(argc, argv, HEADLESS_ARGUMENT)) && success);
+	}
+
+	success = (write_report(&report, output, BENCHMARK_SEED, gl) && success);
+	free(vertices);
+	destroy_target(&target);
+	destroy_image(&source);
+	destroy_thread_pool(&thread_pool);
+	return (success ? 0 : -1);
+}
@@ -0,0 +1,115 @@
+#include "blur.h"
+#include <assert.h>
+#include <math.h>
+
+// Texels weighed before folding into taps
+#define BLUR_MAXIMUM_TEXELS (2 * BLUR_MAXIMUM_TAPS)
+
+// Narrowest spread kept, so a zero radius still gives a box
+#define BLUR_MINIMUM_SIGMA 1e-3f
+
+float get_blur_sigma(int sample_radius)
+{
+	// Ring samples put radius^2 / 2 of variance on each axis, and the centre
+	// tap none
+	const float ring_weight = 16.f / 24.f;
+	const float radius = (float)sample_radius;
+	return sqrtf(ring_weight * radius * radius * 0.5f);
+}
+
+// Box of the given width convolved with the gaussian, at the offset
+static double box_gaussian(double offset, double width, double sigma)
+{
+	const double spread = sigma * sqrt(2.0);
+	return 0.5 * (erf((offset + (0.5 * width)) / spread) - erf((offset - (0.5 * width)) / spread));
+}
+
+blur_kernel_t create_blur_kernel(float scale, float sigma)
+{
+	blur_kernel_t result;
+	result.scale = scale;
+	result.tap_count = 0;
+	for (int i = 0; i < BLUR_MAXIMUM_TAPS; ++i)
+	{
+		result.offsets[i] = 0.f;
+		result.weights[i] = 0.f;
+	}
+	sigma = (sigma > BLUR_MINIMUM_SIGMA ? sigma : BLUR_MINIMUM_SIGMA);
+
+	// Texel centres are whole offsets from the box centre when it covers an
+	// odd number of them, and halfway between otherwise
+	const bool centred = ((((int)(scale + 0.5f)) % 2) != 0);
+	const double reach = (0.5 * (double)scale) + (BLUR_REACH * (double)sigma);
+	const int maximum_side_count = (centred ? (BLUR_MAXIMUM_TEXELS - 1) / 2 : BLUR_MAXIMUM_TEXELS / 2);
+	int side_count = (int)floor(centred ? reach : reach + 0.5);
+	side_count = (side_count < maximum_side_count ? side_count : maximum_side_count);
+	const int texel_count = (2 * side_count) + (centred ? 1 : 0);
+
+	// Weigh every texel from the left, then normalize what was kept
+	double offsets[BLUR_MAXIMUM_TEXELS];
+	double weights[BLUR_MAXIMUM_TEXELS];
+	double total = 0.0;
+	for (int i = 0; i < texel_count; ++i)
+	{
+		const double offset = (double)(i - side_count) + (centred ? 0.0 : 0.5);
+		offsets[i] = offset;
+		weights[i] = box_gaussian(offset, (double)scale, (double)sigma);
+		total += weights[i];
+	}
+
+	// Pairs become one tap where bilinear filtering mixes them as weighed
+	for (int i = 0; i < texel_count; i += 2)
+	{
+		double weight = weights[i];
+		double offset = offsets[i];
+		if ((i + 1) < texel_count)
+		{
+			const double pair_weight = weight + weights[i + 1];
+			offset += (pair_weight > 0.0 ? weights[i + 1] / pair_weight : 0.5);
+			weight = pair_weight;
+		}
+		result.offsets[result.tap_count] = (float)offset;
+		result.weights[result.tap_count] = (float)(weight / total);
+		++result.tap_count;
+	}
+	return result;
+}
+
+int get_blur_kernel_radius(const blur_kernel_t* kernel)
+{
+	assert((((int)(kernel->scale + 0.5f)) % 2) != 0);
+	int radius = 0;
+	for (int i = 0; i < kernel->tap_count; ++i)
+	{
+		// A tap between texels reads the one after its floor as well
+		const float offset = kernel->offsets[i];
+		const int low = (int)floorf(offset);
+		const int high = ((float)low < offset ? low + 1 : low);
+		radius = (-low > radius ? -low : radius);
+		radius = (high > radius ? high : radius);
+	}
+	return radius;
+}
+
+void expand_blur_kernel(const blur_kernel_t* kernel, int radius, float* weights)
+{
+	for (int i = 0; i < (2 * radius) + 1; ++i)
+	{
+		weights[i] = 0.f;
+	}
+
+	// Split each tap as bilinear filtering would
+	for (int i = 0; i < kernel->tap_count; ++i)
+	{
+		const float offset = kernel->offsets[i];
+		const float low = floorf(offset);
+		const float fraction = offset - low;
+		const int index = (int)low + radius;
+		assert((index >= 0) && (index + (fraction > 0.f ? 1 : 0) <= 2 * radius));
+		weights[index] += kernel->weights[i] * (1.f - fraction);
+		if (fraction > 0.f)
+		{
+			weights[index + 1] += kernel->weights[i] * fraction;
+		}
+	}
+}
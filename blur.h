@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+
+// Bilinear taps every blur pass takes; must match blur.fragment and
+// texture.fragment. The shaders loop a fixed count so it unrolls.
+#define BLUR_MAXIMUM_TAPS 8
+
+// Standard deviations the kernel reaches out to on either side
+#define BLUR_REACH 3.f
+
+// Weights of one pass of the separable blur. Each output texel covers scale
+// source texels, averaged as a box then spread by a gaussian. Neighbouring
+// texels are folded into single bilinear taps between them, at offsets in
+// source texels from the box centre. Taps past tap_count have no weight.
+typedef struct blur_kernel
+{
+	float scale;
+	int tap_count;
+	float offsets[BLUR_MAXIMUM_TAPS];
+	float weights[BLUR_MAXIMUM_TAPS];
+} blur_kernel_t;
+
+// Spread in texture pixels with the variance of the 16-tap ring sampler the
+// blur replaced, so the look is kept: 16 taps at the sample radius around a
+// centre tap weighted 8
+float get_blur_sigma(int sample_radius);
+
+// Kernels too wide for the taps lose texels at both ends
+blur_kernel_t create_blur_kernel(float scale, float sigma);
+
+// Taps unfolded back into one weight per texel, for blurring on the CPU.
+// Only kernels of an odd scale have their texels at whole offsets. Weights
+// hold 2 * radius + 1 texels, centred on the middle one.
+int get_blur_kernel_radius(const blur_kernel_t* kernel);
+void expand_blur_kernel(const blur_kernel_t* kernel, int radius, float* weights);
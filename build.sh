@@ -1 +1,2 @@
-gcc -o thread_circle file_io.c graphics.c main.c material.c matrix3d.c shared.c vector2d.c -I/usr/include/SDL2 -lSDL2 -lSDL2_image -lGL -lGLEW -lm -O4
+gcc -o thread_circle arena.c batch_renderer.c blur.c checkpoint.c chord_cache.c config.c file_io.c generation.c genome.c graphics.c greedy_solver.c image.c island.c job.c main.c material.c matrix3d.c profiler.c random.c reduce.c resolution.c shared.c snapshot.c software_renderer.c target.c thread.c thread_pool.c vector2d.c -I/usr/include/SDL2 -lSDL2 -lSDL2_image -lGL -lEGL -lGLEW -lm -lpthread -O4
+gcc -o benchmark benchmark.c arena.c batch_renderer.c blur.c chord_cache.c config.c file_io.c generation.c genome.c graphics.c image.c island.c material.c matrix3d.c profiler.c random.c reduce.c resolution.c shared.c software_renderer.c target.c thread.c thread_pool.c vector2d.c -I/usr/include/SDL2 -lSDL2 -lSDL2_image -lGL -lEGL -lGLEW -lm -lpthread -O4
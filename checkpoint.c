@@ -0,0 +1,600 @@
+#include "checkpoint.h"
+#include "file_io.h"
+#include <assert.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECKPOINT_MAGIC "TCPOPUL"
+#define CHECKPOINT_VERSION 3
+
+// Keeps journal entries after a checkpoint aligned
+#define CHECKPOINT_ALIGNMENT 8
+#define ALIGN_CHECKPOINT(size) (((size) + CHECKPOINT_ALIGNMENT - 1) & ~(size_t)(CHECKPOINT_ALIGNMENT - 1))
+
+// Fixed-size records followed by every candidate's nails, packed in order,
+// so a mapped checkpoint is copied out rather than parsed
+typedef struct checkpoint_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t point_count;
+	uint32_t population_count;
+	uint32_t candidate_count;
+	uint32_t random_size;
+	uint64_t run_id;
+	uint64_t nail_count;
+} checkpoint_header_t;
+
+typedef struct checkpoint_population
+{
+	random_state_t random;
+	int32_t generation;
+	uint32_t reserved;
+} checkpoint_population_t;
+
+typedef struct checkpoint_candidate
+{
+	double score;
+	uint32_t nail_count;
+	uint32_t reserved;
+} checkpoint_candidate_t;
+
+// Journal entries follow the population the journal started from, stored as
+// a checkpoint. Each entry holds one record per survivor.
+typedef struct journal_entry
+{
+	int32_t generation;
+	uint32_t survivor_count;
+	random_state_t random;
+} journal_entry_t;
+
+typedef struct journal_record
+{
+	double score;
+	uint32_t parent_slot;
+	mutation_edit_t edit;
+} journal_record_t;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static size_t get_checkpoint_size(const population_t* populations, size_t population_count, size_t* nail_count)
+{
+	size_t total = 0;
+	for (size_t i = 0; i < population_count; ++i)
+	{
+		for (size_t j = 0; j < CANDIDATE_COUNT; ++j)
+		{
+			total += get_generation_length(&populations[i].candidates[j]);
+		}
+	}
+	*nail_count = total;
+	return ALIGN_CHECKPOINT(sizeof(checkpoint_header_t)
+		+ (population_count * sizeof(checkpoint_population_t))
+		+ (population_count * CANDIDATE_COUNT * sizeof(checkpoint_candidate_t))
+		+ (total * sizeof(nail_t)));
+}
+
+static void serialize_checkpoint(uint64_t run_id, const population_t* populations, size_t population_count, size_t nail_count, uint8_t* out)
+{
+	checkpoint_header_t* header = (checkpoint_header_t*)out;
+	memset(header, 0, sizeof(checkpoint_header_t));
+	memcpy(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic));
+	header->version = CHECKPOINT_VERSION;
+	header->point_count = (uint32_t)POINT_COUNT;
+	header->population_count = (uint32_t)population_count;
+	header->candidate_count = (uint32_t)CANDIDATE_COUNT;
+	header->random_size = (uint32_t)sizeof(random_state_t);
+	header->run_id = run_id;
+	header->nail_count = nail_count;
+
+	checkpoint_population_t* stored_populations = (checkpoint_population_t*)(header + 1);
+	checkpoint_candidate_t* stored_candidates = (checkpoint_candidate_t*)(stored_populations + population_count);
+	nail_t* stored_nails = (nail_t*)(stored_candidates + (population_count * CANDIDATE_COUNT));
+	for (size_t i = 0; i < population_count; ++i)
+	{
+		const population_t* population = &populations[i];
+		checkpoint_population_t* stored_population = &stored_populations[i];
+		stored_population->random = *population->random;
+		stored_population->generation = (int32_t)*population->generation;
+		stored_population->reserved = 0;
+		for (size_t j = 0; j < CANDIDATE_COUNT; ++j)
+		{
+			const generation_t* candidate = &population->candidates[j];
+			checkpoint_candidate_t* stored_candidate = stored_candidates++;
+			stored_candidate->score = candidate->score;
+			stored_candidate->nail_count = (uint32_t)get_generation_length(candidate);
+			stored_candidate->reserved = 0;
+			export_genome(&candidate->genome, stored_nails);
+			stored_nails += stored_candidate->nail_count;
+		}
+	}
+}
+
+// Size of the checkpoint at the start of data if it fits the settings and
+// population count, otherwise 0
+static size_t validate_checkpoint(const uint8_t* data, size_t length, size_t population_count)
+{
+	const checkpoint_header_t* header = (const checkpoint_header_t*)data;
+	if ((length < sizeof(checkpoint_header_t))
+		|| (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0)
+		|| (header->version != CHECKPOINT_VERSION)
+		|| (header->point_count != (uint32_t)POINT_COUNT)
+		|| (header->population_count != (uint32_t)population_count)
+		|| (header->candidate_count != (uint32_t)CANDIDATE_COUNT)
+		|| (header->random_size != (uint32_t)sizeof(random_state_t)))
+	{
+		return 0;
+	}
+	const size_t record_size = sizeof(checkpoint_header_t)
+		+ (population_count * sizeof(checkpoint_population_t))
+		+ (population_count * CANDIDATE_COUNT * sizeof(checkpoint_candidate_t));
+	if ((length < record_size) || (header->nail_count > ((length - record_size) / sizeof(nail_t))))
+	{
+		return 0;
+	}
+
+	// Genomes have to fit the line budget and add up to the stored count
+	const checkpoint_candidate_t* stored_candidates = (const checkpoint_candidate_t*)((const checkpoint_population_t*)(header + 1) + population_count);
+	uint64_t nail_count = 0;
+	for (size_t i = 0; i < population_count * CANDIDATE_COUNT; ++i)
+	{
+		if (stored_candidates[i].nail_count > (uint32_t)LINES_INDEX_COUNT)
+		{
+			return 0;
+		}
+		nail_count += stored_candidates[i].nail_count;
+	}
+	if (nail_count != header->nail_count)
+	{
+		return 0;
+	}
+	const size_t size = ALIGN_CHECKPOINT(record_size + ((size_t)nail_count * sizeof(nail_t)));
+	return (size <= length ? size : 0);
+}
+
+static bool deserialize_checkpoint(const uint8_t* data, const population_t* populations, size_t population_count)
+{
+	const checkpoint_header_t* header = (const checkpoint_header_t*)data;
+	const checkpoint_population_t* stored_populations = (const checkpoint_population_t*)(header + 1);
+	const checkpoint_candidate_t* stored_candidates = (const checkpoint_candidate_t*)(stored_populations + population_count);
+	const nail_t* stored_nails = (const nail_t*)(stored_candidates + (population_count * CANDIDATE_COUNT));
+	for (size_t i = 0; i < population_count; ++i)
+	{
+		const population_t* population = &populations[i];
+		*population->random = stored_populations[i].random;
+		*population->generation = (int)stored_populations[i].generation;
+		for (size_t j = 0; j < CANDIDATE_COUNT; ++j)
+		{
+			const checkpoint_candidate_t* stored_candidate = stored_candidates++;
+			for (size_t k = 0; k < stored_candidate->nail_count; ++k)
+			{
+				if (stored_nails[k] >= POINT_COUNT)
+				{
+					return false;
+				}
+			}
+
+			// Incremental states are rebuilt from scratch on the next step
+			generation_t* candidate = &population->candidates[j];
+			if (!set_generation_nails(candidate, stored_nails, stored_candidate->nail_count))
+			{
+				printf("Failed to allocate genome.\n");
+				return false;
+			}
+			candidate->score = stored_candidate->score;
+			candidate->mutation = null_mutation();
+			candidate->parent_slot = j;
+			candidate->state = NULL;
+			candidate->parent_state = NULL;
+			stored_nails += stored_candidate->nail_count;
+		}
+	}
+	return true;
+}
+
+static bool write_checkpoint_file(const char* filename, const uint8_t* data, size_t size)
+{
+	// Write next to the destination and move into place so a crash mid-write
+	// leaves the last checkpoint intact
+	const size_t filename_length = strlen(filename);
+	char* temporary_filename = (char*)malloc(filename_length + 5);
+	if (temporary_filename == NULL)
+	{
+		return false;
+	}
+	memcpy(temporary_filename, filename, filename_length);
+	memcpy(temporary_filename + filename_length, ".tmp", 5);
+
+	FILE* file = fopen(temporary_filename, "wb");
+	if (file == NULL)
+	{
+		printf("Failed to open %s for write.\n", temporary_filename);
+		free(temporary_filename);
+		return false;
+	}
+	// Data reaches the disk before the rename can, so a power loss can't
+	// leave an empty or cut off checkpoint under the real name
+	bool success = (fwrite(data, 1, size, file) == size) && sync_file(file);
+	success = (fclose(file) == 0) && success;
+
+	// POSIX rename replaces the destination atomically; Windows needs it gone
+	if (success)
+	{
+#if defined(WIN32)
+		remove(filename);
+#endif
+		success = (rename(temporary_filename, filename) == 0) && sync_directory(filename);
+	}
+	if (!success)
+	{
+		printf("Failed to write checkpoint %s.\n", filename);
+		remove(temporary_filename);
+	}
+	free(temporary_filename);
+	return success;
+}
+
+static void run_checkpoint_writer(void* writer_pointer)
+{
+	checkpoint_writer_t* writer = (checkpoint_writer_t*)writer_pointer;
+	lock_mutex(&writer->lock);
+	while (true)
+	{
+		while (!writer->has_pending && !writer->stopping)
+		{
+			wait_condition(&writer->changed, &writer->lock);
+		}
+		if (!writer->has_pending)
+		{
+			break;
+		}
+
+		// Take the staged checkpoint and leave the other buffer to fill
+		uint8_t* data = writer->pending;
+		const size_t size = writer->pending_size;
+		const size_t capacity = writer->pending_capacity;
+		writer->pending = writer->writing;
+		writer->pending_capacity = writer->writing_capacity;
+		writer->pending_size = 0;
+		writer->writing = data;
+		writer->writing_capacity = capacity;
+		writer->has_pending = false;
+		writer->busy = true;
+		unlock_mutex(&writer->lock);
+
+		// Journal entries up to here are made as durable as the checkpoint;
+		// the main thread has already flushed them to the OS
+		if (writer->journal != NULL)
+		{
+			sync_file(writer->journal);
+		}
+		write_checkpoint_file(writer->filename, data, size);
+
+		lock_mutex(&writer->lock);
+		writer->busy = false;
+		broadcast_condition(&writer->changed);
+	}
+	unlock_mutex(&writer->lock);
+}
+
+checkpoint_writer_t null_checkpoint_writer(void)
+{
+	checkpoint_writer_t result;
+	result.filename = NULL;
+	result.run_id = 0;
+	result.started = false;
+	result.stopping = false;
+	result.pending = NULL;
+	result.pending_size = 0;
+	result.pending_capacity = 0;
+	result.has_pending = false;
+	result.writing = NULL;
+	result.writing_capacity = 0;
+	result.busy = false;
+	result.journal = NULL;
+	return result;
+}
+
+// Serializes into the pending buffer, growing it if needed; lock held
+static bool stage_checkpoint(checkpoint_writer_t* writer, const population_t* populations, size_t population_count)
+{
+	size_t nail_count;
+	const size_t size = get_checkpoint_size(populations, population_count, &nail_count);
+	if (size > writer->pending_capacity)
+	{
+		uint8_t* grown = (uint8_t*)realloc(writer->pending, size);
+		if (grown == NULL)
+		{
+			printf("Failed to allocate checkpoint.\n");
+			return false;
+		}
+		writer->pending = grown;
+		writer->pending_capacity = size;
+	}
+	memset(writer->pending + size - CHECKPOINT_ALIGNMENT, 0, CHECKPOINT_ALIGNMENT);
+	serialize_checkpoint(writer->run_id, populations, population_count, nail_count, writer->pending);
+	writer->pending_size = size;
+	return true;
+}
+
+bool create_checkpoint_writer
+(
+	const char* filename,
+	const char* journal_filename,
+	uint64_t run_id,
+	const population_t* population,
+	checkpoint_writer_t* out
+)
+{
+	if (!create_mutex(&out->lock))
+	{
+		printf("Failed to create checkpoint lock.\n");
+		return false;
+	}
+	if (!create_condition(&out->changed))
+	{
+		destroy_mutex(&out->lock);
+		printf("Failed to create checkpoint condition.\n");
+		return false;
+	}
+
+	// Locks exist from here, so destroying cleans up
+	out->filename = filename;
+	out->run_id = run_id;
+	if (journal_filename != NULL)
+	{
+		out->journal = fopen(journal_filename, "wb");
+		if (out->journal == NULL)
+		{
+			printf("Failed to open journal %s for write.\n", journal_filename);
+			return false;
+		}
+
+		// The journal opens with the population it starts from
+		bool success = stage_checkpoint(out, population, 1);
+		success = success && (fwrite(out->pending, 1, out->pending_size, out->journal) == out->pending_size) && sync_file(out->journal);
+		out->pending_size = 0;
+		if (!success)
+		{
+			printf("Failed to write journal %s.\n", journal_filename);
+			return false;
+		}
+	}
+
+	out->started = start_thread(&out->thread, &run_checkpoint_writer, out);
+	if (!out->started)
+	{
+		printf("Failed to start checkpoint writer.\n");
+		return false;
+	}
+	return true;
+}
+
+void destroy_checkpoint_writer(checkpoint_writer_t* writer)
+{
+	if (writer->filename != NULL)
+	{
+		if (writer->started)
+		{
+			lock_mutex(&writer->lock);
+			writer->stopping = true;
+			broadcast_condition(&writer->changed);
+			unlock_mutex(&writer->lock);
+			join_thread(&writer->thread);
+		}
+		destroy_condition(&writer->changed);
+		destroy_mutex(&writer->lock);
+	}
+	if (writer->journal != NULL)
+	{
+		fclose(writer->journal);
+	}
+	free(writer->pending);
+	free(writer->writing);
+	*writer = null_checkpoint_writer();
+}
+
+bool submit_checkpoint(checkpoint_writer_t* writer, const population_t* populations, size_t population_count)
+{
+	lock_mutex(&writer->lock);
+	const bool staged = stage_checkpoint(writer, populations, population_count);
+	writer->has_pending = staged;
+	broadcast_condition(&writer->changed);
+	unlock_mutex(&writer->lock);
+	return staged;
+}
+
+bool flush_checkpoint(checkpoint_writer_t* writer, const population_t* populations, size_t population_count)
+{
+	if (!submit_checkpoint(writer, populations, population_count))
+	{
+		return false;
+	}
+	lock_mutex(&writer->lock);
+	while (writer->has_pending || writer->busy)
+	{
+		wait_condition(&writer->changed, &writer->lock);
+	}
+	unlock_mutex(&writer->lock);
+	return true;
+}
+
+bool journal_generation(checkpoint_writer_t* writer, const population_t* population)
+{
+	assert(writer->journal != NULL);
+
+	// Unchanged generations replay as nothing, so they aren't written
+	const generation_t* candidates = population->candidates;
+	bool changed = false;
+	for (size_t i = 0; (i < (size_t)FITTEST_COUNT) && !changed; ++i)
+	{
+		changed = (candidates[i].parent_slot != i) || (candidates[i].mutation.edit.kind != MUTATION_EDIT_NONE);
+	}
+	if (!changed)
+	{
+		return true;
+	}
+
+	journal_entry_t entry;
+	entry.generation = (int32_t)*population->generation;
+	entry.survivor_count = (uint32_t)FITTEST_COUNT;
+	entry.random = *population->random;
+	bool success = (fwrite(&entry, sizeof(entry), 1, writer->journal) == 1);
+	for (size_t i = 0; (i < (size_t)FITTEST_COUNT) && success; ++i)
+	{
+		journal_record_t record;
+		record.score = candidates[i].score;
+		record.parent_slot = (uint32_t)candidates[i].parent_slot;
+		record.edit = candidates[i].mutation.edit;
+		success = (fwrite(&record, sizeof(record), 1, writer->journal) == 1);
+	}
+
+	// Handed to the OS each time, so only a power loss can lose an entry,
+	// and then only one since the last checkpoint, which syncs the journal
+	success = success && (fflush(writer->journal) == 0);
+	if (!success)
+	{
+		printf("Failed to append to journal.\n");
+	}
+	return success;
+}
+
+bool load_checkpoint(const char* filename, const population_t* populations, size_t population_count, uint64_t* run_id)
+{
+	mapped_file_t file = null_mapped_file();
+	if (!map_file(filename, &file))
+	{
+		printf("Failed to open checkpoint %s.\n", filename);
+		return false;
+	}
+
+	const uint8_t* data = (const uint8_t*)file.data;
+	bool success = (validate_checkpoint(data, file.length, population_count) != 0);
+	if (success)
+	{
+		*run_id = ((const checkpoint_header_t*)data)->run_id;
+		success = deserialize_checkpoint(data, populations, population_count);
+	}
+	if (!success)
+	{
+		printf("Checkpoint %s doesn't match these settings.\n", filename);
+	}
+	unmap_file(&file);
+	return success;
+}
+
+bool replay_journal(const char* filename, uint64_t run_id, bool from_start, int last_generation, const population_t* population)
+{
+	mapped_file_t file = null_mapped_file();
+	if (!map_file(filename, &file))
+	{
+		// Nothing journaled since the checkpoint
+		return !from_start;
+	}
+
+	const uint8_t* data = (const uint8_t*)file.data;
+	const size_t start_size = validate_checkpoint(data, file.length, 1);
+	const bool same_run = (start_size != 0) && (((const checkpoint_header_t*)data)->run_id == run_id);
+	if ((start_size == 0) || (!from_start && !same_run))
+	{
+		// A journal from another run can't be replayed over this population
+		unmap_file(&file);
+		if (from_start)
+		{
+			printf("Journal %s doesn't match these settings.\n", filename);
+		}
+		return !from_start;
+	}
+	if (from_start && !deserialize_checkpoint(data, population, 1))
+	{
+		unmap_file(&file);
+		printf("Journal %s doesn't match these settings.\n", filename);
+		return false;
+	}
+
+	// Survivors are rebuilt from copies, since records can name any slot
+	generation_t* previous = (generation_t*)malloc(CANDIDATE_COUNT * sizeof(generation_t));
+	if (previous == NULL)
+	{
+		unmap_file(&file);
+		printf("Failed to allocate journal replay.\n");
+		return false;
+	}
+	for (size_t i = 0; i < CANDIDATE_COUNT; ++i)
+	{
+		previous[i] = create_generation(NULL);
+	}
+
+	// A torn entry at the end is where the run stopped
+	generation_t* candidates = population->candidates;
+	size_t offset = start_size;
+	int replayed = 0;
+	bool success = true;
+	while (success && (offset + sizeof(journal_entry_t) <= file.length))
+	{
+		const journal_entry_t* entry = (const journal_entry_t*)(data + offset);
+		const size_t entry_size = sizeof(journal_entry_t) + (entry->survivor_count * sizeof(journal_record_t));
+		if ((entry->survivor_count != (uint32_t)FITTEST_COUNT) || (offset + entry_size > file.length) || (entry->generation > last_generation))
+		{
+			break;
+		}
+		offset += entry_size;
+		if (entry->generation <= *population->generation)
+		{
+			continue;
+		}
+
+		for (size_t i = 0; i < CANDIDATE_COUNT; ++i)
+		{
+			copy_generation(&candidates[i], &previous[i]);
+		}
+		const journal_record_t* records = (const journal_record_t*)(entry + 1);
+		for (size_t i = 0; (i < (size_t)FITTEST_COUNT) && success; ++i)
+		{
+			const journal_record_t* record = &records[i];
+			success = (record->parent_slot < (uint32_t)CANDIDATE_COUNT)
+				&& replay_mutation(&previous[record->parent_slot], &candidates[i], &record->edit);
+			if (success)
+			{
+				candidates[i].score = record->score;
+				candidates[i].parent_slot = i;
+				candidates[i].mutation.edit = null_mutation_edit();
+			}
+		}
+		*population->random = entry->random;
+		*population->generation = (int)entry->generation;
+		++replayed;
+	}
+
+	for (size_t i = 0; i < CANDIDATE_COUNT; ++i)
+	{
+		destroy_generation(&previous[i]);
+	}
+	free(previous);
+	unmap_file(&file);
+	if (!success)
+	{
+		printf("Journal %s is corrupt.\n", filename);
+		return false;
+	}
+	printf("Replayed %d journal entries up to generation %d.\n", replayed, *population->generation);
+	return true;
+}
+
+static void request_stop(int signal_number)
+{
+	(void)signal_number;
+	stop_requested = 1;
+}
+
+void install_stop_handlers(void)
+{
+	signal(SIGTERM, &request_stop);
+	signal(SIGINT, &request_stop);
+}
+
+bool is_stop_requested(void)
+{
+	return (stop_requested != 0);
+}
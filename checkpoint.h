@@ -0,0 +1,96 @@
+#pragma once
+
+#include "generation.h"
+#include "random.h"
+#include "thread.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define CHECKPOINT_ARGUMENT "--checkpoint"
+#define RESUME_ARGUMENT "--resume"
+#define REPLAY_ARGUMENT "--replay"
+#define CHECKPOINT_FILENAME "population.checkpoint"
+#define JOURNAL_FILENAME "population.journal"
+
+// Generations between background checkpoints of a population
+#define CHECKPOINT_INTERVAL 500
+
+// Everything needed to carry a population on exactly where it stopped
+typedef struct population
+{
+	generation_t* candidates;
+	random_state_t* random;
+	int* generation;
+} population_t;
+
+// Writes checkpoints on its own thread so the search never waits on the
+// disk, and journals the survivors of every generation that changed them.
+// A checkpoint plus the journal after it rebuilds any later generation.
+typedef struct checkpoint_writer
+{
+	const char* filename;
+	uint64_t run_id;
+
+	thread_t thread;
+	bool started;
+	mutex_t lock;
+	condition_t changed;
+	bool stopping;
+
+	// Newest snapshot not yet picked up; a newer one replaces it
+	uint8_t* pending;
+	size_t pending_size;
+	size_t pending_capacity;
+	bool has_pending;
+
+	// Snapshot being written, owned by the writer thread
+	uint8_t* writing;
+	size_t writing_capacity;
+	bool busy;
+
+	// Appended to by the caller only, if kept
+	FILE* journal;
+} checkpoint_writer_t;
+
+checkpoint_writer_t null_checkpoint_writer(void);
+
+// Starts a new journal from the population as it is now, tagged with the
+// run id so it is only ever replayed over checkpoints of the same run. No
+// journal is kept without a journal filename.
+bool create_checkpoint_writer
+(
+	const char* filename,
+	const char* journal_filename,
+	uint64_t run_id,
+	const population_t* population,
+	checkpoint_writer_t* out
+);
+
+// Writes any snapshot still pending before stopping
+void destroy_checkpoint_writer(checkpoint_writer_t* writer);
+
+// Copies the populations and hands them to the writer thread
+bool submit_checkpoint(checkpoint_writer_t* writer, const population_t* populations, size_t population_count);
+
+// Submits and waits until the snapshot is on disk
+bool flush_checkpoint(checkpoint_writer_t* writer, const population_t* populations, size_t population_count);
+
+// Appends the sorted survivors, with the generator state offspring are about
+// to be drawn with, if any survivor is new or moved
+bool journal_generation(checkpoint_writer_t* writer, const population_t* population);
+
+// Restores populations from a checkpoint mapped straight from disk. Fails if
+// the checkpoint doesn't match the settings or population count.
+bool load_checkpoint(const char* filename, const population_t* populations, size_t population_count, uint64_t* run_id);
+
+// Replays journal entries after the population's generation, up to and
+// including last_generation. Starts from the journal's first population
+// instead when from_start is set; otherwise the journal has to belong to
+// run_id.
+bool replay_journal(const char* filename, uint64_t run_id, bool from_start, int last_generation, const population_t* population);
+
+// Turns SIGTERM and SIGINT into a request to stop after a final checkpoint
+void install_stop_handlers(void);
+bool is_stop_requested(void);
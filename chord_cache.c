@@ -0,0 +1,774 @@
+#include "chord_cache.h"
+#include "file_io.h"
+#include "shared.h"
+#include "thread_pool.h"
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHORD_CACHE_MAGIC "TCCC"
+#define CHORD_CACHE_VERSION 1
+#define CHORD_NOT_CACHED UINT32_MAX
+
+// Line between two points prepared for scanning row by row
+typedef struct segment
+{
+	vector2d_t start;
+	float delta_x;
+	float delta_y;
+	float inverse_length_squared;
+	float reach_x;
+	float minimum_x;
+	float maximum_x;
+	int first_row;
+	int last_row;
+} segment_t;
+
+typedef struct chord_cache_header
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t point_count;
+	uint32_t texture_width;
+	uint32_t texture_height;
+	uint32_t scale_factor;
+	float line_width;
+	int32_t footprint_radius;
+	uint32_t vertex_hash;
+	uint32_t padding;
+	uint64_t entry_count;
+	uint64_t span_count;
+	uint64_t coverage_size;
+	uint64_t footprint_count;
+} chord_cache_header_t;
+
+// Chords one thread rasterizes while building the table
+typedef struct chord_build
+{
+	const chord_cache_t* cache;
+	size_t entry_begin;
+	size_t entry_end;
+	size_t budget;
+	chord_buffer_t buffer;
+	bool success;
+} chord_build_t;
+
+chord_cache_t null_chord_cache(void)
+{
+	chord_cache_t result;
+	result.vertices = NULL;
+	result.point_count = 0;
+	result.footprint_radius = 0;
+	result.entries = NULL;
+	result.entry_count = 0;
+	result.spans = NULL;
+	result.span_count = 0;
+	result.coverage = NULL;
+	result.coverage_size = 0;
+	result.footprints = NULL;
+	result.footprint_count = 0;
+	for (size_t i = 0; i < COVERAGE_LEVELS; ++i)
+	{
+		result.log_transmittance[i] = 0.f;
+	}
+	return result;
+}
+
+chord_buffer_t null_chord_buffer(void)
+{
+	chord_buffer_t result;
+	result.spans = NULL;
+	result.span_count = 0;
+	result.span_capacity = 0;
+	result.coverage = NULL;
+	result.coverage_size = 0;
+	result.coverage_capacity = 0;
+	result.footprints = NULL;
+	result.footprint_count = 0;
+	result.footprint_capacity = 0;
+	result.row_minimum = NULL;
+	result.row_maximum = NULL;
+	return result;
+}
+
+void destroy_chord_buffer(chord_buffer_t* buffer)
+{
+	free(buffer->spans);
+	free(buffer->coverage);
+	free(buffer->footprints);
+	free(buffer->row_minimum);
+	free(buffer->row_maximum);
+	*buffer = null_chord_buffer();
+}
+
+// Grows an array to hold at least the needed element count
+static bool reserve(void** data, size_t* capacity, size_t needed, size_t element_size)
+{
+	if (needed <= *capacity)
+	{
+		return true;
+	}
+
+	size_t new_capacity = (*capacity > 0 ? *capacity * 2 : 1024);
+	while (new_capacity < needed)
+	{
+		new_capacity *= 2;
+	}
+	void* new_data = realloc(*data, new_capacity * element_size);
+	if (new_data == NULL)
+	{
+		return false;
+	}
+	*data = new_data;
+	*capacity = new_capacity;
+	return true;
+}
+
+static size_t chord_index(size_t point_count, GLuint first, GLuint second)
+{
+	// Upper triangle of the point pair matrix, row by row
+	const size_t low = (size_t)(first < second ? first : second);
+	const size_t high = (size_t)(first < second ? second : first);
+	return ((low * ((2 * point_count) - low - 1)) / 2) + (high - low - 1);
+}
+
+static bool prepare_segment(const chord_cache_t* cache, GLuint first, GLuint second, segment_t* out)
+{
+	// Always scan from the lower index so coverage doesn't depend on direction
+	const GLuint start_index = (first < second ? first : second);
+	const GLuint end_index = (first < second ? second : first);
+	const vector2d_t start = cache->vertices[start_index];
+	const vector2d_t end = cache->vertices[end_index];
+	const float delta_x = end.x - start.x;
+	const float delta_y = end.y - start.y;
+	const float length_squared = (delta_x * delta_x) + (delta_y * delta_y);
+	if (length_squared == 0.f)
+	{
+		return false;
+	}
+
+	out->start = start;
+	out->delta_x = delta_x;
+	out->delta_y = delta_y;
+	out->inverse_length_squared = 1.f / length_squared;
+	out->reach_x = (delta_y != 0.f ? LINE_REACH * sqrtf(length_squared) / fabsf(delta_y) : 0.f);
+	out->minimum_x = fminf(start.x, end.x) - LINE_REACH;
+	out->maximum_x = fmaxf(start.x, end.x) + LINE_REACH;
+	out->first_row = (int)fmaxf(0.f, floorf(fminf(start.y, end.y) - LINE_REACH));
+	out->last_row = (int)fminf((float)TEXTURE_HEIGHT, ceilf(fmaxf(start.y, end.y) + LINE_REACH));
+	return true;
+}
+
+// Columns of a row the segment may cover
+static bool segment_row_span(const segment_t* segment, int row, int* first_column, int* last_column)
+{
+	const float offset_y = ((float)row + 0.5f) - segment->start.y;
+	float left = segment->minimum_x;
+	float right = segment->maximum_x;
+	if (segment->delta_y != 0.f)
+	{
+		const float centre_x = segment->start.x + (segment->delta_x * (offset_y / segment->delta_y));
+		left = fmaxf(left, centre_x - segment->reach_x);
+		right = fminf(right, centre_x + segment->reach_x);
+	}
+	else if (fabsf(offset_y) >= LINE_REACH)
+	{
+		return false;
+	}
+
+	*first_column = (int)fmaxf(0.f, floorf(left));
+	*last_column = (int)fminf((float)TEXTURE_WIDTH, ceilf(right));
+	return (*first_column < *last_column);
+}
+
+// Smoothed coverage of a pixel by a line of LINE_WIDTH, as an 8-bit level
+static uint8_t segment_coverage(const segment_t* segment, int row, int column)
+{
+	const float offset_x = ((float)column + 0.5f) - segment->start.x;
+	const float offset_y = ((float)row + 0.5f) - segment->start.y;
+	const float delta_x = segment->delta_x;
+	const float delta_y = segment->delta_y;
+	float t = ((offset_x * delta_x) + (offset_y * delta_y)) * segment->inverse_length_squared;
+	t = (t < 0.f ? 0.f : (t > 1.f ? 1.f : t));
+	const float distance_x = offset_x - (t * delta_x);
+	const float distance_y = offset_y - (t * delta_y);
+	const float distance = sqrtf((distance_x * distance_x) + (distance_y * distance_y));
+	float coverage = LINE_REACH - distance;
+	coverage = (coverage < 0.f ? 0.f : (coverage > 1.f ? 1.f : coverage));
+	return (uint8_t)((coverage * (float)OPAQUE_COVERAGE) + 0.5f);
+}
+
+// Appends the spans and footprint of a chord to the buffer
+static bool rasterize_chord
+(
+	const chord_cache_t* cache,
+	GLuint first,
+	GLuint second,
+	int row_begin,
+	int row_end,
+	chord_buffer_t* buffer,
+	bool* has_length
+)
+{
+	segment_t segment;
+	*has_length = prepare_segment(cache, first, second, &segment);
+	if (!*has_length)
+	{
+		return true;
+	}
+
+	if ((buffer->row_minimum == NULL) || (buffer->row_maximum == NULL))
+	{
+		free(buffer->row_minimum);
+		free(buffer->row_maximum);
+		buffer->row_minimum = (int*)malloc(APPLICATION_HEIGHT * sizeof(int));
+		buffer->row_maximum = (int*)malloc(APPLICATION_HEIGHT * sizeof(int));
+		if ((buffer->row_minimum == NULL) || (buffer->row_maximum == NULL))
+		{
+			return false;
+		}
+	}
+
+	const int first_row = (segment.first_row > row_begin ? segment.first_row : row_begin);
+	const int last_row = (segment.last_row < row_end ? segment.last_row : row_end);
+	int first_output_row = INT_MAX;
+	int last_output_row = INT_MIN;
+	for (int row = first_row; row < last_row; ++row)
+	{
+		int first_column;
+		int last_column;
+		if (!segment_row_span(&segment, row, &first_column, &last_column))
+		{
+			continue;
+		}
+
+		const size_t length = (size_t)(last_column - first_column);
+		if (!reserve((void**)&buffer->coverage, &buffer->coverage_capacity, buffer->coverage_size + length, sizeof(uint8_t)))
+		{
+			return false;
+		}
+		uint8_t* coverage = buffer->coverage + buffer->coverage_size;
+		for (int column = first_column; column < last_column; ++column)
+		{
+			coverage[column - first_column] = segment_coverage(&segment, row, column);
+		}
+
+		// Trim uncovered pixels at either end
+		size_t begin = 0;
+		size_t end = length;
+		while ((begin < end) && (coverage[begin] == 0))
+		{
+			++begin;
+		}
+		while ((end > begin) && (coverage[end - 1] == 0))
+		{
+			--end;
+		}
+		if (begin == end)
+		{
+			continue;
+		}
+		memmove(coverage, coverage + begin, end - begin);
+		buffer->coverage_size += end - begin;
+
+		if (!reserve((void**)&buffer->spans, &buffer->span_capacity, buffer->span_count + 1, sizeof(chord_span_t)))
+		{
+			return false;
+		}
+		chord_span_t* span = &buffer->spans[buffer->span_count++];
+		span->row = (uint16_t)row;
+		span->column = (uint16_t)(first_column + (int)begin);
+		span->length = (uint16_t)(end - begin);
+
+		// Track which output pixels the box filter will read this span into
+		const int output_row = row / SCALE_FACTOR;
+		const int minimum = (int)span->column / SCALE_FACTOR;
+		const int maximum = ((int)span->column + (int)span->length - 1) / SCALE_FACTOR;
+		if (output_row > last_output_row)
+		{
+			for (int i = (last_output_row < first_output_row ? output_row : last_output_row + 1); i <= output_row; ++i)
+			{
+				buffer->row_minimum[i] = INT_MAX;
+				buffer->row_maximum[i] = INT_MIN;
+			}
+			last_output_row = output_row;
+		}
+		if (output_row < first_output_row)
+		{
+			first_output_row = output_row;
+		}
+		buffer->row_minimum[output_row] = (minimum < buffer->row_minimum[output_row] ? minimum : buffer->row_minimum[output_row]);
+		buffer->row_maximum[output_row] = (maximum > buffer->row_maximum[output_row] ? maximum : buffer->row_maximum[output_row]);
+	}
+
+	if (first_output_row > last_output_row)
+	{
+		return true;
+	}
+
+	// The blur spreads each output row's range by the radius in both axes
+	const int radius = cache->footprint_radius;
+	const size_t footprint_rows = (size_t)(last_output_row - first_output_row + 1 + (2 * radius));
+	if (!reserve((void**)&buffer->footprints, &buffer->footprint_capacity, buffer->footprint_count + footprint_rows, sizeof(footprint_span_t)))
+	{
+		return false;
+	}
+	for (int row = first_output_row - radius; row <= last_output_row + radius; ++row)
+	{
+		int minimum = INT_MAX;
+		int maximum = INT_MIN;
+		for (int source_row = row - radius; source_row <= row + radius; ++source_row)
+		{
+			if ((source_row < first_output_row) || (source_row > last_output_row))
+			{
+				continue;
+			}
+			minimum = (buffer->row_minimum[source_row] < minimum ? buffer->row_minimum[source_row] : minimum);
+			maximum = (buffer->row_maximum[source_row] > maximum ? buffer->row_maximum[source_row] : maximum);
+		}
+		if (minimum > maximum)
+		{
+			continue;
+		}
+
+		footprint_span_t* footprint = &buffer->footprints[buffer->footprint_count++];
+		footprint->row = (int16_t)row;
+		footprint->column = (int16_t)(minimum - radius);
+		footprint->length = (uint16_t)(maximum - minimum + 1 + (2 * radius));
+	}
+	return true;
+}
+
+static size_t buffer_size(const chord_buffer_t* buffer)
+{
+	return (buffer->span_count * sizeof(chord_span_t)) + buffer->coverage_size + (buffer->footprint_count * sizeof(footprint_span_t));
+}
+
+static void build_chords(void* build_pointer)
+{
+	chord_build_t* build = (chord_build_t*)build_pointer;
+	const chord_cache_t* cache = build->cache;
+	chord_buffer_t* buffer = &build->buffer;
+	const size_t point_count = cache->point_count;
+	build->success = true;
+
+	size_t index = 0;
+	for (GLuint first = 0; first < point_count; ++first)
+	{
+		for (GLuint second = first + 1; second < point_count; ++second, ++index)
+		{
+			if ((index < build->entry_begin) || (index >= build->entry_end))
+			{
+				continue;
+			}
+
+			chord_entry_t* entry = &cache->entries[index];
+			const size_t span_count = buffer->span_count;
+			const size_t coverage_size = buffer->coverage_size;
+			const size_t footprint_count = buffer->footprint_count;
+			bool has_length;
+			if (!rasterize_chord(cache, first, second, 0, TEXTURE_HEIGHT, buffer, &has_length))
+			{
+				build->success = false;
+				return;
+			}
+
+			// Leave chords past the budget to be rasterized on use
+			if (buffer_size(buffer) > build->budget)
+			{
+				buffer->span_count = span_count;
+				buffer->coverage_size = coverage_size;
+				buffer->footprint_count = footprint_count;
+				entry->span_offset = CHORD_NOT_CACHED;
+				continue;
+			}
+
+			// Offsets are local to this build until merged
+			entry->span_offset = (uint32_t)span_count;
+			entry->span_count = (uint32_t)(buffer->span_count - span_count);
+			entry->coverage_offset = (uint32_t)coverage_size;
+			entry->footprint_offset = (uint32_t)footprint_count;
+			entry->footprint_count = (uint32_t)(buffer->footprint_count - footprint_count);
+		}
+	}
+}
+
+static bool build_chord_cache(chord_cache_t* cache, size_t budget, thread_pool_t* pool)
+{
+	const size_t entry_count = cache->entry_count;
+	size_t build_count = get_worker_count(pool);
+	build_count = (build_count < entry_count ? build_count : entry_count);
+	chord_build_t* builds = (chord_build_t*)calloc(build_count, sizeof(chord_build_t));
+	if (builds == NULL)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < build_count; ++i)
+	{
+		chord_build_t* build = &builds[i];
+		build->cache = cache;
+		build->entry_begin = (i * entry_count) / build_count;
+		build->entry_end = ((i + 1) * entry_count) / build_count;
+		build->budget = budget / build_count;
+		build->buffer = null_chord_buffer();
+	}
+	run_tasks(pool, &build_chords, builds, sizeof(chord_build_t), build_count);
+
+	bool success = true;
+	size_t span_count = 0;
+	size_t coverage_size = 0;
+	size_t footprint_count = 0;
+	for (size_t i = 0; i < build_count; ++i)
+	{
+		success = (success && builds[i].success);
+		span_count += builds[i].buffer.span_count;
+		coverage_size += builds[i].buffer.coverage_size;
+		footprint_count += builds[i].buffer.footprint_count;
+	}
+
+	// Merge the per-thread pools in chord order
+	cache->spans = (chord_span_t*)malloc((span_count > 0 ? span_count : 1) * sizeof(chord_span_t));
+	cache->coverage = (uint8_t*)malloc(coverage_size > 0 ? coverage_size : 1);
+	cache->footprints = (footprint_span_t*)malloc((footprint_count > 0 ? footprint_count : 1) * sizeof(footprint_span_t));
+	success = (success && (cache->spans != NULL) && (cache->coverage != NULL) && (cache->footprints != NULL));
+	if (success)
+	{
+		size_t span_base = 0;
+		size_t coverage_base = 0;
+		size_t footprint_base = 0;
+		for (size_t i = 0; i < build_count; ++i)
+		{
+			const chord_buffer_t* buffer = &builds[i].buffer;
+			memcpy(cache->spans + span_base, buffer->spans, buffer->span_count * sizeof(chord_span_t));
+			memcpy(cache->coverage + coverage_base, buffer->coverage, buffer->coverage_size);
+			memcpy(cache->footprints + footprint_base, buffer->footprints, buffer->footprint_count * sizeof(footprint_span_t));
+			for (size_t j = builds[i].entry_begin; j < builds[i].entry_end; ++j)
+			{
+				chord_entry_t* entry = &cache->entries[j];
+				if (entry->span_offset != CHORD_NOT_CACHED)
+				{
+					entry->span_offset += (uint32_t)span_base;
+					entry->coverage_offset += (uint32_t)coverage_base;
+					entry->footprint_offset += (uint32_t)footprint_base;
+				}
+			}
+			span_base += buffer->span_count;
+			coverage_base += buffer->coverage_size;
+			footprint_base += buffer->footprint_count;
+		}
+		cache->span_count = span_count;
+		cache->coverage_size = coverage_size;
+		cache->footprint_count = footprint_count;
+	}
+
+	for (size_t i = 0; i < build_count; ++i)
+	{
+		destroy_chord_buffer(&builds[i].buffer);
+	}
+	free(builds);
+	return success;
+}
+
+static uint32_t hash_vertices(const vector2d_t* vertices, size_t point_count)
+{
+	// FNV-1a
+	const uint8_t* bytes = (const uint8_t*)vertices;
+	const size_t size = point_count * sizeof(vector2d_t);
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static chord_cache_header_t expected_header(const chord_cache_t* cache)
+{
+	chord_cache_header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CHORD_CACHE_MAGIC, sizeof(header.magic));
+	header.version = CHORD_CACHE_VERSION;
+	header.point_count = (uint32_t)cache->point_count;
+	header.texture_width = TEXTURE_WIDTH;
+	header.texture_height = TEXTURE_HEIGHT;
+	header.scale_factor = SCALE_FACTOR;
+	header.line_width = LINE_WIDTH;
+	header.footprint_radius = cache->footprint_radius;
+	header.vertex_hash = hash_vertices(cache->vertices, cache->point_count);
+	header.entry_count = cache->entry_count;
+	return header;
+}
+
+// Every cached chord's runs have to lie inside the tables read with it, and
+// their pixels inside the canvas, or blur reach of the output
+static bool check_chord_entries(const chord_cache_t* cache)
+{
+	const int radius = cache->footprint_radius;
+	for (size_t i = 0; i < cache->entry_count; ++i)
+	{
+		const chord_entry_t* entry = &cache->entries[i];
+		if (entry->span_offset == CHORD_NOT_CACHED)
+		{
+			continue;
+		}
+		if (((uint64_t)entry->span_offset + entry->span_count > cache->span_count)
+			|| ((uint64_t)entry->footprint_offset + entry->footprint_count > cache->footprint_count))
+		{
+			return false;
+		}
+
+		uint64_t coverage_end = entry->coverage_offset;
+		for (size_t j = 0; j < entry->span_count; ++j)
+		{
+			const chord_span_t* span = &cache->spans[entry->span_offset + j];
+			if ((span->row >= TEXTURE_HEIGHT) || ((int)span->column + (int)span->length > TEXTURE_WIDTH))
+			{
+				return false;
+			}
+			coverage_end += span->length;
+		}
+		if (coverage_end > cache->coverage_size)
+		{
+			return false;
+		}
+
+		for (size_t j = 0; j < entry->footprint_count; ++j)
+		{
+			const footprint_span_t* footprint = &cache->footprints[entry->footprint_offset + j];
+			if ((footprint->row < -radius) || (footprint->row >= APPLICATION_HEIGHT + radius)
+				|| (footprint->column < -radius) || ((int)footprint->column + (int)footprint->length > APPLICATION_WIDTH + radius))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static bool load_chord_cache(chord_cache_t* cache, size_t budget, const char* filename)
+{
+	FILE* file = fopen(filename, "rb");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	// Geometry has to match exactly, and the table has to fit the budget
+	const chord_cache_header_t expected = expected_header(cache);
+	chord_cache_header_t header;
+	if ((fread(&header, sizeof(header), 1, file) != 1)
+		|| (memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0)
+		|| (header.version != expected.version)
+		|| (header.point_count != expected.point_count)
+		|| (header.texture_width != expected.texture_width)
+		|| (header.texture_height != expected.texture_height)
+		|| (header.scale_factor != expected.scale_factor)
+		|| (header.line_width != expected.line_width)
+		|| (header.footprint_radius != expected.footprint_radius)
+		|| (header.vertex_hash != expected.vertex_hash)
+		|| (header.entry_count != expected.entry_count))
+	{
+		printf("Chord cache %s doesn't match, rebuilding.\n", filename);
+		fclose(file);
+		return false;
+	}
+	const size_t data_size = ((size_t)header.span_count * sizeof(chord_span_t)) + (size_t)header.coverage_size + ((size_t)header.footprint_count * sizeof(footprint_span_t));
+	if (data_size > budget)
+	{
+		printf("Chord cache %s is over budget, rebuilding.\n", filename);
+		fclose(file);
+		return false;
+	}
+
+	cache->span_count = (size_t)header.span_count;
+	cache->coverage_size = (size_t)header.coverage_size;
+	cache->footprint_count = (size_t)header.footprint_count;
+	cache->spans = (chord_span_t*)malloc((cache->span_count > 0 ? cache->span_count : 1) * sizeof(chord_span_t));
+	cache->coverage = (uint8_t*)malloc(cache->coverage_size > 0 ? cache->coverage_size : 1);
+	cache->footprints = (footprint_span_t*)malloc((cache->footprint_count > 0 ? cache->footprint_count : 1) * sizeof(footprint_span_t));
+	const bool success = (cache->spans != NULL) && (cache->coverage != NULL) && (cache->footprints != NULL)
+		&& (fread(cache->entries, sizeof(chord_entry_t), cache->entry_count, file) == cache->entry_count)
+		&& (fread(cache->spans, sizeof(chord_span_t), cache->span_count, file) == cache->span_count)
+		&& (fread(cache->coverage, 1, cache->coverage_size, file) == cache->coverage_size)
+		&& (fread(cache->footprints, sizeof(footprint_span_t), cache->footprint_count, file) == cache->footprint_count);
+	fclose(file);
+	if (!success || !check_chord_entries(cache))
+	{
+		printf("Failed to read chord cache %s, rebuilding.\n", filename);
+		free(cache->spans);
+		free(cache->coverage);
+		free(cache->footprints);
+		cache->spans = NULL;
+		cache->coverage = NULL;
+		cache->footprints = NULL;
+		return false;
+	}
+	return true;
+}
+
+static bool save_chord_cache(const chord_cache_t* cache, const char* filename)
+{
+	// Write next to the destination and move into place so readers never see
+	// a partial file; named for the process, as others may build the same
+	// cache at once
+	const size_t temporary_length = strlen(filename) + 32;
+	char* temporary_filename = (char*)malloc(temporary_length);
+	if (temporary_filename == NULL)
+	{
+		return false;
+	}
+	snprintf(temporary_filename, temporary_length, "%s.%lu.tmp", filename, get_process_id());
+
+	FILE* file = fopen(temporary_filename, "wb");
+	if (file == NULL)
+	{
+		printf("Failed to open %s for write.\n", temporary_filename);
+		free(temporary_filename);
+		return false;
+	}
+
+	chord_cache_header_t header = expected_header(cache);
+	header.span_count = cache->span_count;
+	header.coverage_size = cache->coverage_size;
+	header.footprint_count = cache->footprint_count;
+	bool success = (fwrite(&header, sizeof(header), 1, file) == 1)
+		&& (fwrite(cache->entries, sizeof(chord_entry_t), cache->entry_count, file) == cache->entry_count)
+		&& (fwrite(cache->spans, sizeof(chord_span_t), cache->span_count, file) == cache->span_count)
+		&& (fwrite(cache->coverage, 1, cache->coverage_size, file) == cache->coverage_size)
+		&& (fwrite(cache->footprints, sizeof(footprint_span_t), cache->footprint_count, file) == cache->footprint_count);
+	success = (fclose(file) == 0) && success;
+
+	// POSIX rename replaces the destination atomically; Windows needs it gone
+	if (success)
+	{
+#if defined(WIN32)
+		remove(filename);
+#endif
+		success = (rename(temporary_filename, filename) == 0);
+	}
+	if (!success)
+	{
+		printf("Failed to write chord cache %s.\n", filename);
+		remove(temporary_filename);
+	}
+	free(temporary_filename);
+	return success;
+}
+
+bool create_chord_cache
+(
+	const vector2d_t* vertices,
+	size_t point_count,
+	int footprint_radius,
+	size_t budget,
+	const char* filename,
+	thread_pool_t* pool,
+	chord_cache_t* out
+)
+{
+	out->vertices = vertices;
+	out->point_count = point_count;
+	out->footprint_radius = footprint_radius;
+	for (size_t i = 0; i < OPAQUE_COVERAGE; ++i)
+	{
+		const float coverage = (float)i / (float)OPAQUE_COVERAGE;
+		out->log_transmittance[i] = log1pf(-coverage);
+	}
+	out->log_transmittance[OPAQUE_COVERAGE] = 0.f;
+
+	out->entry_count = (point_count * (point_count - 1)) / 2;
+	out->entries = (chord_entry_t*)malloc(out->entry_count * sizeof(chord_entry_t));
+	if (out->entries == NULL)
+	{
+		printf("Failed to allocate chord table.\n");
+		return false;
+	}
+
+	if ((filename != NULL) && load_chord_cache(out, budget, filename))
+	{
+		printf("Loaded %d chords from %s.\n", (int)out->entry_count, filename);
+		return true;
+	}
+
+	printf("Building chord cache...\n");
+	if (!build_chord_cache(out, budget, pool))
+	{
+		destroy_chord_cache(out);
+		printf("Failed to build chord cache.\n");
+		return false;
+	}
+
+	size_t cached_count = 0;
+	for (size_t i = 0; i < out->entry_count; ++i)
+	{
+		cached_count += (out->entries[i].span_offset != CHORD_NOT_CACHED ? 1 : 0);
+	}
+	printf("Cached %d of %d chords in %d bytes.\n", (int)cached_count, (int)out->entry_count, (int)(out->coverage_size + (out->span_count * sizeof(chord_span_t))));
+
+	// A missing cache file only costs the next start
+	if (filename != NULL)
+	{
+		save_chord_cache(out, filename);
+	}
+	return true;
+}
+
+void destroy_chord_cache(chord_cache_t* cache)
+{
+	free(cache->entries);
+	free(cache->spans);
+	free(cache->coverage);
+	free(cache->footprints);
+	*cache = null_chord_cache();
+}
+
+bool get_chord
+(
+	const chord_cache_t* cache,
+	GLuint first,
+	GLuint second,
+	int row_begin,
+	int row_end,
+	chord_buffer_t* buffer,
+	chord_view_t* out
+)
+{
+	if (first == second)
+	{
+		return false;
+	}
+
+	const chord_entry_t* entry = &cache->entries[chord_index(cache->point_count, first, second)];
+	if (entry->span_offset != CHORD_NOT_CACHED)
+	{
+		if (entry->span_count == 0)
+		{
+			return false;
+		}
+		out->spans = cache->spans + entry->span_offset;
+		out->span_count = entry->span_count;
+		out->coverage = cache->coverage + entry->coverage_offset;
+		out->footprints = cache->footprints + entry->footprint_offset;
+		out->footprint_count = entry->footprint_count;
+		return true;
+	}
+
+	buffer->span_count = 0;
+	buffer->coverage_size = 0;
+	buffer->footprint_count = 0;
+	bool has_length;
+	if (!rasterize_chord(cache, first, second, row_begin, row_end, buffer, &has_length) || !has_length || (buffer->span_count == 0))
+	{
+		return false;
+	}
+	out->spans = buffer->spans;
+	out->span_count = buffer->span_count;
+	out->coverage = buffer->coverage;
+	out->footprints = buffer->footprints;
+	out->footprint_count = buffer->footprint_count;
+	return true;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "thread_pool.h"
+#include "vector2d.h"
+#include <GL/glew.h>
+#include <GL/gl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHORD_CACHE_FILENAME "chords.cache"
+
+// Most memory spent on cached coverage; chords past it are rasterized on use
+#define CHORD_CACHE_BUDGET ((size_t)384 * 1024 * 1024)
+
+// Coverage is stored as 8-bit levels; the top level is fully covered
+#define COVERAGE_LEVELS 256
+#define OPAQUE_COVERAGE 255
+
+// Distance from the line centre at which smoothed coverage reaches zero
+#define LINE_REACH ((LINE_WIDTH * 0.5f) + 0.5f)
+
+// Run of covered canvas pixels on one row; coverage levels for the run are
+// stored contiguously in the same order.
+typedef struct chord_span
+{
+	uint16_t row;
+	uint16_t column;
+	uint16_t length;
+} chord_span_t;
+
+// Run of output pixels whose blurred value a chord can change. Coordinates are
+// not wrapped, so may fall up to the blur radius outside the image;
+// validate_config keeps the output small enough for them to fit.
+typedef struct footprint_span
+{
+	int16_t row;
+	int16_t column;
+	uint16_t length;
+} footprint_span_t;
+
+typedef struct chord_entry
+{
+	uint32_t span_offset;
+	uint32_t span_count;
+	uint32_t coverage_offset;
+	uint32_t footprint_offset;
+	uint32_t footprint_count;
+} chord_entry_t;
+
+// Spans of a single chord, either from the cache or rasterized on demand
+typedef struct chord_view
+{
+	const chord_span_t* spans;
+	size_t span_count;
+	const uint8_t* coverage;
+	const footprint_span_t* footprints;
+	size_t footprint_count;
+} chord_view_t;
+
+// Growable storage for chords rasterized on demand
+typedef struct chord_buffer
+{
+	chord_span_t* spans;
+	size_t span_count;
+	size_t span_capacity;
+	uint8_t* coverage;
+	size_t coverage_size;
+	size_t coverage_capacity;
+	footprint_span_t* footprints;
+	size_t footprint_count;
+	size_t footprint_capacity;
+
+	// Covered column range of each output row, for building footprints
+	int* row_minimum;
+	int* row_maximum;
+} chord_buffer_t;
+
+// Rasterized coverage and blur footprint of every chord between two points
+typedef struct chord_cache
+{
+	const vector2d_t* vertices;
+	size_t point_count;
+	int footprint_radius;
+
+	chord_entry_t* entries;
+	size_t entry_count;
+	chord_span_t* spans;
+	size_t span_count;
+	uint8_t* coverage;
+	size_t coverage_size;
+	footprint_span_t* footprints;
+	size_t footprint_count;
+
+	// log(1 - coverage) for each level below OPAQUE_COVERAGE
+	float log_transmittance[COVERAGE_LEVELS];
+} chord_cache_t;
+
+chord_cache_t null_chord_cache(void);
+
+// Loads the table from file if it matches the geometry, otherwise builds it
+// on the pool and writes it back. Vertices are in canvas space and must
+// outlive the cache.
+bool create_chord_cache
+(
+	const vector2d_t* vertices,
+	size_t point_count,
+	int footprint_radius,
+	size_t budget,
+	const char* filename,
+	thread_pool_t* pool,
+	chord_cache_t* out
+);
+void destroy_chord_cache(chord_cache_t* cache);
+
+chord_buffer_t null_chord_buffer(void);
+void destroy_chord_buffer(chord_buffer_t* buffer);
+
+// Finds the spans of the chord between two points. Uncached chords are
+// rasterized into the buffer, limited to canvas rows [row_begin, row_end).
+// Returns false for chords of zero length.
+bool get_chord
+(
+	const chord_cache_t* cache,
+	GLuint first,
+	GLuint second,
+	int row_begin,
+	int row_end,
+	chord_buffer_t* buffer,
+	chord_view_t* out
+);
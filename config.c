@@ -0,0 +1,251 @@
+#include "config.h"
+#include "blur.h"
+#include "shared.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CONFIG_LINE_LENGTH 256
+
+config_t config =
+{
+	DEFAULT_APPLICATION_WIDTH,
+	DEFAULT_APPLICATION_HEIGHT,
+	DEFAULT_SCALE_FACTOR,
+	DEFAULT_POINT_COUNT,
+	DEFAULT_LINES,
+	DEFAULT_FITTEST_COUNT,
+	DEFAULT_OFFSPRING_PER_FITTEST,
+	DEFAULT_SAMPLE_RADIUS
+};
+
+// Setting names shared by the file and the command line
+typedef struct config_setting
+{
+	const char* name;
+	size_t offset;
+} config_setting_t;
+
+static const config_setting_t config_settings[] =
+{
+	{ "width", offsetof(config_t, application_width) },
+	{ "height", offsetof(config_t, application_height) },
+	{ "scale", offsetof(config_t, scale_factor) },
+	{ "nails", offsetof(config_t, point_count) },
+	{ "lines", offsetof(config_t, lines) },
+	{ "fittest", offsetof(config_t, fittest_count) },
+	{ "offspring", offsetof(config_t, offspring_per_fittest) },
+	{ "sample-radius", offsetof(config_t, sample_radius) }
+};
+#define CONFIG_SETTING_COUNT (sizeof(config_settings) / sizeof(config_settings[0]))
+
+static int* find_setting(config_t* settings, const char* name)
+{
+	for (size_t i = 0; i < CONFIG_SETTING_COUNT; ++i)
+	{
+		if (strcmp(config_settings[i].name, name) == 0)
+		{
+			return (int*)((char*)settings + config_settings[i].offset);
+		}
+	}
+	return NULL;
+}
+
+static bool set_setting(config_t* settings, const char* name, const char* value)
+{
+	int* setting = find_setting(settings, name);
+	if (setting == NULL)
+	{
+		printf("Unknown setting '%s'.\n", name);
+		return false;
+	}
+
+	char* end;
+	const long number = strtol(value, &end, 10);
+	if ((end == value) || (*end != '\0') || (number < 0) || (number > INT32_MAX))
+	{
+		printf("Invalid value '%s' for setting '%s'.\n", value, name);
+		return false;
+	}
+	*setting = (int)number;
+	return true;
+}
+
+// Trims whitespace from both ends in place
+static char* trim(char* text)
+{
+	while ((*text == ' ') || (*text == '\t'))
+	{
+		++text;
+	}
+	size_t length = strlen(text);
+	while ((length > 0) && ((text[length - 1] == ' ') || (text[length - 1] == '\t') || (text[length - 1] == '\n') || (text[length - 1] == '\r')))
+	{
+		text[--length] = '\0';
+	}
+	return text;
+}
+
+bool load_config_file(const char* filename, config_t* out)
+{
+	FILE* file = fopen(filename, "r");
+	if (file == NULL)
+	{
+		printf("Failed to open config file %s.\n", filename);
+		return false;
+	}
+
+	bool success = true;
+	int line_number = 0;
+	char line[CONFIG_LINE_LENGTH];
+	while (success && (fgets(line, sizeof(line), file) != NULL))
+	{
+		++line_number;
+		char* comment = strchr(line, '#');
+		if (comment != NULL)
+		{
+			*comment = '\0';
+		}
+		char* text = trim(line);
+		if (*text == '\0')
+		{
+			continue;
+		}
+
+		char* separator = strchr(text, '=');
+		if (separator == NULL)
+		{
+			printf("Expected 'name = value' on line %d of %s.\n", line_number, filename);
+			success = false;
+			break;
+		}
+		*separator = '\0';
+		success = set_setting(out, trim(text), trim(separator + 1));
+	}
+	fclose(file);
+	return success;
+}
+
+bool has_argument(int argc, char** argv, const char* name)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], name) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* find_argument_value(int argc, char** argv, const char* name)
+{
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		if (strcmp(argv[i], name) == 0)
+		{
+			return argv[i + 1];
+		}
+	}
+	return NULL;
+}
+
+bool parse_config_arguments(int argc, char** argv, config_t* out)
+{
+	const char* filename = find_argument_value(argc, argv, CONFIG_ARGUMENT);
+	if ((filename != NULL) && !load_config_file(filename, out))
+	{
+		return false;
+	}
+
+	// Options override the file, whatever order they come in
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		const char* argument = argv[i];
+		if ((strncmp(argument, "--", 2) == 0) && (find_setting(out, argument + 2) != NULL))
+		{
+			if (!set_setting(out, argument + 2, argv[i + 1]))
+			{
+				return false;
+			}
+			++i;
+		}
+	}
+	return true;
+}
+
+bool validate_config(const config_t* settings)
+{
+	// Chord spans store canvas coordinates in 16 bits
+	const int64_t texture_width = (int64_t)settings->application_width * (int64_t)settings->scale_factor;
+	const int64_t texture_height = (int64_t)settings->application_height * (int64_t)settings->scale_factor;
+	if ((settings->application_width < 1) || (settings->application_height < 1) || (settings->scale_factor < 1)
+		|| (texture_width > UINT16_MAX) || (texture_height > UINT16_MAX))
+	{
+		printf("Resolution must be at least 1 and at most %d canvas pixels across.\n", UINT16_MAX);
+		return false;
+	}
+
+	// Blur footprints store output coordinates, up to the kernel radius past
+	// either edge, in 16 signed bits
+	const blur_kernel_t blur = create_blur_kernel(1.f, get_blur_sigma(settings->sample_radius) / (float)settings->scale_factor);
+	const int footprint_limit = INT16_MAX - get_blur_kernel_radius(&blur);
+	if ((settings->application_width > footprint_limit) || (settings->application_height > footprint_limit))
+	{
+		printf("Resolution must be at most %d output pixels across at this sample radius and scale.\n", footprint_limit);
+		return false;
+	}
+#if !USE_CIRCLE
+	if ((settings->point_count % SQUARE_SIDES) != 0)
+	{
+		printf("Nails must be a multiple of %d around a square.\n", SQUARE_SIDES);
+		return false;
+	}
+#endif
+	if ((settings->point_count < 2) || (settings->point_count > MAXIMUM_POINT_COUNT))
+	{
+		printf("Nails must be at least 2 and at most %d.\n", MAXIMUM_POINT_COUNT);
+		return false;
+	}
+	if ((settings->lines < 1) || (settings->lines > MAXIMUM_LINES))
+	{
+		printf("Lines must be at least 1 and at most %d.\n", MAXIMUM_LINES);
+		return false;
+	}
+	if (settings->fittest_count < 1)
+	{
+		printf("At least 1 candidate must survive each generation.\n");
+		return false;
+	}
+
+	// Settings are never negative, and each factor is bounded before it's
+	// multiplied, so the products can't overflow
+	const int64_t candidate_count = (int64_t)settings->fittest_count * (1 + (int64_t)settings->offspring_per_fittest);
+	if ((settings->fittest_count > MAXIMUM_CANDIDATE_COUNT) || (settings->offspring_per_fittest > MAXIMUM_CANDIDATE_COUNT)
+		|| (candidate_count > MAXIMUM_CANDIDATE_COUNT))
+	{
+		printf("Fittest with their offspring must make at most %d candidates.\n", MAXIMUM_CANDIDATE_COUNT);
+		return false;
+	}
+	if ((candidate_count * (int64_t)settings->lines * 2) > INT32_MAX)
+	{
+		printf("Candidates times lines must be at most %d.\n", INT32_MAX / 2);
+		return false;
+	}
+	return true;
+}
+
+void print_config(const config_t* settings)
+{
+	printf("Resolution %dx%d at %dx scale, %d nails, %d lines, %d fittest with %d offspring each, sample radius %d.\n",
+		settings->application_width,
+		settings->application_height,
+		settings->scale_factor,
+		settings->point_count,
+		settings->lines,
+		settings->fittest_count,
+		settings->offspring_per_fittest,
+		settings->sample_radius);
+}
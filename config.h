@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+
+#define CONFIG_ARGUMENT "--config"
+
+// Settings a run can change without rebuilding. Fields are ints so the
+// macros in shared.h keep the types the constants they replace had.
+typedef struct config
+{
+	int application_width;
+	int application_height;
+	int scale_factor;
+	int point_count;
+	int lines;
+	int fittest_count;
+	int offspring_per_fittest;
+	int sample_radius;
+} config_t;
+
+// Settings in use; only written while starting up, before any threads run
+extern config_t config;
+
+// Reads "name = value" lines, with '#' starting a comment. Names are the
+// command line options without their dashes.
+bool load_config_file(const char* filename, config_t* out);
+
+// Whether the option is anywhere on the command line
+bool has_argument(int argc, char** argv, const char* name);
+
+// Value following the first use of the option, or NULL if it's absent or
+// has nothing after it
+const char* find_argument_value(int argc, char** argv, const char* name);
+
+// Loads the file given with --config, then applies any "--name value"
+// options over it
+bool parse_config_arguments(int argc, char** argv, config_t* out);
+bool validate_config(const config_t* settings);
+void print_config(const config_t* settings);
@@ -1,6 +1,15 @@
 #include "file_io.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#if defined(WIN32)
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 file_buffer_t null_file_buffer(void)
 {
@@ -69,3 +78,146 @@ void destroy_file_buffer(file_buffer_t* file_buffer)
 	}
 	file_buffer->length = 0;
 }
+
+mapped_file_t null_mapped_file(void)
+{
+	mapped_file_t result;
+	result.data = NULL;
+	result.length = 0;
+#if defined(WIN32)
+	result.file = INVALID_HANDLE_VALUE;
+	result.mapping = NULL;
+#endif
+	return result;
+}
+
+bool map_file(const char* filename, mapped_file_t* out)
+{
+#if defined(WIN32)
+	out->file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	LARGE_INTEGER size;
+	if ((out->file == INVALID_HANDLE_VALUE) || !GetFileSizeEx(out->file, &size) || (size.QuadPart == 0))
+	{
+		unmap_file(out);
+		return false;
+	}
+	out->mapping = CreateFileMappingA(out->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	out->data = (out->mapping != NULL ? MapViewOfFile(out->mapping, FILE_MAP_READ, 0, 0, 0) : NULL);
+	if (out->data == NULL)
+	{
+		printf("Failed to map %s.\n", filename);
+		unmap_file(out);
+		return false;
+	}
+	out->length = (size_t)size.QuadPart;
+#else
+	const int file = open(filename, O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+	struct stat status;
+	if ((fstat(file, &status) != 0) || (status.st_size == 0))
+	{
+		close(file);
+		return false;
+	}
+
+	// The mapping keeps the file alive once the descriptor is closed
+	void* data = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (data == MAP_FAILED)
+	{
+		printf("Failed to map %s.\n", filename);
+		return false;
+	}
+	out->data = data;
+	out->length = (size_t)status.st_size;
+#endif
+	return true;
+}
+
+void unmap_file(mapped_file_t* mapped_file)
+{
+#if defined(WIN32)
+	if (mapped_file->data != NULL)
+	{
+		UnmapViewOfFile(mapped_file->data);
+	}
+	if (mapped_file->mapping != NULL)
+	{
+		CloseHandle(mapped_file->mapping);
+	}
+	if (mapped_file->file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(mapped_file->file);
+	}
+#else
+	if (mapped_file->data != NULL)
+	{
+		munmap((void*)mapped_file->data, mapped_file->length);
+	}
+#endif
+	*mapped_file = null_mapped_file();
+}
+
+bool sync_file(FILE* file)
+{
+	if (fflush(file) != 0)
+	{
+		return false;
+	}
+#if defined(WIN32)
+	return (_commit(_fileno(file)) == 0);
+#else
+	return (fsync(fileno(file)) == 0);
+#endif
+}
+
+bool sync_directory(const char* filename)
+{
+#if defined(WIN32)
+	(void)filename;
+	return true;
+#else
+	// Directory part of the path, or the working directory if there is none
+	const char* slash = strrchr(filename, '/');
+	const size_t length = (slash != NULL ? (size_t)(slash - filename) : 0);
+	char* directory = (char*)malloc(length + 2);
+	if (directory == NULL)
+	{
+		return false;
+	}
+	if (slash == NULL)
+	{
+		memcpy(directory, ".", 2);
+	}
+	else
+	{
+		memcpy(directory, filename, length);
+		directory[length] = '\0';
+		if (length == 0)
+		{
+			memcpy(directory, "/", 2);
+		}
+	}
+	const int descriptor = open(directory, O_RDONLY);
+	free(directory);
+	if (descriptor < 0)
+	{
+		return false;
+	}
+	const bool synced = (fsync(descriptor) == 0);
+	close(descriptor);
+	return synced;
+#endif
+}
+
+unsigned long get_process_id(void)
+{
+#if defined(WIN32)
+	return (unsigned long)GetCurrentProcessId();
+#else
+	return (unsigned long)getpid();
+#endif
+}
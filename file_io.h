@@ -1,6 +1,10 @@
 #pragma once
 
+#if defined(WIN32)
+#include <Windows.h>
+#endif
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 typedef struct file_buffer
@@ -12,3 +16,30 @@ typedef struct file_buffer
 file_buffer_t null_file_buffer(void);
 bool read_file(const char* filename, file_buffer_t* out);
 void destroy_file_buffer(file_buffer_t* file_buffer);
+
+// Read-only view of a whole file, paged in on first touch
+typedef struct mapped_file
+{
+	const void* data;
+	size_t length;
+#if defined(WIN32)
+	HANDLE file;
+	HANDLE mapping;
+#endif
+} mapped_file_t;
+
+mapped_file_t null_mapped_file(void);
+bool map_file(const char* filename, mapped_file_t* out);
+void unmap_file(mapped_file_t* mapped_file);
+
+// Pushes what was written to the file through to the disk, so it survives
+// a power loss rather than just the process ending
+bool sync_file(FILE* file);
+
+// Makes a file renamed into the directory holding the filename survive a
+// power loss too; Windows has no way to, and nothing to do
+bool sync_directory(const char* filename);
+
+// Identifies this process, so processes writing the same file can keep
+// their temporary files apart
+unsigned long get_process_id(void);
@@ -1,9 +1,9 @@
 #include "generation.h"
+#include "reduce.h"
 #include <assert.h>
 #include <float.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
 
 // Iteration tweaks
 enum mutations
@@ -14,176 +14,428 @@ enum mutations
 	MUTATION_MAX
 } mutations_t;
 
-generation_t create_generation(void)
+mutation_edit_t null_mutation_edit(void)
+{
+	mutation_edit_t result;
+	result.kind = MUTATION_EDIT_NONE;
+	result.position = 0;
+	result.value = 0;
+	return result;
+}
+
+mutation_t null_mutation(void)
+{
+	mutation_t result;
+	result.edit = null_mutation_edit();
+	result.removed_count = 0;
+	result.added_count = 0;
+	return result;
+}
+
+static void add_chord(chord_t* chords, size_t* count, GLuint start, GLuint end)
+{
+	assert(*count < MUTATION_MAXIMUM_CHORDS);
+	chord_t* chord = &chords[(*count)++];
+	chord->start = start;
+	chord->end = end;
+}
+
+// Offspring mutated on the pool, each with its own generator
+typedef struct breed_job
+{
+	const generation_t* parent;
+	generation_t* offspring;
+	random_state_t random;
+} breed_job_t;
+
+generation_t create_generation(random_state_t* random)
 {
 	generation_t result;
 
 	// Fill random line
-	const size_t index_buffer_size = LINES_INDEX_COUNT * sizeof(GLuint);
-	GLuint* indices = (GLuint*)malloc(index_buffer_size);
-	indices[0] = (GLuint)(rand() % POINT_COUNT);
-	indices[1] = (GLuint)(rand() % POINT_COUNT);
-	result.indices = indices;
-	result.index_count = 2;
-	const size_t score_buffer_size = APPLICATION_PIXEL_COUNT * sizeof(GLfloat);
-	GLfloat* score_buffer = (GLfloat*)malloc(score_buffer_size);
-	result.score_buffer = score_buffer;
-	result.score = FLT_MAX;
-	result.score_thread = NULL;
+	nail_t nails[2];
+	nails[0] = (random != NULL ? (nail_t)random_below(random, POINT_COUNT) : 0);
+	nails[1] = (random != NULL ? (nail_t)random_below(random, POINT_COUNT) : 0);
+	if (!create_genome(nails, 2, &result.genome))
+	{
+		printf("Failed to allocate genome.\n");
+	}
+	result.nails = NULL;
+	result.nail_capacity = 0;
+	result.nails_current = false;
+	result.score_pixels = NULL;
+	result.score_pixel_count = APPLICATION_PIXEL_COUNT;
+	result.score_cutoff = DBL_MAX;
+	result.score = DBL_MAX;
+	result.mutation = null_mutation();
+	result.parent_slot = 0;
+	result.state = NULL;
+	result.parent_state = NULL;
 
 	return result;
 }
 
 void destroy_generation(generation_t* generation)
 {
-	GLuint* indices = generation->indices;
-	if (indices != NULL)
+	destroy_genome(&generation->genome);
+	nail_t* nails = generation->nails;
+	if (nails != NULL)
 	{
-		free(indices);
-		generation->indices = NULL;
+		free(nails);
+		generation->nails = NULL;
 	}
-	generation->index_count = 0;
+	generation->nail_capacity = 0;
+	generation->nails_current = false;
+
+	generation->score_pixels = NULL;
+	generation->score = DBL_MAX;
+}
 
-	GLfloat* score_buffer = generation->score_buffer;
-	if (score_buffer != NULL)
+size_t get_generation_length(const generation_t* generation)
+{
+	return get_genome_length(&generation->genome);
+}
+
+const nail_t* get_generation_nails(generation_t* generation)
+{
+	if (generation->nails_current)
 	{
-		free(score_buffer);
-		generation->score_buffer = NULL;
+		return generation->nails;
 	}
-	generation->score = FLT_MAX;
+
+	// Grow by doubling so a genome lengthening one nail at a time doesn't
+	// reallocate every generation
+	const size_t length = get_genome_length(&generation->genome);
+	if (length > generation->nail_capacity)
+	{
+		size_t capacity = (generation->nail_capacity > 0 ? generation->nail_capacity : 2);
+		while (capacity < length)
+		{
+			capacity *= 2;
+		}
+		nail_t* nails = (nail_t*)realloc(generation->nails, capacity * sizeof(nail_t));
+		if (nails == NULL)
+		{
+			return NULL;
+		}
+		generation->nails = nails;
+		generation->nail_capacity = capacity;
+	}
+	export_genome(&generation->genome, generation->nails);
+	generation->nails_current = true;
+	return generation->nails;
 }
 
-void mutate_generation(const generation_t* source, generation_t* destination)
+bool set_generation_nails(generation_t* generation, const nail_t* nails, size_t count)
 {
-	// Copy over first
-	copy_generation(source, destination);
-	GLuint* indices = destination->indices;
-	const size_t index_count = destination->index_count;
+	genome_t genome;
+	if (!create_genome(nails, count, &genome))
+	{
+		return false;
+	}
+	destroy_genome(&generation->genome);
+	generation->genome = genome;
+	generation->nails_current = false;
+	return true;
+}
+
+// Applies the edit to the destination's genome, recording the chords it
+// changes. Edits that don't fit the strip leave it as it is, as do edits
+// a node can't be allocated for, which are recorded as no edit at all.
+static void apply_edit(generation_t* destination, const mutation_edit_t* edit)
+{
+	genome_t* genome = &destination->genome;
+	const size_t nail_count = get_genome_length(genome);
+	mutation_t* record = &destination->mutation;
+	*record = null_mutation();
+	record->edit = *edit;
 
-	const int mutation = rand() % MUTATION_MAX;
-	switch (mutation)
+	bool applied = true;
+	switch (edit->kind)
 	{
 		case CHANGE_INDEX:
 		{
-			// Randomly change an index
-			const size_t random_index = (size_t)(rand() % index_count);
-			const GLuint new_value = (GLuint)(rand() % POINT_COUNT);
-			indices[random_index] = new_value;
-			assert(indices[random_index] < POINT_COUNT);
+			// Change a nail
+			const size_t changed_index = (size_t)edit->position;
+			const nail_t new_value = (nail_t)edit->value;
+			assert(changed_index < nail_count);
+			assert(new_value < POINT_COUNT);
+			const nail_t old_value = get_genome_nail(genome, changed_index);
+
+			// Both chords meeting at the nail move
+			if (changed_index > 0)
+			{
+				const nail_t previous = get_genome_nail(genome, changed_index - 1);
+				add_chord(record->removed, &record->removed_count, previous, old_value);
+				add_chord(record->added, &record->added_count, previous, new_value);
+			}
+			if (changed_index + 1 < nail_count)
+			{
+				const nail_t next = get_genome_nail(genome, changed_index + 1);
+				add_chord(record->removed, &record->removed_count, old_value, next);
+				add_chord(record->added, &record->added_count, new_value, next);
+			}
+			applied = set_genome_nail(genome, changed_index, new_value);
 			break;
 		}
 
 		case ADD_INDEX:
 		{
-			// Add a new index at a random spot
-			if (index_count < LINES_INDEX_COUNT)
+			// Add a new nail at the given spot
+			if (nail_count < LINES_INDEX_COUNT)
 			{
-				// Shift all to the right
-				const GLuint new_index = (GLuint)(rand() % POINT_COUNT);
-				const size_t insert_before = (size_t)(rand() % (index_count + 1));
-				GLuint copy_value = new_index;
-				for (size_t i = insert_before; i < index_count + 1; ++i)
+				const nail_t new_index = (nail_t)edit->value;
+				const size_t insert_before = (size_t)edit->position;
+				assert(insert_before <= nail_count);
+				assert(new_index < POINT_COUNT);
+
+				// Split the chord at the insertion point, or extend an end
+				if ((insert_before > 0) && (insert_before < nail_count))
+				{
+					add_chord(record->removed, &record->removed_count, get_genome_nail(genome, insert_before - 1), get_genome_nail(genome, insert_before));
+				}
+				if (insert_before > 0)
 				{
-					GLuint saved = indices[i];
-					indices[i] = copy_value;
-					assert(indices[i] < POINT_COUNT);
-					copy_value = saved;
+					add_chord(record->added, &record->added_count, get_genome_nail(genome, insert_before - 1), new_index);
 				}
-				destination->index_count = index_count + 1;
+				if (insert_before < nail_count)
+				{
+					add_chord(record->added, &record->added_count, new_index, get_genome_nail(genome, insert_before));
+				}
+				applied = insert_genome_nail(genome, insert_before, new_index);
 			}
 			break;
 		}
 
 		case REMOVE_INDEX:
 		{
-			// Remove an index at random
-			if (index_count > 2)
+			// Remove a nail
+			if (nail_count > 2)
 			{
-				// Shift all to the left after
-				const size_t removed_index = (size_t)(rand() % index_count);
-				for (size_t i = removed_index + 1; i < index_count; ++i)
+				const size_t removed_index = (size_t)edit->position;
+				assert(removed_index < nail_count);
+				const nail_t removed = get_genome_nail(genome, removed_index);
+
+				// Join the neighbours of the removed nail, or drop an end
+				if (removed_index > 0)
 				{
-					indices[i - 1] = indices[i];
-					assert(indices[i - 1] < POINT_COUNT);
+					add_chord(record->removed, &record->removed_count, get_genome_nail(genome, removed_index - 1), removed);
 				}
-
-				destination->index_count = index_count - 1;
+				if (removed_index + 1 < nail_count)
+				{
+					add_chord(record->removed, &record->removed_count, removed, get_genome_nail(genome, removed_index + 1));
+				}
+				if ((removed_index > 0) && (removed_index + 1 < nail_count))
+				{
+					add_chord(record->added, &record->added_count, get_genome_nail(genome, removed_index - 1), get_genome_nail(genome, removed_index + 1));
+				}
+				applied = remove_genome_nail(genome, removed_index);
 			}
 			break;
 		}
+
+		default:
+			break;
+	}
+
+	if (!applied)
+	{
+		*record = null_mutation();
+	}
+	else if (edit->kind != MUTATION_EDIT_NONE)
+	{
+		destination->nails_current = false;
 	}
 }
 
-void copy_generation(const generation_t* source, generation_t* destination)
+void mutate_generation(const generation_t* source, generation_t* destination, random_state_t* random)
 {
-	const size_t buffer_size = source->index_count * sizeof(GLuint);
-	memcpy(destination->indices, source->indices, buffer_size);
-	destination->index_count = source->index_count;
-	destination->score = source->score;
+	// Copy over first
+	copy_generation(source, destination);
+	const size_t index_count = get_genome_length(&destination->genome);
+
+	// Draws happen in the same order whether or not the edit fits
+	mutation_edit_t edit = null_mutation_edit();
+	edit.kind = random_below(random, MUTATION_MAX);
+	switch (edit.kind)
+	{
+		case CHANGE_INDEX:
+			edit.position = random_below(random, (uint32_t)index_count);
+			edit.value = (GLuint)random_below(random, POINT_COUNT);
+			break;
+
+		case ADD_INDEX:
+			if (index_count < LINES_INDEX_COUNT)
+			{
+				edit.value = (GLuint)random_below(random, POINT_COUNT);
+				edit.position = random_below(random, (uint32_t)(index_count + 1));
+			}
+			break;
+
+		case REMOVE_INDEX:
+			if (index_count > 2)
+			{
+				edit.position = random_below(random, (uint32_t)index_count);
+			}
+			break;
+	}
+	apply_edit(destination, &edit);
 }
 
-int compare_generations(const void* a, const void* b)
+bool replay_mutation(const generation_t* source, generation_t* destination, const mutation_edit_t* edit)
 {
-	const generation_t* generation_a = (const generation_t*)a;
-	const generation_t* generation_b = (const generation_t*)b;
-	const GLfloat score_a = generation_a->score;
-	const GLfloat score_b = generation_b->score;
-	if (score_a < score_b)
+	const size_t index_count = get_genome_length(&source->genome);
+	bool valid;
+	switch (edit->kind)
 	{
-		return -1;
+		case CHANGE_INDEX:
+			valid = (edit->position < index_count) && (edit->value < (GLuint)POINT_COUNT);
+			break;
+
+		case ADD_INDEX:
+			valid = (index_count >= LINES_INDEX_COUNT) || ((edit->position <= index_count) && (edit->value < (GLuint)POINT_COUNT));
+			break;
+
+		case REMOVE_INDEX:
+			valid = (index_count <= 2) || (edit->position < index_count);
+			break;
+
+		default:
+			valid = (edit->kind == MUTATION_EDIT_NONE);
+			break;
 	}
-	else if (score_a == score_b)
+	if (!valid)
 	{
-		return 0;
+		return false;
 	}
-	else
+
+	copy_generation(source, destination);
+	apply_edit(destination, edit);
+	return true;
+}
+
+static void breed_task(void* job_pointer)
+{
+	breed_job_t* job = (breed_job_t*)job_pointer;
+	mutate_generation(job->parent, job->offspring, &job->random);
+}
+
+void breed_offspring(generation_t* candidates, random_state_t* random, thread_pool_t* pool)
+{
+	for (size_t i = 0; i < (size_t)FITTEST_COUNT; ++i)
+	{
+		candidates[i].parent_slot = i;
+		candidates[i].mutation.edit = null_mutation_edit();
+	}
+
+	// One draw keys every offspring's stream for this generation
+	const uint64_t key = next_random64(random);
+	const size_t offspring_count = CANDIDATE_COUNT - FITTEST_COUNT;
+	breed_job_t* jobs = NULL;
+	if ((pool != NULL) && (offspring_count >= PARALLEL_BREED_MINIMUM))
 	{
-		return 1;
+		jobs = (breed_job_t*)malloc(offspring_count * sizeof(breed_job_t));
+	}
+
+	// Offspring are laid out parent by parent after the survivors
+	for (size_t i = 0; i < offspring_count; ++i)
+	{
+		const size_t parent = i / OFFSPRING_PER_FITTEST;
+		generation_t* offspring = &candidates[FITTEST_COUNT + i];
+		offspring->parent_slot = parent;
+		random_state_t stream = derive_random(key, i);
+		if (jobs != NULL)
+		{
+			breed_job_t* job = &jobs[i];
+			job->parent = &candidates[parent];
+			job->offspring = offspring;
+			job->random = stream;
+		}
+		else
+		{
+			mutate_generation(&candidates[parent], offspring, &stream);
+		}
+	}
+	if (jobs != NULL)
+	{
+		run_tasks(pool, &breed_task, jobs, sizeof(breed_job_t), offspring_count);
+		free(jobs);
 	}
 }
 
-void start_score_thread(generation_t* generation)
+void copy_generation(const generation_t* source, generation_t* destination)
 {
-#if defined(WIN32)
-	HANDLE thread_handle = CreateThread(NULL, 0, &compute_score, generation, 0, NULL);
-	assert(thread_handle != NULL);
-	generation->score_thread = thread_handle;
-#else
-	pthread_t* thread = &generation->score_thread;
-	const int result = pthread_create(thread, NULL, &compute_score, candidate);
-#endif
+	// Shares the source's nodes; edits copy what they change
+	if (destination->genome.root != source->genome.root)
+	{
+		share_genome(&source->genome, &destination->genome);
+		destination->nails_current = false;
+	}
+	destination->score = source->score;
 }
 
-void join_score_thread(generation_t* generation)
+// Orders by score, then by slot so equal scores keep their order
+static int compare_ranks(const void* a, const void* b)
 {
-#if defined(WIN32)
-	HANDLE thread_handle = generation->score_thread;
-	WaitForSingleObject(thread_handle, INFINITE);
-#else
-	const int result = pthread_join(other->score_thread, NULL);
-	assert(result);
-#endif
+	const generation_rank_t* rank_a = (const generation_rank_t*)a;
+	const generation_rank_t* rank_b = (const generation_rank_t*)b;
+	if (rank_a->score != rank_b->score)
+	{
+		return (rank_a->score < rank_b->score ? -1 : 1);
+	}
+	if (rank_a->slot != rank_b->slot)
+	{
+		return (rank_a->slot < rank_b->slot ? -1 : 1);
+	}
+	return 0;
 }
 
-#if defined(WIN32)
-DWORD WINAPI compute_score(LPVOID generation_pointer)
-#else
-void* compute_score(void* generation_pointer)
-#endif
+void sort_generations(generation_t* candidates, generation_rank_t* ranks, size_t count)
 {
-	generation_t* generation = (generation_t*)generation_pointer;
-	GLfloat* score_buffer = generation->score_buffer;
-	GLfloat sum = 0.f;
-	for (size_t i = 0; i < APPLICATION_PIXEL_COUNT; ++i)
+	for (size_t i = 0; i < count; ++i)
 	{
-		sum += score_buffer[i];
+		ranks[i].score = candidates[i].score;
+		ranks[i].slot = i;
 	}
-	generation->score = sum;
+	qsort(ranks, count, sizeof(generation_rank_t), &compare_ranks);
 
-#if defined(WIN32)
-	return 0;
-#else
-	return NULL;
-#endif
+	// Follow each cycle of the permutation, so every candidate moves once
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (ranks[i].slot == i)
+		{
+			continue;
+		}
+		const generation_t held = candidates[i];
+		size_t j = i;
+		while (ranks[j].slot != i)
+		{
+			const size_t k = ranks[j].slot;
+			candidates[j] = candidates[k];
+			ranks[j].slot = j;
+			j = k;
+		}
+		candidates[j] = held;
+		ranks[j].slot = j;
+	}
+}
+
+void set_score_cutoffs(generation_t* candidates, size_t count, bool bounded)
+{
+	double cutoff = (bounded ? 0.0 : DBL_MAX);
+	for (size_t i = 0; bounded && (i < (size_t)FITTEST_COUNT) && (i < count); ++i)
+	{
+		cutoff = (candidates[i].score > cutoff ? candidates[i].score : cutoff);
+	}
+	for (size_t i = 0; i < count; ++i)
+	{
+		candidates[i].score_cutoff = (i < (size_t)FITTEST_COUNT ? DBL_MAX : cutoff);
+	}
+}
+
+void compute_score(void* generation_pointer)
+{
+	generation_t* generation = (generation_t*)generation_pointer;
+	generation->score = sum_floats_bounded(generation->score_pixels, generation->score_pixel_count, generation->score_cutoff);
 }
 
@@ -1,44 +1,133 @@
 #ifndef GENERATION_H
 #define GENERATION_H
 
+#include "genome.h"
+#include "random.h"
 #include "shared.h"
-#if defined(WIN32)
-#include <Windows.h>
-#else
-#include <pthread.h>
-#endif
+#include "thread_pool.h"
 #include <GL/glew.h>
 #include <GL/gl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Most chords a single mutation can remove or add
+#define MUTATION_MAXIMUM_CHORDS 2
+
+// Offspring per generation before breeding is spread over the pool. Copying
+// and mutating one is under a microsecond at 1000 lines, so populations
+// below this, the default among them, breed on the calling thread.
+#define PARALLEL_BREED_MINIMUM 64
+
+// Element type nails are drawn from in index buffers
+#define NAIL_INDEX_TYPE GL_UNSIGNED_SHORT
+
+// Edit kind of a candidate carried over unchanged
+#define MUTATION_EDIT_NONE UINT32_MAX
+
+// Line between two points
+typedef struct chord
+{
+	GLuint start;
+	GLuint end;
+} chord_t;
+
+// Index edit a mutation drew, enough to replay it on the parent
+typedef struct mutation_edit
+{
+	uint32_t kind;
+	uint32_t position;
+	GLuint value;
+} mutation_edit_t;
+
+// Chords a mutation took out of and put into the line strip
+typedef struct mutation
+{
+	mutation_edit_t edit;
+	chord_t removed[MUTATION_MAXIMUM_CHORDS];
+	size_t removed_count;
+	chord_t added[MUTATION_MAXIMUM_CHORDS];
+	size_t added_count;
+} mutation_t;
 
 // Structure representing a specific generation of lines
 typedef struct generation
 {
-	GLuint* indices;
-	size_t index_count;
-	GLfloat* score_buffer;
-	GLfloat score;
-#if defined(WIN32)
-	HANDLE score_thread;
-#else
-	pthread_t score_thread;
-#endif
+	genome_t genome;
+	double score;
+
+	// Flat copy of the genome for drawing, refreshed when it's stale
+	nail_t* nails;
+	size_t nail_capacity;
+	bool nails_current;
+
+	// Difference image to sum, mapped from its readback buffer, and its
+	// size, which is smaller when scored at a coarse resolution
+	const GLfloat* score_pixels;
+	size_t score_pixel_count;
+
+	// Score past which summing stops, as the candidate can't survive
+	double score_cutoff;
+
+	// Change from the parent this generation was mutated from
+	mutation_t mutation;
+
+	// Slot the parent held in the previous generation; survivors carried
+	// over keep their own slot and have no edit
+	size_t parent_slot;
+
+	// Incremental software rendering state, if kept for this generation, and
+	// the state of the parent the mutation applies to
+	struct software_state* state;
+	const struct software_state* parent_state;
 } generation_t;
 
-generation_t create_generation(void);
+// Score of a candidate and the slot it held before sorting
+typedef struct generation_rank
+{
+	double score;
+	size_t slot;
+} generation_rank_t;
+
+mutation_t null_mutation(void);
+mutation_edit_t null_mutation_edit(void);
+// Starts from a single random chord, or from the first nail without a
+// generator, for candidates that are about to be overwritten
+generation_t create_generation(random_state_t* random);
 void destroy_generation(generation_t* generation);
-void mutate_generation(const generation_t* source, generation_t* destination);
+void mutate_generation(const generation_t* source, generation_t* destination, random_state_t* random);
 void copy_generation(const generation_t* source, generation_t* destination);
 
-int compare_generations(const void* a, const void* b);
+size_t get_generation_length(const generation_t* generation);
+
+// Nails of the genome in order, exported if they changed since the last
+// call; NULL if the copy can't be allocated
+const nail_t* get_generation_nails(generation_t* generation);
+
+// Replaces the genome with the nails given
+bool set_generation_nails(generation_t* generation, const nail_t* nails, size_t count);
+
+// Keeps the fittest of sorted candidates and refills the rest with their
+// offspring, noting which survivor each came from. Each offspring draws from
+// its own stream, so offspring are the same with or without a pool; the
+// pool is only used past PARALLEL_BREED_MINIMUM offspring.
+void breed_offspring(generation_t* candidates, random_state_t* random, thread_pool_t* pool);
+
+// Applies an edit recorded by mutate_generation to a copy of the source.
+// Fails without touching the destination if the edit can't apply to it.
+bool replay_mutation(const generation_t* source, generation_t* destination, const mutation_edit_t* edit);
+
+// Sorts candidates by score, equal scores keeping their order. The compact
+// ranks are sorted rather than the candidates, which then move once each.
+void sort_generations(generation_t* candidates, generation_rank_t* ranks, size_t count);
 
-// Thread function for computing score
-void start_score_thread(generation_t* generation);
-void join_score_thread(generation_t* generation);
+// Lets offspring stop being scored once they're worse than every survivor
+// of the last sort. Survivors are always scored in full, so the cutoff only
+// ever comes from complete scores. Unbounded, every score is complete.
+void set_score_cutoffs(generation_t* candidates, size_t count, bool bounded);
 
-#if defined(WIN32)
-DWORD WINAPI compute_score(LPVOID generation_pointer);
-#else
-void* compute_score(void* generation_pointer);
-#endif
+// Task function summing the score pixels into the score, stopping early past
+// the cutoff with a partial score that still ranks after the cutoff
+void compute_score(void* generation_pointer);
 
 #endif // GENERATION_H
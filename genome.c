@@ -0,0 +1,508 @@
+#include "genome.h"
+#include "thread.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Nodes built in bulk are filled this far, leaving room to insert
+#define GENOME_LEAF_FILL ((GENOME_LEAF_CAPACITY * 3) / 4)
+#define GENOME_BRANCH_FILL ((GENOME_BRANCH_CAPACITY * 3) / 4)
+
+// Nodes left with fewer entries than this merge with a neighbour if they fit
+#define GENOME_LEAF_MINIMUM (GENOME_LEAF_CAPACITY / 4)
+#define GENOME_BRANCH_MINIMUM (GENOME_BRANCH_CAPACITY / 4)
+
+// Leaves hold nails and branches hold children; every node knows how many
+// nails are under it, so positions are found by walking the counts
+typedef struct genome_node
+{
+	volatile long references;
+	uint32_t count;
+	uint16_t height;
+	uint16_t size;
+	union
+	{
+		nail_t nails[GENOME_LEAF_CAPACITY];
+		struct genome_node* children[GENOME_BRANCH_CAPACITY];
+	} contents;
+} genome_node_t;
+
+static genome_node_t* allocate_node(uint16_t height)
+{
+	genome_node_t* node = (genome_node_t*)malloc(sizeof(genome_node_t));
+	if (node == NULL)
+	{
+		printf("Failed to allocate genome node.\n");
+		return NULL;
+	}
+	node->references = 1;
+	node->count = 0;
+	node->height = height;
+	node->size = 0;
+	return node;
+}
+
+static size_t get_node_capacity(const genome_node_t* node)
+{
+	return (node->height == 0 ? GENOME_LEAF_CAPACITY : GENOME_BRANCH_CAPACITY);
+}
+
+static size_t get_node_minimum(const genome_node_t* node)
+{
+	return (node->height == 0 ? GENOME_LEAF_MINIMUM : GENOME_BRANCH_MINIMUM);
+}
+
+static void release_node(genome_node_t* node)
+{
+	if ((node == NULL) || (add_atomic(&node->references, -1) != 0))
+	{
+		return;
+	}
+	if (node->height > 0)
+	{
+		for (size_t i = 0; i < node->size; ++i)
+		{
+			release_node(node->contents.children[i]);
+		}
+	}
+	free(node);
+}
+
+// Node in the slot, copied first unless the slot is its only reference. The
+// slot's owner must be unique itself, so nothing else can reach the node.
+static genome_node_t* make_unique(genome_node_t** slot)
+{
+	genome_node_t* node = *slot;
+	if (load_atomic(&node->references) == 1)
+	{
+		return node;
+	}
+
+	genome_node_t* copy = allocate_node(node->height);
+	if (copy == NULL)
+	{
+		return NULL;
+	}
+	copy->count = node->count;
+	copy->size = node->size;
+	copy->contents = node->contents;
+	if (copy->height > 0)
+	{
+		for (size_t i = 0; i < copy->size; ++i)
+		{
+			add_atomic(&copy->contents.children[i]->references, 1);
+		}
+	}
+	release_node(node);
+	*slot = copy;
+	return copy;
+}
+
+// Child holding the position, which is made relative to that child. A
+// position between two children goes to the start of the later one.
+static size_t find_child(const genome_node_t* node, size_t* position)
+{
+	size_t index = 0;
+	for (; index + 1 < node->size; ++index)
+	{
+		const size_t count = node->contents.children[index]->count;
+		if (*position < count)
+		{
+			break;
+		}
+		*position -= count;
+	}
+	return index;
+}
+
+static void insert_child(genome_node_t* parent, size_t index, genome_node_t* child)
+{
+	genome_node_t** children = parent->contents.children;
+	memmove(&children[index + 1], &children[index], (parent->size - index) * sizeof(genome_node_t*));
+	children[index] = child;
+	++parent->size;
+}
+
+static void remove_child(genome_node_t* parent, size_t index)
+{
+	genome_node_t** children = parent->contents.children;
+	memmove(&children[index], &children[index + 1], (parent->size - index - 1) * sizeof(genome_node_t*));
+	--parent->size;
+}
+
+// Moves the upper half of a unique node into a new node after it
+static genome_node_t* split_node(genome_node_t* node)
+{
+	genome_node_t* right = allocate_node(node->height);
+	if (right == NULL)
+	{
+		return NULL;
+	}
+
+	const size_t half = node->size / 2;
+	right->size = (uint16_t)(node->size - half);
+	if (node->height == 0)
+	{
+		memcpy(right->contents.nails, &node->contents.nails[half], right->size * sizeof(nail_t));
+		right->count = right->size;
+	}
+	else
+	{
+		memcpy(right->contents.children, &node->contents.children[half], right->size * sizeof(genome_node_t*));
+		for (size_t i = 0; i < right->size; ++i)
+		{
+			right->count += right->contents.children[i]->count;
+		}
+	}
+	node->size = (uint16_t)half;
+	node->count -= right->count;
+	return right;
+}
+
+// Drops an emptied child of a unique parent, or merges a small one with a
+// neighbour when both fit in one node. Merging is skipped if a shared
+// neighbour can't be copied; the genome is still valid, just less compact.
+static void rebalance_child(genome_node_t* parent, size_t index)
+{
+	genome_node_t* child = parent->contents.children[index];
+	if (child->size == 0)
+	{
+		remove_child(parent, index);
+		release_node(child);
+		return;
+	}
+	if ((child->size >= get_node_minimum(child)) || (parent->size < 2))
+	{
+		return;
+	}
+
+	const size_t left_index = ((index + 1 < parent->size) ? index : index - 1);
+	genome_node_t** children = parent->contents.children;
+	if ((size_t)children[left_index]->size + children[left_index + 1]->size > get_node_capacity(child))
+	{
+		return;
+	}
+	genome_node_t* left = make_unique(&children[left_index]);
+	genome_node_t* right = ((left != NULL) ? make_unique(&children[left_index + 1]) : NULL);
+	if (right == NULL)
+	{
+		return;
+	}
+
+	// The right node's references move to the left, so it is freed empty
+	if (left->height == 0)
+	{
+		memcpy(&left->contents.nails[left->size], right->contents.nails, right->size * sizeof(nail_t));
+	}
+	else
+	{
+		memcpy(&left->contents.children[left->size], right->contents.children, right->size * sizeof(genome_node_t*));
+	}
+	left->size = (uint16_t)(left->size + right->size);
+	left->count += right->count;
+	right->size = 0;
+	remove_child(parent, left_index + 1);
+	release_node(right);
+}
+
+genome_t null_genome(void)
+{
+	genome_t result;
+	result.root = NULL;
+	return result;
+}
+
+bool create_genome(const nail_t* nails, size_t count, genome_t* out)
+{
+	*out = null_genome();
+	if (count == 0)
+	{
+		return true;
+	}
+
+	// Leaves first, spread evenly, then each level of branches over them
+	size_t node_count = (count + GENOME_LEAF_FILL - 1) / GENOME_LEAF_FILL;
+	genome_node_t** level = (genome_node_t**)malloc(node_count * sizeof(genome_node_t*));
+	if (level == NULL)
+	{
+		printf("Failed to allocate genome.\n");
+		return false;
+	}
+	size_t copied = 0;
+	for (size_t i = 0; i < node_count; ++i)
+	{
+		const size_t size = (count / node_count) + (i < (count % node_count) ? 1 : 0);
+		genome_node_t* leaf = allocate_node(0);
+		if (leaf == NULL)
+		{
+			for (size_t j = 0; j < i; ++j)
+			{
+				release_node(level[j]);
+			}
+			free(level);
+			return false;
+		}
+		memcpy(leaf->contents.nails, &nails[copied], size * sizeof(nail_t));
+		leaf->size = (uint16_t)size;
+		leaf->count = (uint32_t)size;
+		copied += size;
+		level[i] = leaf;
+	}
+
+	uint16_t height = 0;
+	while (node_count > 1)
+	{
+		// Parents are written over the front of the level as it is read
+		const size_t parent_count = (node_count + GENOME_BRANCH_FILL - 1) / GENOME_BRANCH_FILL;
+		size_t child = 0;
+		++height;
+		for (size_t i = 0; i < parent_count; ++i)
+		{
+			const size_t size = (node_count / parent_count) + (i < (node_count % parent_count) ? 1 : 0);
+			genome_node_t* branch = allocate_node(height);
+			if (branch == NULL)
+			{
+				for (size_t j = 0; j < i; ++j)
+				{
+					release_node(level[j]);
+				}
+				for (size_t j = child; j < node_count; ++j)
+				{
+					release_node(level[j]);
+				}
+				free(level);
+				return false;
+			}
+			for (size_t j = 0; j < size; ++j, ++child)
+			{
+				branch->contents.children[j] = level[child];
+				branch->count += level[child]->count;
+			}
+			branch->size = (uint16_t)size;
+			level[i] = branch;
+		}
+		node_count = parent_count;
+	}
+
+	out->root = level[0];
+	free(level);
+	return true;
+}
+
+void destroy_genome(genome_t* genome)
+{
+	release_node(genome->root);
+	genome->root = NULL;
+}
+
+void share_genome(const genome_t* source, genome_t* destination)
+{
+	if (source->root == destination->root)
+	{
+		return;
+	}
+	if (source->root != NULL)
+	{
+		add_atomic(&source->root->references, 1);
+	}
+	release_node(destination->root);
+	destination->root = source->root;
+}
+
+size_t get_genome_length(const genome_t* genome)
+{
+	return (genome->root != NULL ? genome->root->count : 0);
+}
+
+nail_t get_genome_nail(const genome_t* genome, size_t position)
+{
+	assert(position < get_genome_length(genome));
+	const genome_node_t* node = genome->root;
+	while (node->height > 0)
+	{
+		node = node->contents.children[find_child(node, &position)];
+	}
+	return node->contents.nails[position];
+}
+
+bool set_genome_nail(genome_t* genome, size_t position, nail_t nail)
+{
+	assert(position < get_genome_length(genome));
+	genome_node_t* node = make_unique(&genome->root);
+	while ((node != NULL) && (node->height > 0))
+	{
+		const size_t index = find_child(node, &position);
+		node = make_unique(&node->contents.children[index]);
+	}
+	if (node == NULL)
+	{
+		return false;
+	}
+	node->contents.nails[position] = nail;
+	return true;
+}
+
+bool insert_genome_nail(genome_t* genome, size_t position, nail_t nail)
+{
+	assert(position <= get_genome_length(genome));
+	if (genome->root == NULL)
+	{
+		genome->root = allocate_node(0);
+		if (genome->root == NULL)
+		{
+			return false;
+		}
+	}
+	genome_node_t* node = make_unique(&genome->root);
+	if (node == NULL)
+	{
+		return false;
+	}
+
+	// A full root gets a level above it first, so every node split on the
+	// way down has room in its parent
+	if (node->size == get_node_capacity(node))
+	{
+		if (node->height + 1 >= GENOME_MAXIMUM_HEIGHT)
+		{
+			return false;
+		}
+		genome_node_t* root = allocate_node((uint16_t)(node->height + 1));
+		genome_node_t* right = ((root != NULL) ? split_node(node) : NULL);
+		if (right == NULL)
+		{
+			free(root);
+			return false;
+		}
+		root->contents.children[0] = node;
+		root->contents.children[1] = right;
+		root->size = 2;
+		root->count = node->count + right->count;
+		genome->root = root;
+		node = root;
+	}
+
+	// Counts are only raised once nothing else can fail
+	genome_node_t* path[GENOME_MAXIMUM_HEIGHT];
+	size_t depth = 0;
+	while (node->height > 0)
+	{
+		const size_t index = find_child(node, &position);
+		genome_node_t* child = make_unique(&node->contents.children[index]);
+		if (child == NULL)
+		{
+			return false;
+		}
+		if (child->size == get_node_capacity(child))
+		{
+			genome_node_t* right = split_node(child);
+			if (right == NULL)
+			{
+				return false;
+			}
+			insert_child(node, index + 1, right);
+			if (position > child->count)
+			{
+				position -= child->count;
+				child = right;
+			}
+		}
+		path[depth++] = node;
+		node = child;
+	}
+
+	nail_t* nails = node->contents.nails;
+	memmove(&nails[position + 1], &nails[position], (node->size - position) * sizeof(nail_t));
+	nails[position] = nail;
+	++node->size;
+	++node->count;
+	for (size_t i = 0; i < depth; ++i)
+	{
+		++path[i]->count;
+	}
+	return true;
+}
+
+bool remove_genome_nail(genome_t* genome, size_t position)
+{
+	assert(position < get_genome_length(genome));
+	genome_node_t* node = make_unique(&genome->root);
+	if (node == NULL)
+	{
+		return false;
+	}
+
+	genome_node_t* path[GENOME_MAXIMUM_HEIGHT];
+	size_t indices[GENOME_MAXIMUM_HEIGHT];
+	size_t depth = 0;
+	while (node->height > 0)
+	{
+		const size_t index = find_child(node, &position);
+		genome_node_t* child = make_unique(&node->contents.children[index]);
+		if (child == NULL)
+		{
+			return false;
+		}
+		path[depth] = node;
+		indices[depth] = index;
+		++depth;
+		node = child;
+	}
+
+	nail_t* nails = node->contents.nails;
+	memmove(&nails[position], &nails[position + 1], (node->size - position - 1) * sizeof(nail_t));
+	--node->size;
+	--node->count;
+	for (size_t i = 0; i < depth; ++i)
+	{
+		--path[i]->count;
+	}
+	for (size_t level = depth; level-- > 0;)
+	{
+		rebalance_child(path[level], indices[level]);
+	}
+
+	// Levels left with a single child are dropped; the root is unique here
+	genome_node_t* root = genome->root;
+	while ((root->height > 0) && (root->size <= 1))
+	{
+		genome_node_t* child = ((root->size == 1) ? root->contents.children[0] : NULL);
+		root->size = 0;
+		release_node(root);
+		root = child;
+		if (root == NULL)
+		{
+			break;
+		}
+	}
+	if ((root != NULL) && (root->count == 0))
+	{
+		release_node(root);
+		root = NULL;
+	}
+	genome->root = root;
+	return true;
+}
+
+static nail_t* export_node(const genome_node_t* node, nail_t* out)
+{
+	if (node->height == 0)
+	{
+		memcpy(out, node->contents.nails, node->size * sizeof(nail_t));
+		return out + node->size;
+	}
+	for (size_t i = 0; i < node->size; ++i)
+	{
+		out = export_node(node->contents.children[i], out);
+	}
+	return out;
+}
+
+void export_genome(const genome_t* genome, nail_t* out)
+{
+	if (genome->root != NULL)
+	{
+		export_node(genome->root, out);
+	}
+}
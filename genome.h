@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Nail id; 16 bits cover every nail count validate_config accepts
+typedef uint16_t nail_t;
+#define MAXIMUM_NAIL_COUNT (UINT16_MAX + 1)
+
+// Nails per leaf and children per branch, sized so a node fills two cache
+// lines
+#define GENOME_LEAF_CAPACITY 56
+#define GENOME_BRANCH_CAPACITY 14
+
+// Deepest a genome can grow; far more than any number of nails that fits
+// in memory needs
+#define GENOME_MAXIMUM_HEIGHT 32
+
+struct genome_node;
+
+// Sequence of nails the thread visits, kept as a B-tree of counted nodes.
+// Copies share nodes, and edits copy only the nodes on the path they change,
+// so copying is O(1) and editing O(log n) however long the genome grows.
+// Shared nodes are reference counted atomically, so genomes sharing them
+// can be edited and destroyed on different threads.
+typedef struct genome
+{
+	struct genome_node* root;
+} genome_t;
+
+genome_t null_genome(void);
+
+// Builds a genome holding a copy of the nails
+bool create_genome(const nail_t* nails, size_t count, genome_t* out);
+void destroy_genome(genome_t* genome);
+
+// Makes the destination share the source's nodes, dropping what it held
+void share_genome(const genome_t* source, genome_t* destination);
+
+size_t get_genome_length(const genome_t* genome);
+nail_t get_genome_nail(const genome_t* genome, size_t position);
+
+// Edits fail, leaving the genome as it was, only if a node can't be allocated
+bool set_genome_nail(genome_t* genome, size_t position, nail_t nail);
+bool insert_genome_nail(genome_t* genome, size_t position, nail_t nail);
+bool remove_genome_nail(genome_t* genome, size_t position);
+
+// Writes every nail in order; out must hold get_genome_length of them
+void export_genome(const genome_t* genome, nail_t* out);
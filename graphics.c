@@ -1,6 +1,13 @@
+#include <assert.h>
 #include <stdio.h>
-#include <SDL_image.h>
+#include <stdlib.h>
+#include <string.h>
+#if !defined(WIN32)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 #include "graphics.h"
+#include "reduce.h"
 #include "shared.h"
 
 #define APPLICATION_TITLE "ThreadCircle"
@@ -9,84 +16,254 @@
 #define LINE_FRAGMENT_SHADER "line.fragment"
 #define TEXTURE_VERTEX_SHADER "texture.vertex"
 #define TEXTURE_FRAGMENT_SHADER "texture.fragment"
-#define TEXTURE_IMAGE_FILENAME "texture.png"
-
-// Don't add alpha
-#define MAXIMUM_SUM_BYTES 3
+#define REDUCE_VERTEX_SHADER "reduce.vertex"
+#define REDUCE_FRAGMENT_SHADER "reduce.fragment"
+#define BLUR_VERTEX_SHADER "reduce.vertex"
+#define BLUR_FRAGMENT_SHADER "blur.fragment"
 
 graphics_context_t null_graphics_context()
 {
 	graphics_context_t result;
 	result.window = NULL;
 	result.gl_context = NULL;
+	result.headless = false;
+	result.egl_display = NULL;
+	result.egl_surface = NULL;
+	result.egl_context = NULL;
 	result.line_material = null_material();
 	result.texture_material = null_material();
+	result.reduce_material = null_material();
+	result.blur_material = null_material();
 	result.frame_buffer = 0;
 	result.texture_target = 0;
-	result.texture_image_buffer = NULL;
 	result.texture_image = 0;
+	result.texture_pyramid = 0;
+	result.blur_frame_buffer = INVALID_BUFFER;
+	result.blur_texture = INVALID_TEXTURE;
+	result.blur_width = 0;
+	result.blur_height = 0;
+	for (size_t i = 0; i < READBACK_BUFFER_COUNT; ++i)
+	{
+		result.readbacks[i].buffer = INVALID_BUFFER;
+		result.readbacks[i].fence = NULL;
+		result.readbacks[i].pixels = NULL;
+	}
+	result.snapshot_buffer = INVALID_BUFFER;
+	result.snapshot_fence = NULL;
+	result.snapshot_pixels = NULL;
+	result.score_frame_buffer = INVALID_BUFFER;
+	result.score_texture = INVALID_TEXTURE;
+	for (size_t i = 0; i < MAXIMUM_REDUCE_LEVELS; ++i)
+	{
+		result.reduce_frame_buffers[i] = INVALID_BUFFER;
+		result.reduce_textures[i] = INVALID_TEXTURE;
+		result.reduce_widths[i] = 0;
+		result.reduce_heights[i] = 0;
+	}
+	result.reduce_level_count = 0;
+	result.scores_frame_buffer = INVALID_BUFFER;
+	result.scores_texture = INVALID_TEXTURE;
+	result.score_slot_count = 0;
+	result.score_columns = 0;
+	result.score_block_width = 0;
+	result.score_block_height = 0;
+	result.score_texels = NULL;
 	return result;
 }
 
-bool load_texture_image(graphics_context_t* context)
+bool create_target_texture(const target_t* target, GLuint* out)
 {
-	SDL_Surface* surface = IMG_Load(TEXTURE_IMAGE_FILENAME);
-	if (surface == NULL)
+	const image_t* image = &target->levels[0];
+	// Create texture from buffer
+	GLuint texture_image;
+	glGenTextures(1, &texture_image);
+	glBindTexture(GL_TEXTURE_2D, texture_image);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image->width, image->height, 0, GL_RED, GL_FLOAT, image->pixels);
+	set_texture_filtering(GL_TEXTURE_2D, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	*out = texture_image;
+	return (glGetError() == GL_NO_ERROR);
+}
+
+bool load_texture_image(graphics_context_t* context, const target_t* target)
+{
+	GLuint texture_image;
+	if (!create_target_texture(target, &texture_image))
 	{
-		printf("Failed to load texture image from file.\n");
 		return false;
 	}
+	context->texture_image = texture_image;
 
-	const GLsizei width = surface->w;
-	const GLsizei height = surface->h;
-	const size_t texture_pixel_count = (size_t)(width * height);
-	const size_t texture_buffer_size = texture_pixel_count * sizeof(float);
-	float* texture_image_buffer = (float*)malloc(texture_buffer_size);
-	float* current_texture_pixel = texture_image_buffer;
-
-	// Average the bytes for the image
-	const float maximum_value = 255.f;
-	const SDL_PixelFormat* format = surface->format;
-	const size_t bytes_per_pixel = (size_t)format->BytesPerPixel;
-	const size_t sum_bytes = (bytes_per_pixel < MAXIMUM_SUM_BYTES ? bytes_per_pixel : MAXIMUM_SUM_BYTES);
-	const float average_denominator = (float)sum_bytes;
-	const uint8_t* pixels = (const uint8_t*)surface->pixels;
-	const uint8_t* current = pixels;
-	printf("Image contains %d bytes per pixel...\n", (int)bytes_per_pixel);
-	for (size_t i = 0; i < texture_pixel_count; ++i)
-	{
-		float sum = 0.f;
-
-		// Only add RGB, skip bytes after
-		for (size_t j = 0; j < sum_bytes; ++j, ++current)
-		{
-			sum += ((float)*current) / maximum_value;
-		}
-		for (size_t j = sum_bytes; j < bytes_per_pixel; ++j, ++current);
+	// Same image with every level below it, for scoring at lower resolutions
+	GLuint texture_pyramid;
+	glGenTextures(1, &texture_pyramid);
+	glBindTexture(GL_TEXTURE_2D, texture_pyramid);
+	for (int i = 0; i < target->level_count; ++i)
+	{
+		const image_t* level = &target->levels[i];
+		glTexImage2D(GL_TEXTURE_2D, i, GL_RGB, level->width, level->height, 0, GL_RED, GL_FLOAT, level->pixels);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, target->level_count - 1);
+	set_texture_filtering(GL_TEXTURE_2D, GL_LINEAR_MIPMAP_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	context->texture_pyramid = texture_pyramid;
+	return (glGetError() == GL_NO_ERROR);
+}
 
-		*current_texture_pixel++ = sum / average_denominator;
+// Single channel float texture with a frame buffer drawing into it
+static bool create_float_target(GLsizei width, GLsizei height, GLuint* texture_out, GLuint* frame_buffer_out)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	*texture_out = texture;
+
+	GLuint frame_buffer;
+	glGenFramebuffers(1, &frame_buffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	*frame_buffer_out = frame_buffer;
+	const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		printf("Float render target incomplete (0x%x).\n", status);
+		return false;
+	}
+	return true;
+}
+
+// Offscreen context on a pbuffer the size of the window, preferring Mesa's
+// surfaceless platform, which needs no display server at all
+static bool create_headless_context(graphics_context_t* out)
+{
+#if defined(WIN32)
+	(void)out;
+	printf("Headless rendering needs EGL, which isn't supported on Windows.\n");
+	return false;
+#else
+	EGLDisplay display = EGL_NO_DISPLAY;
+	const char* client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if ((client_extensions != NULL) && (strstr(client_extensions, "EGL_MESA_platform_surfaceless") != NULL) && (get_platform_display != NULL))
+	{
+		display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	}
+	if (display == EGL_NO_DISPLAY)
+	{
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
 	}
+	if ((display == EGL_NO_DISPLAY) || !eglInitialize(display, NULL, NULL))
+	{
+		printf("Failed to initialize EGL display.\n");
+		return false;
+	}
+	out->egl_display = display;
 
-	context->texture_image_buffer = texture_image_buffer;
+	const EGLint config_attributes[] =
+	{
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig pbuffer_config;
+	EGLint config_count = 0;
+	if (!eglChooseConfig(display, config_attributes, &pbuffer_config, 1, &config_count) || (config_count < 1))
+	{
+		printf("Failed to find an EGL pbuffer config.\n");
+		return false;
+	}
 
-	// Create texture from buffer
-	GLuint texture_image;
-	glGenTextures(1, &texture_image);
-	glBindTexture(GL_TEXTURE_2D, texture_image);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_LUMINANCE, GL_FLOAT, texture_image_buffer);
-	context->texture_image = texture_image;
+	const EGLint surface_attributes[] =
+	{
+		EGL_WIDTH, APPLICATION_WIDTH,
+		EGL_HEIGHT, APPLICATION_HEIGHT,
+		EGL_NONE
+	};
+	EGLSurface surface = eglCreatePbufferSurface(display, pbuffer_config, surface_attributes);
+	if (surface == EGL_NO_SURFACE)
+	{
+		printf("Failed to create EGL pbuffer.\n");
+		return false;
+	}
+	out->egl_surface = surface;
 
-	SDL_FreeSurface(surface);
+	// OpenGL 3.2 core, as the window asks for; a default context may be a
+	// compatibility one capped below what the batch path needs
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		printf("Failed to bind OpenGL to EGL.\n");
+		return false;
+	}
+	const EGLint context_attributes[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 2,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, pbuffer_config, EGL_NO_CONTEXT, context_attributes);
+	if (context == EGL_NO_CONTEXT)
+	{
+		printf("Failed to create OpenGL context.\n");
+		return false;
+	}
+	out->egl_context = context;
+	if (!eglMakeCurrent(display, surface, surface, context))
+	{
+		printf("Failed to make OpenGL context current.\n");
+		return false;
+	}
 	return true;
+#endif
 }
 
-bool initialize_graphics(graphics_context_t* out)
+static void destroy_headless_context(graphics_context_t* context)
 {
-	if (SDL_Init(SDL_INIT_VIDEO) < 0)
+#if !defined(WIN32)
+	EGLDisplay display = (EGLDisplay)context->egl_display;
+	if (display == NULL)
 	{
-		printf("Failed to initialize SDL.\n");
-		return false;
+		return;
+	}
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (context->egl_context != NULL)
+	{
+		eglDestroyContext(display, (EGLContext)context->egl_context);
+		context->egl_context = NULL;
+	}
+	if (context->egl_surface != NULL)
+	{
+		eglDestroySurface(display, (EGLSurface)context->egl_surface);
+		context->egl_surface = NULL;
 	}
+	eglTerminate(display);
+	context->egl_display = NULL;
+#else
+	(void)context;
+#endif
+}
+
+// Visible window with its context
+static bool create_window_context(graphics_context_t* out)
+{
+	// No deprecated features
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+
+	// OpenGL 3.2
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
+
+	// Double-buffer
+	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
 
 	SDL_Window* window = SDL_CreateWindow(
 		APPLICATION_TITLE,
@@ -111,20 +288,40 @@ bool initialize_graphics(graphics_context_t* out)
 		return false;
 	}
 	out->gl_context = gl_context;
+	return true;
+}
 
-	// No deprecated features
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-
-	// OpenGL 3.2
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
-
-	// Double-buffer
-	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+bool initialize_graphics(graphics_context_t* out, const target_t* target, bool headless)
+{
+	// Headless runs still take events, so interrupting them quits cleanly
+	if (SDL_Init(headless ? SDL_INIT_EVENTS : SDL_INIT_VIDEO) < 0)
+	{
+		printf("Failed to initialize SDL.\n");
+		return false;
+	}
+	out->headless = headless;
+	if (!(headless ? create_headless_context(out) : create_window_context(out)))
+	{
+		return false;
+	}
 
-	// Get functions
+	// Get functions. GLEW built for GLX also looks for a GLX display, which
+	// headless contexts don't have, after it has loaded every function.
 	glewExperimental = GL_TRUE;
-	glewInit();
+	const GLenum glew_result = glewInit();
+#if defined(GLEW_ERROR_NO_GLX_DISPLAY)
+	const bool glew_loaded = (glew_result == GLEW_OK) || (headless && (glew_result == GLEW_ERROR_NO_GLX_DISPLAY));
+#else
+	const bool glew_loaded = (glew_result == GLEW_OK);
+#endif
+	if (!glew_loaded)
+	{
+		printf("Failed to load OpenGL functions: %s\n", (const char*)glewGetErrorString(glew_result));
+		return false;
+	}
+
+	// GLEW's own checks can leave an error behind in core contexts
+	glGetError();
 
 	// Clear colour and bits
 	glClearColor(1.f, 1.f, 1.f, 1.f);
@@ -136,30 +333,46 @@ bool initialize_graphics(graphics_context_t* out)
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// Load the target texture file
-	if (!load_texture_image(out))
+	if ((target != NULL) && !load_texture_image(out, target))
 	{
 		printf("Failed to load texture image!\n");
 		return false;
 	}
 
 	// Create the shaders
-	if (!create_material(LINE_VERTEX_SHADER, LINE_FRAGMENT_SHADER, &out->line_material))
+	if (!create_material(LINE_MATERIAL, LINE_VERTEX_SHADER, LINE_FRAGMENT_SHADER, &out->line_material))
 	{
 		printf("Failed to create line material.\n");
 		return false;
 	}
-	else if (!create_material(TEXTURE_VERTEX_SHADER, TEXTURE_FRAGMENT_SHADER, &out->texture_material))
+	else if (!create_material(TEXTURE_MATERIAL, TEXTURE_VERTEX_SHADER, TEXTURE_FRAGMENT_SHADER, &out->texture_material))
 	{
 		printf("Failed to create texture material.\n");
 		return false;
 	}
+	else if (!create_material(BLUR_MATERIAL, BLUR_VERTEX_SHADER, BLUR_FRAGMENT_SHADER, &out->blur_material))
+	{
+		printf("Failed to create blur material.\n");
+		return false;
+	}
+
+	// Lines blurred across keep every row of the line texture
+	if (!create_float_target(APPLICATION_WIDTH, TEXTURE_HEIGHT, &out->blur_texture, &out->blur_frame_buffer))
+	{
+		printf("Failed to create blur render target.\n");
+		return false;
+	}
+	glBindTexture(GL_TEXTURE_2D, out->blur_texture);
+	set_texture_filtering(GL_TEXTURE_2D, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
 
 	// Create texture
 	GLuint texture_target;
 	const GLint detail_level = 0;
 	glGenTextures(RENDER_TARGET_COUNT, &texture_target);
 	glBindTexture(GL_TEXTURE_2D, texture_target);
-	glTexImage2D(GL_TEXTURE_2D, detail_level, GL_LUMINANCE, TEXTURE_WIDTH, TEXTURE_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
+	glTexImage2D(GL_TEXTURE_2D, detail_level, GL_RED, TEXTURE_WIDTH, TEXTURE_HEIGHT, 0, GL_RED, GL_FLOAT, NULL);
+	set_texture_filtering(GL_TEXTURE_2D, GL_LINEAR);
 	const GLenum createTextureError = glGetError();
 	if (createTextureError != GL_NO_ERROR)
 	{
@@ -169,6 +382,27 @@ bool initialize_graphics(graphics_context_t* out)
 	out->texture_target = texture_target;
 	glBindTexture(GL_TEXTURE_2D, 0);
 
+	// Readback buffers are only ever written by the GPU
+	const GLsizeiptr readback_size = APPLICATION_PIXEL_COUNT * sizeof(GLfloat);
+	for (size_t i = 0; i < READBACK_BUFFER_COUNT; ++i)
+	{
+		GLuint buffer;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, readback_size, NULL, GL_STREAM_READ);
+		out->readbacks[i].buffer = buffer;
+	}
+	glGenBuffers(1, &out->snapshot_buffer);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, out->snapshot_buffer);
+	glBufferData(GL_PIXEL_PACK_BUFFER, APPLICATION_PIXEL_COUNT * sizeof(GLubyte), NULL, GL_STREAM_READ);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	const GLenum createReadbackError = glGetError();
+	if (createReadbackError != GL_NO_ERROR)
+	{
+		printf("Failed to create readback buffers.\n");
+		return false;
+	}
+
 	// Create render target
 	GLuint frame_buffer = 0;
 	glGenFramebuffers(RENDER_TARGET_COUNT, &frame_buffer);
@@ -237,6 +471,295 @@ bool initialize_graphics(graphics_context_t* out)
 	return true;
 }
 
+bool create_score_reduction(graphics_context_t* context, size_t slot_count)
+{
+	if (!create_material(REDUCE_MATERIAL, REDUCE_VERTEX_SHADER, REDUCE_FRAGMENT_SHADER, &context->reduce_material))
+	{
+		printf("Failed to create reduce material.\n");
+		return false;
+	}
+	if (!create_float_target(APPLICATION_WIDTH, APPLICATION_HEIGHT, &context->score_texture, &context->score_frame_buffer))
+	{
+		printf("Failed to create score render target.\n");
+		return false;
+	}
+
+	// Every pass but the last, which writes into the slot's block of the atlas
+	GLint width = APPLICATION_WIDTH;
+	GLint height = APPLICATION_HEIGHT;
+	for (;;)
+	{
+		width = (width + REDUCE_FACTOR - 1) / REDUCE_FACTOR;
+		height = (height + REDUCE_FACTOR - 1) / REDUCE_FACTOR;
+		if ((width <= REDUCE_READBACK_SIZE) && (height <= REDUCE_READBACK_SIZE))
+		{
+			break;
+		}
+
+		const size_t level = context->reduce_level_count;
+		if (level == MAXIMUM_REDUCE_LEVELS)
+		{
+			printf("Too many score reduction levels.\n");
+			return false;
+		}
+		if (!create_float_target(width, height, &context->reduce_textures[level], &context->reduce_frame_buffers[level]))
+		{
+			printf("Failed to create score reduction level.\n");
+			return false;
+		}
+		context->reduce_widths[level] = width;
+		context->reduce_heights[level] = height;
+		++context->reduce_level_count;
+	}
+
+	const size_t columns = (slot_count < SCORE_ATLAS_COLUMNS ? slot_count : SCORE_ATLAS_COLUMNS);
+	const size_t rows = (slot_count + columns - 1) / columns;
+	if (!create_float_target((GLsizei)(columns * (size_t)width), (GLsizei)(rows * (size_t)height), &context->scores_texture, &context->scores_frame_buffer))
+	{
+		printf("Failed to create score atlas.\n");
+		return false;
+	}
+	context->score_texels = (GLfloat*)malloc(columns * rows * (size_t)(width * height) * sizeof(GLfloat));
+	if (context->score_texels == NULL)
+	{
+		printf("Failed to allocate score atlas copy.\n");
+		return false;
+	}
+	context->score_slot_count = slot_count;
+	context->score_columns = columns;
+	context->score_block_width = width;
+	context->score_block_height = height;
+	return true;
+}
+
+bool blur_lines(graphics_context_t* context, GLuint quad_vertex_array, GLsizei quad_index_count, GLsizei output_width, GLsizei output_height)
+{
+	assert((output_width <= APPLICATION_WIDTH) && (output_height <= APPLICATION_HEIGHT));
+	if ((output_width != context->blur_width) || (output_height != context->blur_height))
+	{
+		const float sigma = get_blur_sigma(SAMPLE_RADIUS);
+		context->blur_across = create_blur_kernel((float)TEXTURE_WIDTH / (float)output_width, sigma);
+		context->blur_down = create_blur_kernel((float)TEXTURE_HEIGHT / (float)output_height, sigma);
+		context->blur_width = output_width;
+		context->blur_height = output_height;
+	}
+
+	material_t* material = &context->blur_material;
+	activate_material(material, quad_vertex_array);
+	if (!set_line_texture(material, GL_TEXTURE_2D, context->texture_target) || !set_blur_kernel(material, &context->blur_across))
+	{
+		return false;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, context->blur_frame_buffer);
+	glViewport(0, 0, output_width, TEXTURE_HEIGHT);
+	glDrawElements(GL_TRIANGLES, quad_index_count, GL_UNSIGNED_INT, NULL);
+	return true;
+}
+
+bool reduce_score(graphics_context_t* context, size_t slot, GLuint quad_vertex_array, GLsizei quad_index_count)
+{
+	assert(slot < context->score_slot_count);
+	material_t* material = &context->reduce_material;
+	activate_material(material, quad_vertex_array);
+
+	// Sums are written as they are
+	glDisable(GL_BLEND);
+	GLuint source = context->score_texture;
+	GLint source_width = APPLICATION_WIDTH;
+	GLint source_height = APPLICATION_HEIGHT;
+	const size_t level_count = context->reduce_level_count;
+	bool success = true;
+	for (size_t i = 0; success && (i <= level_count); ++i)
+	{
+		success = set_reduce_source(material, GL_TEXTURE_2D, source, source_width, source_height);
+		if (i < level_count)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, context->reduce_frame_buffers[i]);
+			glViewport(0, 0, context->reduce_widths[i], context->reduce_heights[i]);
+			success = success && set_output_offset(material, 0, 0);
+			source = context->reduce_textures[i];
+			source_width = context->reduce_widths[i];
+			source_height = context->reduce_heights[i];
+		}
+		else
+		{
+			const GLint x = (GLint)(slot % context->score_columns) * context->score_block_width;
+			const GLint y = (GLint)(slot / context->score_columns) * context->score_block_height;
+			glBindFramebuffer(GL_FRAMEBUFFER, context->scores_frame_buffer);
+			glViewport(x, y, context->score_block_width, context->score_block_height);
+			success = success && set_output_offset(material, x, y);
+		}
+
+		if (success)
+		{
+			glDrawElements(GL_TRIANGLES, quad_index_count, GL_UNSIGNED_INT, NULL);
+		}
+	}
+	glEnable(GL_BLEND);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, APPLICATION_WIDTH, APPLICATION_HEIGHT);
+	return success;
+}
+
+bool read_scores(graphics_context_t* context, double* scores, size_t count)
+{
+	assert(count <= context->score_slot_count);
+	const size_t columns = context->score_columns;
+	const size_t block_width = (size_t)context->score_block_width;
+	const size_t block_height = (size_t)context->score_block_height;
+	const size_t atlas_width = columns * block_width;
+	const size_t rows = (count + columns - 1) / columns;
+	glBindFramebuffer(GL_FRAMEBUFFER, context->scores_frame_buffer);
+	glReadPixels(0, 0, (GLsizei)atlas_width, (GLsizei)(rows * block_height), GL_RED, GL_FLOAT, context->score_texels);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	const GLenum error = glGetError();
+	if (error != GL_NO_ERROR)
+	{
+		printf("Failed to read scores: %d (0x%x)\n", error, error);
+		return false;
+	}
+
+	// The last levels are summed in double, a row of each block at a time
+	for (size_t i = 0; i < count; ++i)
+	{
+		const GLfloat* block = context->score_texels + ((i / columns) * block_height * atlas_width) + ((i % columns) * block_width);
+		double score = 0.0;
+		for (size_t y = 0; y < block_height; ++y)
+		{
+			score += sum_floats(block + (y * atlas_width), block_width);
+		}
+		scores[i] = score;
+	}
+	return true;
+}
+
+void start_readback(graphics_context_t* context, size_t slot, GLsizei width, GLsizei height)
+{
+	readback_t* readback = &context->readbacks[slot];
+	assert((readback->pixels == NULL) && (readback->fence == NULL));
+	assert((width <= APPLICATION_WIDTH) && (height <= APPLICATION_HEIGHT));
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->buffer);
+	glReadPixels(0, 0, width, height, GL_RED, GL_FLOAT, NULL);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	readback->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+const GLfloat* map_readback(graphics_context_t* context, size_t slot)
+{
+	readback_t* readback = &context->readbacks[slot];
+	assert(readback->fence != NULL);
+
+	// Flush once so the fence is sure to be reached, then keep waiting
+	const GLuint64 timeout = 1000000000;
+	GLenum result = glClientWaitSync(readback->fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+	while (result == GL_TIMEOUT_EXPIRED)
+	{
+		result = glClientWaitSync(readback->fence, 0, timeout);
+	}
+	glDeleteSync(readback->fence);
+	readback->fence = NULL;
+	if (result == GL_WAIT_FAILED)
+	{
+		printf("Failed to wait for readback.\n");
+		return NULL;
+	}
+
+	const GLsizeiptr readback_size = APPLICATION_PIXEL_COUNT * sizeof(GLfloat);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->buffer);
+	readback->pixels = (const GLfloat*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, readback_size, GL_MAP_READ_BIT);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	if (readback->pixels == NULL)
+	{
+		printf("Failed to map readback buffer.\n");
+	}
+	return readback->pixels;
+}
+
+void unmap_readback(graphics_context_t* context, size_t slot)
+{
+	readback_t* readback = &context->readbacks[slot];
+	if (readback->pixels != NULL)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->buffer);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		readback->pixels = NULL;
+	}
+}
+
+bool start_snapshot_readback(graphics_context_t* context)
+{
+	if ((context->snapshot_fence != NULL) || (context->snapshot_pixels != NULL))
+	{
+		return false;
+	}
+
+	// Byte rows aren't padded to four like the default packing expects
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, context->snapshot_buffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, APPLICATION_WIDTH, APPLICATION_HEIGHT, GL_RED, GL_UNSIGNED_BYTE, NULL);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	context->snapshot_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	return true;
+}
+
+const GLubyte* poll_snapshot_readback(graphics_context_t* context, bool wait)
+{
+	if (context->snapshot_fence == NULL)
+	{
+		return NULL;
+	}
+
+	// Zero timeout only checks; the flush makes sure the fence gets reached
+	const GLuint64 timeout = (wait ? 1000000000 : 0);
+	GLenum result = glClientWaitSync(context->snapshot_fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+	while (wait && (result == GL_TIMEOUT_EXPIRED))
+	{
+		result = glClientWaitSync(context->snapshot_fence, 0, timeout);
+	}
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		return NULL;
+	}
+	glDeleteSync(context->snapshot_fence);
+	context->snapshot_fence = NULL;
+	if (result == GL_WAIT_FAILED)
+	{
+		printf("Failed to wait for snapshot readback.\n");
+		return NULL;
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, context->snapshot_buffer);
+	context->snapshot_pixels = (const GLubyte*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, APPLICATION_PIXEL_COUNT * sizeof(GLubyte), GL_MAP_READ_BIT);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	if (context->snapshot_pixels == NULL)
+	{
+		printf("Failed to map snapshot buffer.\n");
+	}
+	return context->snapshot_pixels;
+}
+
+void unmap_snapshot_readback(graphics_context_t* context)
+{
+	if (context->snapshot_pixels != NULL)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, context->snapshot_buffer);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		context->snapshot_pixels = NULL;
+	}
+}
+
+void present_frame(graphics_context_t* context)
+{
+	if (!context->headless)
+	{
+		SDL_GL_SwapWindow(context->window);
+	}
+}
+
 void destroy_graphics(graphics_context_t* graphics_context)
 {
 	GLuint texture_image = graphics_context->texture_image;
@@ -246,11 +769,11 @@ void destroy_graphics(graphics_context_t* graphics_context)
 		graphics_context->texture_image = INVALID_TEXTURE;
 	}
 
-	float* texture_image_buffer = graphics_context->texture_image_buffer;
-	if (texture_image_buffer != NULL)
+	GLuint texture_pyramid = graphics_context->texture_pyramid;
+	if (texture_pyramid != INVALID_TEXTURE)
 	{
-		free(texture_image_buffer);
-		graphics_context->texture_image_buffer = NULL;
+		glDeleteTextures(1, &texture_pyramid);
+		graphics_context->texture_pyramid = INVALID_TEXTURE;
 	}
 
 	GLuint texture_target = graphics_context->texture_target;
@@ -267,8 +790,100 @@ void destroy_graphics(graphics_context_t* graphics_context)
 		graphics_context->frame_buffer = INVALID_BUFFER;
 	}
 
+	for (size_t i = 0; i < READBACK_BUFFER_COUNT; ++i)
+	{
+		readback_t* readback = &graphics_context->readbacks[i];
+		unmap_readback(graphics_context, i);
+		if (readback->fence != NULL)
+		{
+			glDeleteSync(readback->fence);
+			readback->fence = NULL;
+		}
+		if (readback->buffer != INVALID_BUFFER)
+		{
+			glDeleteBuffers(1, &readback->buffer);
+			readback->buffer = INVALID_BUFFER;
+		}
+	}
+
+	unmap_snapshot_readback(graphics_context);
+	if (graphics_context->snapshot_fence != NULL)
+	{
+		glDeleteSync(graphics_context->snapshot_fence);
+		graphics_context->snapshot_fence = NULL;
+	}
+	if (graphics_context->snapshot_buffer != INVALID_BUFFER)
+	{
+		glDeleteBuffers(1, &graphics_context->snapshot_buffer);
+		graphics_context->snapshot_buffer = INVALID_BUFFER;
+	}
+
+	GLuint scores_texture = graphics_context->scores_texture;
+	if (scores_texture != INVALID_TEXTURE)
+	{
+		glDeleteTextures(1, &scores_texture);
+		graphics_context->scores_texture = INVALID_TEXTURE;
+	}
+
+	GLuint scores_frame_buffer = graphics_context->scores_frame_buffer;
+	if (scores_frame_buffer != INVALID_BUFFER)
+	{
+		glDeleteFramebuffers(1, &scores_frame_buffer);
+		graphics_context->scores_frame_buffer = INVALID_BUFFER;
+	}
+	free(graphics_context->score_texels);
+	graphics_context->score_texels = NULL;
+
+	for (size_t i = 0; i < MAXIMUM_REDUCE_LEVELS; ++i)
+	{
+		GLuint reduce_texture = graphics_context->reduce_textures[i];
+		if (reduce_texture != INVALID_TEXTURE)
+		{
+			glDeleteTextures(1, &reduce_texture);
+			graphics_context->reduce_textures[i] = INVALID_TEXTURE;
+		}
+
+		GLuint reduce_frame_buffer = graphics_context->reduce_frame_buffers[i];
+		if (reduce_frame_buffer != INVALID_BUFFER)
+		{
+			glDeleteFramebuffers(1, &reduce_frame_buffer);
+			graphics_context->reduce_frame_buffers[i] = INVALID_BUFFER;
+		}
+	}
+	graphics_context->reduce_level_count = 0;
+
+	GLuint score_texture = graphics_context->score_texture;
+	if (score_texture != INVALID_TEXTURE)
+	{
+		glDeleteTextures(1, &score_texture);
+		graphics_context->score_texture = INVALID_TEXTURE;
+	}
+
+	GLuint blur_texture = graphics_context->blur_texture;
+	if (blur_texture != INVALID_TEXTURE)
+	{
+		glDeleteTextures(1, &blur_texture);
+		graphics_context->blur_texture = INVALID_TEXTURE;
+	}
+
+	GLuint blur_frame_buffer = graphics_context->blur_frame_buffer;
+	if (blur_frame_buffer != INVALID_BUFFER)
+	{
+		glDeleteFramebuffers(1, &blur_frame_buffer);
+		graphics_context->blur_frame_buffer = INVALID_BUFFER;
+	}
+
+	GLuint score_frame_buffer = graphics_context->score_frame_buffer;
+	if (score_frame_buffer != INVALID_BUFFER)
+	{
+		glDeleteFramebuffers(1, &score_frame_buffer);
+		graphics_context->score_frame_buffer = INVALID_BUFFER;
+	}
+
 	destroy_material(&graphics_context->line_material);
 	destroy_material(&graphics_context->texture_material);
+	destroy_material(&graphics_context->reduce_material);
+	destroy_material(&graphics_context->blur_material);
 
 	SDL_GLContext* gl_context = graphics_context->gl_context;
 	if (gl_context)
@@ -283,4 +898,5 @@ void destroy_graphics(graphics_context_t* graphics_context)
 		SDL_DestroyWindow(window);
 		graphics_context->window = NULL;
 	}
+	destroy_headless_context(graphics_context);
 }
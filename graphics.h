@@ -10,26 +10,143 @@
 #include <stdbool.h>
 
 #include "material.h"
+#include "target.h"
+
+#define HEADLESS_ARGUMENT "--headless"
 
 #define RENDER_TARGET_COUNT 1
 
 #define INVALID_TEXTURE 0
 #define INVALID_BUFFER 0
 
+// Texels summed into one by each reduction pass; must match reduce.fragment
+#define REDUCE_FACTOR 4
+#define MAXIMUM_REDUCE_LEVELS 8
+
+// Passes stop once a level is at most this many texels on each side. Those
+// are read back and summed in double, so each read back texel only holds a
+// float sum of a few hundred pixels, good to about a few float roundings.
+#define REDUCE_READBACK_SIZE 16
+
+// Slots side by side in each row of the score atlas
+#define SCORE_ATLAS_COLUMNS 64
+
+// Pixel pack buffers difference images are read back through, and how many
+// readbacks are left in flight before the oldest is mapped
+#define READBACK_BUFFER_COUNT 4
+#define READBACK_LATENCY 2
+
+// Difference image being copied into a pixel pack buffer
+typedef struct readback
+{
+	GLuint buffer;
+	GLsync fence;
+	const GLfloat* pixels;
+} readback_t;
+
 typedef struct graphics_context
 {
 	SDL_Window* window;
 	SDL_GLContext gl_context;
+
+	// Headless contexts draw into an offscreen EGL pbuffer instead of a
+	// window; the handles are kept opaque so only graphics.c needs EGL
+	bool headless;
+	void* egl_display;
+	void* egl_surface;
+	void* egl_context;
 	material_t line_material;
 	material_t texture_material;
+	material_t reduce_material;
+	material_t blur_material;
 
 	// Render target
 	GLuint frame_buffer;
 	GLuint texture_target;
-	float* texture_image_buffer;
 	GLuint texture_image;
+	GLuint texture_pyramid;
+
+	// Lines blurred across at the output width, and the kernels of both
+	// blur passes at the output size they were made for
+	GLuint blur_frame_buffer;
+	GLuint blur_texture;
+	GLsizei blur_width;
+	GLsizei blur_height;
+	blur_kernel_t blur_across;
+	blur_kernel_t blur_down;
+
+	// Ring of difference image readbacks
+	readback_t readbacks[READBACK_BUFFER_COUNT];
+
+	// Greyscale copy of the window for snapshots, polled rather than waited on
+	GLuint snapshot_buffer;
+	GLsync snapshot_fence;
+	const GLubyte* snapshot_pixels;
+
+	// Float difference image, the levels it is reduced through, and an
+	// atlas holding each slot's last level, with a copy to sum it from
+	GLuint score_frame_buffer;
+	GLuint score_texture;
+	GLuint reduce_frame_buffers[MAXIMUM_REDUCE_LEVELS];
+	GLuint reduce_textures[MAXIMUM_REDUCE_LEVELS];
+	GLint reduce_widths[MAXIMUM_REDUCE_LEVELS];
+	GLint reduce_heights[MAXIMUM_REDUCE_LEVELS];
+	size_t reduce_level_count;
+	GLuint scores_frame_buffer;
+	GLuint scores_texture;
+	size_t score_slot_count;
+	size_t score_columns;
+	GLint score_block_width;
+	GLint score_block_height;
+	GLfloat* score_texels;
 } graphics_context_t;
 
 graphics_context_t null_graphics_context();
-bool initialize_graphics(graphics_context_t* out);
+// Headless contexts have no window, so need no display server; the pbuffer
+// they draw into stands in for the window's frame buffer. Without a target,
+// textures are left for the caller to create.
+bool initialize_graphics(graphics_context_t* out, const target_t* target, bool headless);
 void destroy_graphics(graphics_context_t* graphics_context);
+
+// Shows what was drawn to the window; headless contexts have nothing to show
+void present_frame(graphics_context_t* context);
+
+// Uploads the target's top level as the context's target texture, and every
+// level as the pyramid coarse passes sample
+bool load_texture_image(graphics_context_t* context, const target_t* target);
+
+// Uploads the target's top level as a texture of the caller's, for scoring
+// against several targets with one context
+bool create_target_texture(const target_t* target, GLuint* out);
+
+// Sets up summing the difference image on the GPU instead of reading it back
+bool create_score_reduction(graphics_context_t* context, size_t slot_count);
+
+// First pass of the separable blur: blurs the line texture across while
+// scaling it to the output width, into the blur target, which is left bound.
+// The texture pass blurs down it with blur_down as it takes the difference.
+bool blur_lines(graphics_context_t* context, GLuint quad_vertex_array, GLsizei quad_index_count, GLsizei output_width, GLsizei output_height);
+
+// Reduces the score texture into the given slot, drawing the screen quad's
+// vertex array; leaves the window frame buffer bound.
+bool reduce_score(graphics_context_t* context, size_t slot, GLuint quad_vertex_array, GLsizei quad_index_count);
+
+// Reads back the first slots and finishes their sums in double
+bool read_scores(graphics_context_t* context, double* scores, size_t count);
+
+// Queues a copy of the bottom left of the window's difference image, at
+// most the whole window, into the slot's buffer
+void start_readback(graphics_context_t* context, size_t slot, GLsizei width, GLsizei height);
+
+// Waits for the slot's copy and maps it; stays valid until unmapped
+const GLfloat* map_readback(graphics_context_t* context, size_t slot);
+void unmap_readback(graphics_context_t* context, size_t slot);
+
+// Queues a greyscale copy of the whole window; returns false if the last one
+// hasn't been collected yet
+bool start_snapshot_readback(graphics_context_t* context);
+
+// Maps the copy once the GPU has finished it; unless told to wait, returns
+// NULL if it hasn't yet. Stays valid until unmapped.
+const GLubyte* poll_snapshot_readback(graphics_context_t* context, bool wait);
+void unmap_snapshot_readback(graphics_context_t* context);
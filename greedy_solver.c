@@ -0,0 +1,151 @@
+#include "greedy_solver.h"
+#include <assert.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+greedy_solver_t null_greedy_solver(void)
+{
+	greedy_solver_t result;
+	result.renderer = NULL;
+	result.state = null_software_state();
+	result.nails = NULL;
+	result.nail_count = 0;
+	result.jobs = NULL;
+	return result;
+}
+
+bool create_greedy_solver(software_renderer_t* renderer, GLuint start_nail, greedy_solver_t* out)
+{
+	assert(start_nail < (GLuint)POINT_COUNT);
+	out->renderer = renderer;
+	out->nails = (nail_t*)malloc(LINES_INDEX_COUNT * sizeof(nail_t));
+	out->jobs = (greedy_job_t*)malloc(POINT_COUNT * sizeof(greedy_job_t));
+	if ((out->nails == NULL) || (out->jobs == NULL) || !create_software_state(&out->state))
+	{
+		printf("Failed to allocate greedy solver.\n");
+		return false;
+	}
+
+	// Start from a blank canvas at the first nail
+	out->nails[0] = (nail_t)start_nail;
+	out->nail_count = 1;
+	generation_t blank = create_generation(NULL);
+	if (!set_generation_nails(&blank, out->nails, 1))
+	{
+		printf("Failed to allocate greedy solver.\n");
+		destroy_generation(&blank);
+		return false;
+	}
+	software_render_state(renderer, &blank, &out->state);
+	destroy_generation(&blank);
+	return true;
+}
+
+void destroy_greedy_solver(greedy_solver_t* solver)
+{
+	destroy_software_state(&solver->state);
+	free(solver->nails);
+	solver->nails = NULL;
+	solver->nail_count = 0;
+	free(solver->jobs);
+	solver->jobs = NULL;
+	solver->renderer = NULL;
+}
+
+// Mutation drawing one more chord from the walk's last nail
+static mutation_t extend_walk(const greedy_solver_t* solver, GLuint nail)
+{
+	mutation_t result = null_mutation();
+	result.added[0].start = solver->nails[solver->nail_count - 1];
+	result.added[0].end = nail;
+	result.added_count = 1;
+	return result;
+}
+
+static void score_greedy_chord(void* job_pointer)
+{
+	greedy_job_t* job = (greedy_job_t*)job_pointer;
+	const greedy_solver_t* solver = job->solver;
+	const mutation_t mutation = extend_walk(solver, job->nail);
+	job->score = software_mutation_score(solver->renderer, &solver->state, &mutation);
+}
+
+bool greedy_step(greedy_solver_t* solver)
+{
+	if (get_greedy_line_count(solver) >= (size_t)LINES)
+	{
+		return false;
+	}
+
+	// Every chord but staying put or going straight back
+	const size_t nail_count = solver->nail_count;
+	const GLuint current = solver->nails[nail_count - 1];
+	const GLuint previous = (nail_count > 1 ? solver->nails[nail_count - 2] : current);
+	size_t job_count = 0;
+	for (GLuint nail = 0; nail < (GLuint)POINT_COUNT; ++nail)
+	{
+		if ((nail != current) && (nail != previous))
+		{
+			greedy_job_t* job = &solver->jobs[job_count++];
+			job->solver = solver;
+			job->nail = nail;
+			job->score = DBL_MAX;
+		}
+	}
+	run_tasks(solver->renderer->pool, &score_greedy_chord, solver->jobs, sizeof(greedy_job_t), job_count);
+
+	// Lowest score wins; ties go to the lowest nail so runs repeat exactly
+	const greedy_job_t* best = NULL;
+	for (size_t i = 0; i < job_count; ++i)
+	{
+		const greedy_job_t* job = &solver->jobs[i];
+		if ((best == NULL) || (job->score < best->score))
+		{
+			best = job;
+		}
+	}
+	if ((best == NULL) || (best->score >= solver->state.score))
+	{
+		return false;
+	}
+
+	const mutation_t mutation = extend_walk(solver, best->nail);
+	software_apply_mutation(solver->renderer, &solver->state, &mutation);
+	solver->nails[solver->nail_count++] = (nail_t)best->nail;
+	return true;
+}
+
+size_t get_greedy_line_count(const greedy_solver_t* solver)
+{
+	return (solver->nail_count > 0 ? solver->nail_count - 1 : 0);
+}
+
+double get_greedy_score(const greedy_solver_t* solver)
+{
+	return solver->state.score;
+}
+
+bool export_greedy_solution(const greedy_solver_t* solver, generation_t* out)
+{
+	// A generation needs at least one chord
+	assert(solver->nail_count <= LINES_INDEX_COUNT);
+	bool exported;
+	if (solver->nail_count < 2)
+	{
+		const nail_t nails[2] = { solver->nails[0], solver->nails[0] };
+		exported = set_generation_nails(out, nails, 2);
+	}
+	else
+	{
+		exported = set_generation_nails(out, solver->nails, solver->nail_count);
+	}
+	if (!exported)
+	{
+		printf("Failed to allocate genome.\n");
+		return false;
+	}
+	out->score = solver->state.score;
+	out->mutation = null_mutation();
+	return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "generation.h"
+#include "shared.h"
+#include "software_renderer.h"
+#include <GL/glew.h>
+#include <GL/gl.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Chord from the walk's last nail scored on the pool
+typedef struct greedy_job
+{
+	struct greedy_solver* solver;
+	GLuint nail;
+	double score;
+} greedy_job_t;
+
+// Classic string art walk: from the last nail, draw the chord that lowers the
+// score most, and repeat. Scores are the software renderer's, so each step
+// only visits the pixels under the chords it tries.
+typedef struct greedy_solver
+{
+	software_renderer_t* renderer;
+	software_state_t state;
+
+	// Nails visited so far, as a line strip
+	nail_t* nails;
+	size_t nail_count;
+
+	// One per nail
+	greedy_job_t* jobs;
+} greedy_solver_t;
+
+greedy_solver_t null_greedy_solver(void);
+bool create_greedy_solver(software_renderer_t* renderer, GLuint start_nail, greedy_solver_t* out);
+void destroy_greedy_solver(greedy_solver_t* solver);
+
+// Draws the best chord from the last nail. Returns false once LINES chords
+// are drawn or no chord lowers the score.
+bool greedy_step(greedy_solver_t* solver);
+size_t get_greedy_line_count(const greedy_solver_t* solver);
+double get_greedy_score(const greedy_solver_t* solver);
+
+// Copies the walk into a generation, which can seed the genetic search
+bool export_greedy_solution(const greedy_solver_t* solver, generation_t* out);
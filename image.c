@@ -0,0 +1,188 @@
+#include "image.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <SDL_image.h>
+
+// Don't add alpha
+#define MAXIMUM_SUM_BYTES 3
+
+// Values a byte can take
+#define BYTE_LEVELS 256
+
+image_t null_image(void)
+{
+	image_t result;
+	result.pixels = NULL;
+	result.width = 0;
+	result.height = 0;
+	return result;
+}
+
+// Rows of the surface one task converts
+typedef struct image_band
+{
+	const uint8_t* source;
+	size_t pitch;
+	size_t bytes_per_pixel;
+	size_t sum_bytes;
+	const float* levels;
+	float* pixels;
+	int width;
+	int row_begin;
+	int row_end;
+} image_band_t;
+
+// Inverse of the sRGB transfer function
+static float decode_srgb(float value)
+{
+	return (value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f));
+}
+
+static void convert_band(void* argument)
+{
+	const image_band_t* band = (const image_band_t*)argument;
+	const float* levels = band->levels;
+	const size_t bytes_per_pixel = band->bytes_per_pixel;
+	for (int y = band->row_begin; y < band->row_end; ++y)
+	{
+		const uint8_t* current = band->source + ((size_t)y * band->pitch);
+		float* row = band->pixels + ((size_t)y * (size_t)band->width);
+
+		// Only add RGB, skip bytes after
+		if (band->sum_bytes == MAXIMUM_SUM_BYTES)
+		{
+			for (int x = 0; x < band->width; ++x, current += bytes_per_pixel)
+			{
+				row[x] = levels[current[0]] + levels[current[1]] + levels[current[2]];
+			}
+		}
+		else
+		{
+			for (int x = 0; x < band->width; ++x, current += bytes_per_pixel)
+			{
+				float sum = 0.f;
+				for (size_t j = 0; j < band->sum_bytes; ++j)
+				{
+					sum += levels[current[j]];
+				}
+				row[x] = sum;
+			}
+		}
+	}
+}
+
+bool load_image(const char* filename, bool srgb, thread_pool_t* pool, image_t* out)
+{
+	SDL_Surface* surface = IMG_Load(filename);
+	if (surface == NULL)
+	{
+		printf("Failed to load image from %s.\n", filename);
+		return false;
+	}
+
+	const int width = surface->w;
+	const int height = surface->h;
+	const size_t pixel_count = (size_t)width * (size_t)height;
+	float* pixels = (float*)malloc(pixel_count * sizeof(float));
+	if (pixels == NULL)
+	{
+		printf("Failed to allocate image buffer for %s.\n", filename);
+		SDL_FreeSurface(surface);
+		return false;
+	}
+
+	// Average the bytes for the image, each mapped through a table that
+	// already holds its share of the average
+	const float maximum_value = 255.f;
+	const SDL_PixelFormat* format = surface->format;
+	const size_t bytes_per_pixel = (size_t)format->BytesPerPixel;
+	const size_t sum_bytes = (bytes_per_pixel < MAXIMUM_SUM_BYTES ? bytes_per_pixel : MAXIMUM_SUM_BYTES);
+	const float average_denominator = (float)sum_bytes;
+	float levels[BYTE_LEVELS];
+	for (int i = 0; i < BYTE_LEVELS; ++i)
+	{
+		const float value = (float)i / maximum_value;
+		levels[i] = (srgb ? decode_srgb(value) : value) / average_denominator;
+	}
+	printf("Image contains %d bytes per pixel...\n", (int)bytes_per_pixel);
+
+	// Rows are split evenly over the pool
+	SDL_LockSurface(surface);
+	size_t band_count = get_worker_count(pool);
+	band_count = (band_count < (size_t)height ? band_count : (size_t)height);
+	image_band_t* bands = (image_band_t*)malloc((band_count > 0 ? band_count : 1) * sizeof(image_band_t));
+	if (bands == NULL)
+	{
+		printf("Failed to allocate image bands for %s.\n", filename);
+		SDL_UnlockSurface(surface);
+		SDL_FreeSurface(surface);
+		free(pixels);
+		return false;
+	}
+	for (size_t i = 0; i < band_count; ++i)
+	{
+		image_band_t* band = &bands[i];
+		band->source = (const uint8_t*)surface->pixels;
+		band->pitch = (size_t)surface->pitch;
+		band->bytes_per_pixel = bytes_per_pixel;
+		band->sum_bytes = sum_bytes;
+		band->levels = levels;
+		band->pixels = pixels;
+		band->width = width;
+		band->row_begin = (int)((i * (size_t)height) / band_count);
+		band->row_end = (int)(((i + 1) * (size_t)height) / band_count);
+	}
+	run_tasks(pool, &convert_band, bands, sizeof(image_band_t), band_count);
+	free(bands);
+	SDL_UnlockSurface(surface);
+	SDL_FreeSurface(surface);
+
+	out->pixels = pixels;
+	out->width = width;
+	out->height = height;
+	return true;
+}
+
+void destroy_image(image_t* image)
+{
+	float* pixels = image->pixels;
+	if (pixels != NULL)
+	{
+		free(pixels);
+		image->pixels = NULL;
+	}
+	image->width = 0;
+	image->height = 0;
+}
+
+static int wrap_coordinate(int value, int size)
+{
+	const int wrapped = value % size;
+	return (wrapped < 0 ? wrapped + size : wrapped);
+}
+
+float sample_image(const image_t* image, float u, float v)
+{
+	const int width = image->width;
+	const int height = image->height;
+
+	// Texel centres sit at half-integer coordinates
+	const float x = (u * (float)width) - 0.5f;
+	const float y = (v * (float)height) - 0.5f;
+	const float floor_x = floorf(x);
+	const float floor_y = floorf(y);
+	const float weight_x = x - floor_x;
+	const float weight_y = y - floor_y;
+	const int x0 = wrap_coordinate((int)floor_x, width);
+	const int y0 = wrap_coordinate((int)floor_y, height);
+	const int x1 = wrap_coordinate(x0 + 1, width);
+	const int y1 = wrap_coordinate(y0 + 1, height);
+
+	const float* row0 = image->pixels + ((size_t)y0 * (size_t)width);
+	const float* row1 = image->pixels + ((size_t)y1 * (size_t)width);
+	const float top = row0[x0] + (weight_x * (row0[x1] - row0[x0]));
+	const float bottom = row1[x0] + (weight_x * (row1[x1] - row1[x0]));
+	return top + (weight_y * (bottom - top));
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "thread_pool.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Greyscale image with one float per pixel in [0, 1]
+typedef struct image
+{
+	float* pixels;
+	int width;
+	int height;
+} image_t;
+
+image_t null_image(void);
+
+// Averages the colour channels of every pixel, decoding them from sRGB to
+// linear light first if asked, with rows split over the pool
+bool load_image(const char* filename, bool srgb, thread_pool_t* pool, image_t* out);
+void destroy_image(image_t* image);
+
+// Bilinear sample with repeat wrapping, matching GL_LINEAR/GL_REPEAT
+float sample_image(const image_t* image, float u, float v);
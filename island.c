@@ -0,0 +1,302 @@
+#include "island.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Keeps island generators apart when seeded from the same run seed
+#define ISLAND_SEED_STRIDE 0xD1B54A32D192ED03ull
+
+static migration_channel_t null_migration_channel(void)
+{
+	migration_channel_t result;
+	for (size_t i = 0; i < MIGRATION_CHANNEL_CAPACITY; ++i)
+	{
+		result.slots[i].genome = null_genome();
+		result.slots[i].score = 0.0;
+	}
+	result.sent = 0;
+	result.received = 0;
+	return result;
+}
+
+static void destroy_migration_channel(migration_channel_t* channel)
+{
+	for (size_t i = 0; i < MIGRATION_CHANNEL_CAPACITY; ++i)
+	{
+		destroy_genome(&channel->slots[i].genome);
+	}
+	*channel = null_migration_channel();
+}
+
+// Drops the genome if the channel is full
+static bool send_migrant(migration_channel_t* channel, const generation_t* generation)
+{
+	if ((channel->sent - channel->received) == MIGRATION_CHANNEL_CAPACITY)
+	{
+		return false;
+	}
+
+	migrant_t* slot = &channel->slots[channel->sent % MIGRATION_CHANNEL_CAPACITY];
+	share_genome(&generation->genome, &slot->genome);
+	slot->score = generation->score;
+	++channel->sent;
+	return true;
+}
+
+// Takes the oldest arrival, if any
+static bool receive_migrant(migration_channel_t* channel, generation_t* out)
+{
+	if (channel->sent == channel->received)
+	{
+		return false;
+	}
+
+	// Takes the slot's share, so the slot holds nothing once handed back
+	migrant_t* slot = &channel->slots[channel->received % MIGRATION_CHANNEL_CAPACITY];
+	share_genome(&slot->genome, &out->genome);
+	destroy_genome(&slot->genome);
+	out->nails_current = false;
+	out->score = slot->score;
+	out->mutation = null_mutation();
+	out->parent_state = NULL;
+	++channel->received;
+	return true;
+}
+
+archipelago_t null_archipelago(void)
+{
+	archipelago_t result;
+	result.islands = NULL;
+	result.island_count = 0;
+	result.migration_interval = MIGRATION_INTERVAL;
+	result.incremental = false;
+	result.pool = NULL;
+	result.run_length = 0;
+	result.arena = null_arena();
+	return result;
+}
+
+bool create_archipelago
+(
+	const software_renderer_t* renderer,
+	size_t island_count,
+	size_t migration_interval,
+	bool incremental,
+	uint64_t seed,
+	archipelago_t* out
+)
+{
+	assert(island_count > 0);
+	out->migration_interval = (migration_interval > 0 ? migration_interval : MIGRATION_INTERVAL);
+	out->incremental = incremental;
+	out->pool = renderer->pool;
+
+	// Islands, their candidates and ranks together, each on its own lines
+	const size_t candidates_size = ALIGN_ARENA(CANDIDATE_COUNT * sizeof(generation_t));
+	const size_t ranks_size = ALIGN_ARENA(CANDIDATE_COUNT * sizeof(generation_rank_t));
+	const size_t capacity = ALIGN_ARENA(island_count * sizeof(island_t)) + (island_count * (candidates_size + ranks_size));
+	if (!create_arena(capacity, renderer->arena.huge_pages, &out->arena))
+	{
+		printf("Failed to allocate islands.\n");
+		return false;
+	}
+	out->islands = (island_t*)allocate_arena(&out->arena, island_count * sizeof(island_t));
+
+	// Initialized before anything can fail, so all of them can be destroyed
+	for (size_t i = 0; i < island_count; ++i)
+	{
+		island_t* island = &out->islands[i];
+		island->archipelago = out;
+		island->index = i;
+		island->candidates = NULL;
+		island->ranks = NULL;
+		island->renderer = null_software_renderer();
+		island->random = seed_random(seed + (i * ISLAND_SEED_STRIDE));
+		island->generation = 0;
+		island->channel = null_migration_channel();
+		island->failed = false;
+	}
+	out->island_count = island_count;
+
+	// Islands already run as tasks on the pool, so with more than one their
+	// scoring and breeding stay on the island's thread. Waiting on the pool
+	// from inside a task would run the other islands on its stack instead.
+	const bool serial = (island_count > 1);
+	for (size_t i = 0; i < island_count; ++i)
+	{
+		island_t* island = &out->islands[i];
+		island->candidates = (generation_t*)allocate_arena(&out->arena, CANDIDATE_COUNT * sizeof(generation_t));
+		island->ranks = (generation_rank_t*)allocate_arena(&out->arena, CANDIDATE_COUNT * sizeof(generation_rank_t));
+		for (size_t j = 0; j < CANDIDATE_COUNT; ++j)
+		{
+			island->candidates[j] = create_generation(&island->random);
+		}
+		if (!share_software_renderer(renderer, serial, &island->renderer))
+		{
+			printf("Failed to create renderer for island %u.\n", (unsigned int)i);
+			return false;
+		}
+	}
+	return true;
+}
+
+void destroy_archipelago(archipelago_t* archipelago)
+{
+	for (size_t i = 0; i < archipelago->island_count; ++i)
+	{
+		island_t* island = &archipelago->islands[i];
+		if (island->candidates != NULL)
+		{
+			for (size_t j = 0; j < CANDIDATE_COUNT; ++j)
+			{
+				destroy_generation(&island->candidates[j]);
+			}
+			island->candidates = NULL;
+		}
+		destroy_software_renderer(&island->renderer);
+		destroy_migration_channel(&island->channel);
+	}
+	destroy_arena(&archipelago->arena);
+	archipelago->islands = NULL;
+	archipelago->island_count = 0;
+}
+
+void seed_archipelago(archipelago_t* archipelago, const generation_t* seed)
+{
+	for (size_t i = 0; i < archipelago->island_count; ++i)
+	{
+		island_t* island = &archipelago->islands[i];
+		for (size_t j = 0; j < CANDIDATE_COUNT; ++j)
+		{
+			copy_generation(seed, &island->candidates[j]);
+		}
+	}
+}
+
+// Lets arrivals replace the island's last offspring before they are scored.
+// Only candidates holding no incremental state are replaced, so states are
+// still released and rebuilt as usual.
+static void receive_migrants(island_t* island)
+{
+	generation_t* candidates = island->candidates;
+	for (size_t i = CANDIDATE_COUNT; i > (size_t)FITTEST_COUNT; --i)
+	{
+		generation_t* candidate = &candidates[i - 1];
+		if (candidate->state != NULL)
+		{
+			continue;
+		}
+		if (!receive_migrant(&island->channel, candidate))
+		{
+			break;
+		}
+	}
+}
+
+// Every island sends its best on, then every island takes what arrived, in
+// index order between runs, so the same seed always trades the same genomes
+static void migrate(archipelago_t* archipelago)
+{
+	const size_t island_count = archipelago->island_count;
+	for (size_t i = 0; i < island_count; ++i)
+	{
+		island_t* next = &archipelago->islands[(i + 1) % island_count];
+		send_migrant(&next->channel, &archipelago->islands[i].candidates[0]);
+	}
+	for (size_t i = 0; i < island_count; ++i)
+	{
+		receive_migrants(&archipelago->islands[i]);
+	}
+}
+
+static bool step_island(island_t* island)
+{
+	archipelago_t* archipelago = island->archipelago;
+	software_renderer_t* renderer = &island->renderer;
+	generation_t* candidates = island->candidates;
+
+	// Survivors keep their score; offspring only visit what changed
+	software_score_offspring(renderer, candidates, CANDIDATE_COUNT);
+	for (size_t i = 0; i < CANDIDATE_COUNT; ++i)
+	{
+		generation_t* candidate = &candidates[i];
+		if ((candidate->state == NULL) && (candidate->parent_state == NULL))
+		{
+			software_render_generation(renderer, candidate);
+		}
+	}
+
+	// Now sort the candidates by score
+	sort_generations(candidates, island->ranks, CANDIDATE_COUNT);
+	++island->generation;
+	if (archipelago->incremental)
+	{
+		const bool refresh = ((island->generation % REFRESH_FREQUENCY) == 0);
+		if (!update_software_states(renderer, candidates, CANDIDATE_COUNT, refresh))
+		{
+			return false;
+		}
+	}
+
+	// Generate off-spring for the best ones
+	breed_offspring(candidates, &island->random, renderer->serial ? NULL : archipelago->pool);
+	for (size_t i = FITTEST_COUNT; i < CANDIDATE_COUNT; ++i)
+	{
+		candidates[i].parent_state = candidates[candidates[i].parent_slot].state;
+	}
+	return true;
+}
+
+static void run_island(void* island_pointer)
+{
+	island_t* island = (island_t*)island_pointer;
+	const int generation_count = island->archipelago->run_length;
+	for (int i = 0; (i < generation_count) && !island->failed; ++i)
+	{
+		island->failed = !step_island(island);
+	}
+}
+
+static bool has_island_failed(const archipelago_t* archipelago)
+{
+	for (size_t i = 0; i < archipelago->island_count; ++i)
+	{
+		if (archipelago->islands[i].failed)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool run_archipelago(archipelago_t* archipelago, int generation_count)
+{
+	// Islands run apart up to each migration, and only meet once all are there
+	const int interval = (int)archipelago->migration_interval;
+	int remaining = generation_count;
+	while (remaining > 0)
+	{
+		const int generation = archipelago->islands[0].generation;
+		const int until_migration = interval - (generation % interval);
+		archipelago->run_length = (until_migration < remaining ? until_migration : remaining);
+		run_tasks(archipelago->pool, &run_island, archipelago->islands, sizeof(island_t), archipelago->island_count);
+		remaining -= archipelago->run_length;
+		if (has_island_failed(archipelago))
+		{
+			return false;
+		}
+
+		if ((archipelago->island_count > 1) && ((archipelago->islands[0].generation % interval) == 0))
+		{
+			migrate(archipelago);
+		}
+	}
+	return true;
+}
+
+const generation_t* get_island_best(const archipelago_t* archipelago, size_t island)
+{
+	assert(island < archipelago->island_count);
+	return &archipelago->islands[island].candidates[0];
+}
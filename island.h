@@ -0,0 +1,93 @@
+#pragma once
+
+#include "arena.h"
+#include "generation.h"
+#include "random.h"
+#include "shared.h"
+#include "software_renderer.h"
+#include "thread_pool.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Generations between each island sending its best to the next
+#define MIGRATION_INTERVAL 50
+
+// Migrants one island can have waiting; more are dropped
+#define MIGRATION_CHANNEL_CAPACITY 4
+
+// Generations between rebuilding incremental states from scratch
+#define REFRESH_FREQUENCY 1000
+
+// Genome in transit between islands
+typedef struct migrant
+{
+	genome_t genome;
+	double score;
+} migrant_t;
+
+// Ring of arrivals waiting for the island. Only touched between runs, while
+// no island is running, so it needs no locks.
+typedef struct migration_channel
+{
+	migrant_t slots[MIGRATION_CHANNEL_CAPACITY];
+	size_t sent;
+	size_t received;
+} migration_channel_t;
+
+// Population evolving on its own, with its own renderer states and
+// generator, so islands can run at once on the pool. Each island scores and
+// breeds on the thread running it, so at most one island per worker is busy.
+typedef struct island
+{
+	struct archipelago* archipelago;
+	size_t index;
+	generation_t* candidates;
+	generation_rank_t* ranks;
+	software_renderer_t renderer;
+	random_state_t random;
+	int generation;
+
+	// Migrants from the previous island in the ring
+	migration_channel_t channel;
+	bool failed;
+} island_t;
+
+// Ring of islands trading their best genomes every few generations
+typedef struct archipelago
+{
+	island_t* islands;
+	size_t island_count;
+	size_t migration_interval;
+	bool incremental;
+	thread_pool_t* pool;
+
+	// Generations each island runs before they next meet
+	int run_length;
+
+	// Holds the islands with their candidates and ranks
+	arena_t arena;
+} archipelago_t;
+
+archipelago_t null_archipelago(void);
+
+// Islands share the renderer's tables, so it must outlive them
+bool create_archipelago
+(
+	const software_renderer_t* renderer,
+	size_t island_count,
+	size_t migration_interval,
+	bool incremental,
+	uint64_t seed,
+	archipelago_t* out
+);
+void destroy_archipelago(archipelago_t* archipelago);
+
+// Starts every island's population from the genome
+void seed_archipelago(archipelago_t* archipelago, const generation_t* seed);
+
+// Runs every island for the given number of generations, all at once. They
+// stop together at each migration, so a seed reproduces the same run.
+bool run_archipelago(archipelago_t* archipelago, int generation_count);
+
+// Fittest genome found by the island in its last generation
+const generation_t* get_island_best(const archipelago_t* archipelago, size_t island);
@@ -0,0 +1,181 @@
+#include "job.h"
+#include "file_io.h"
+#include "graphics.h"
+#include "shared.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+
+static double get_seconds(void)
+{
+	return (double)SDL_GetPerformanceCounter() / (double)SDL_GetPerformanceFrequency();
+}
+
+job_list_t null_job_list(void)
+{
+	job_list_t result;
+	result.text = NULL;
+	result.filenames = NULL;
+	result.count = 0;
+	return result;
+}
+
+bool load_job_list(const char* filename, job_list_t* out)
+{
+	file_buffer_t file = null_file_buffer();
+	if (!read_file(filename, &file))
+	{
+		printf("Failed to read job list %s.\n", filename);
+		return false;
+	}
+
+	// Lines are cut in place, so the text is kept for the names to point into
+	out->text = (char*)malloc(file.length + 1);
+	out->filenames = (const char**)malloc(((file.length / 2) + 1) * sizeof(const char*));
+	if ((out->text == NULL) || (out->filenames == NULL))
+	{
+		destroy_file_buffer(&file);
+		printf("Failed to allocate job list.\n");
+		return false;
+	}
+	memcpy(out->text, file.data, file.length);
+	out->text[file.length] = '\0';
+	destroy_file_buffer(&file);
+
+	char* line = out->text;
+	while (line != NULL)
+	{
+		char* end = strchr(line, '\n');
+		char* next = NULL;
+		if (end != NULL)
+		{
+			*end = '\0';
+			next = end + 1;
+		}
+		else
+		{
+			end = line + strlen(line);
+		}
+
+		// Trailing spaces and carriage returns aren't part of the path
+		while ((end > line) && ((end[-1] == '\r') || (end[-1] == ' ') || (end[-1] == '\t')))
+		{
+			*--end = '\0';
+		}
+		if ((line[0] != '\0') && (line[0] != '#'))
+		{
+			out->filenames[out->count++] = line;
+		}
+		line = next;
+	}
+	if (out->count == 0)
+	{
+		printf("Job list %s has no images.\n", filename);
+		return false;
+	}
+	return true;
+}
+
+void destroy_job_list(job_list_t* list)
+{
+	free(list->text);
+	free((void*)list->filenames);
+	*list = null_job_list();
+}
+
+job_t null_job(void)
+{
+	job_t result;
+	result.index = 0;
+	result.filename = NULL;
+	result.name[0] = '\0';
+	result.texture = INVALID_TEXTURE;
+	result.arena = null_arena();
+	result.candidates = NULL;
+	result.ranks = NULL;
+	result.random = seed_random(0);
+	result.generation = 0;
+	result.started = 0.0;
+	result.rendered = false;
+	return result;
+}
+
+// Image path without its extension, so results land beside it
+static void set_job_name(job_t* job)
+{
+	const char* filename = job->filename;
+	const char* slash = strrchr(filename, '/');
+	const char* backslash = strrchr(filename, '\\');
+	const char* base = (backslash > slash ? backslash : slash);
+	const char* dot = strrchr(filename, '.');
+	const size_t stem_length = (((dot != NULL) && ((base == NULL) || (dot > base))) ? (size_t)(dot - filename) : strlen(filename));
+	snprintf(job->name, sizeof(job->name), "%.*s%s", (int)stem_length, filename, JOB_NAME_SUFFIX);
+}
+
+bool create_job(const job_list_t* list, size_t index, const job_settings_t* settings, thread_pool_t* pool, job_t* out)
+{
+	*out = null_job();
+	out->index = index;
+	out->filename = list->filenames[index];
+	set_job_name(out);
+	target_t target = null_target();
+	const bool uploaded = load_target(out->filename, settings->srgb, pool, &target)
+		&& create_target_texture(&target, &out->texture);
+	destroy_target(&target);
+	if (!uploaded)
+	{
+		printf("Failed to prepare job image %s.\n", out->filename);
+		return false;
+	}
+
+	const size_t capacity = ALIGN_ARENA(CANDIDATE_COUNT * sizeof(generation_t))
+		+ ALIGN_ARENA(CANDIDATE_COUNT * sizeof(generation_rank_t));
+	if (!create_arena(capacity, settings->huge_pages, &out->arena))
+	{
+		printf("Failed to allocate job candidates.\n");
+		return false;
+	}
+	out->candidates = (generation_t*)allocate_arena(&out->arena, CANDIDATE_COUNT * sizeof(generation_t));
+	out->ranks = (generation_rank_t*)allocate_arena(&out->arena, CANDIDATE_COUNT * sizeof(generation_rank_t));
+	out->random = derive_random(settings->seed, (uint64_t)index);
+	for (size_t i = 0; i < CANDIDATE_COUNT; ++i)
+	{
+		out->candidates[i] = create_generation(&out->random);
+	}
+	out->started = get_seconds();
+	return true;
+}
+
+void destroy_job(job_t* job)
+{
+	if (job->candidates != NULL)
+	{
+		for (size_t i = 0; i < CANDIDATE_COUNT; ++i)
+		{
+			destroy_generation(&job->candidates[i]);
+		}
+	}
+	destroy_arena(&job->arena);
+	if (job->texture != INVALID_TEXTURE)
+	{
+		glDeleteTextures(1, &job->texture);
+	}
+	*job = null_job();
+}
+
+bool is_job_active(const job_t* job)
+{
+	return (job->candidates != NULL);
+}
+
+bool is_job_finished(const job_t* job, const job_settings_t* settings)
+{
+	return ((size_t)job->generation >= settings->generations)
+		|| ((settings->seconds > 0.0) && (get_job_seconds(job) >= settings->seconds));
+}
+
+double get_job_seconds(const job_t* job)
+{
+	return get_seconds() - job->started;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "arena.h"
+#include "generation.h"
+#include "random.h"
+#include "snapshot.h"
+#include "thread_pool.h"
+#include <GL/glew.h>
+#include <GL/gl.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define JOBS_ARGUMENT "--jobs"
+#define JOB_SLOTS_ARGUMENT "--job-slots"
+#define JOB_GENERATIONS_ARGUMENT "--job-generations"
+#define JOB_SECONDS_ARGUMENT "--job-seconds"
+
+// Jobs in flight at once; one scores while the next renders
+#define JOB_SLOTS 2
+
+// Budget of each job unless given; a time budget is optional
+#define JOB_GENERATIONS 1000
+
+// Results are written next to each image, named after it with this suffix
+#define JOB_NAME_SUFFIX "-thread"
+
+// Target images to convert, one path per line of a text file. Blank lines
+// and lines starting with # are skipped.
+typedef struct job_list
+{
+	char* text;
+	const char** filenames;
+	size_t count;
+} job_list_t;
+
+job_list_t null_job_list(void);
+bool load_job_list(const char* filename, job_list_t* out);
+void destroy_job_list(job_list_t* list);
+
+// What every job is given; each one stops at whichever budget runs out first
+typedef struct job_settings
+{
+	size_t slot_count;
+	size_t generations;
+	double seconds;
+	bool srgb;
+	bool huge_pages;
+	uint64_t seed;
+} job_settings_t;
+
+// One image's search. Everything else, from the nails to the renderer and
+// its programs, is shared by every job in the process.
+typedef struct job
+{
+	size_t index;
+	const char* filename;
+	char name[SNAPSHOT_NAME_LENGTH];
+
+	// Target as uploaded; the prepared image is let go after
+	GLuint texture;
+
+	// Candidates and their ranks, on their own generator
+	arena_t arena;
+	generation_t* candidates;
+	generation_rank_t* ranks;
+	random_state_t random;
+	int generation;
+	double started;
+
+	// Candidates have been drawn and are waiting to be scored
+	bool rendered;
+} job_t;
+
+job_t null_job(void);
+
+// Prepares the list's image at the index and a random population for it;
+// jobs are seeded by their index, so any order of them searches the same
+bool create_job(const job_list_t* list, size_t index, const job_settings_t* settings, thread_pool_t* pool, job_t* out);
+void destroy_job(job_t* job);
+bool is_job_active(const job_t* job);
+
+// Whether the job has spent its generations or its time
+bool is_job_finished(const job_t* job, const job_settings_t* settings);
+double get_job_seconds(const job_t* job);
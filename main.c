@@ -1,70 +1,665 @@
+#include "arena.h"
+#include "batch_renderer.h"
+#include "checkpoint.h"
+#include "config.h"
 #include "generation.h"
 #include "graphics.h"
+#include "greedy_solver.h"
+#include "island.h"
+#include "job.h"
+#include "profiler.h"
+#include "random.h"
+#include "resolution.h"
 #include "shared.h"
+#include "snapshot.h"
+#include "software_renderer.h"
+#include "target.h"
+#include "thread_pool.h"
 #include "vector2d.h"
 #include <assert.h>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 
+#define TEXTURE_IMAGE_FILENAME "texture.png"
+#define SOFTWARE_BACKEND_ARGUMENT "--software"
+#define INCREMENTAL_ARGUMENT "--incremental"
+#define PIN_THREADS_ARGUMENT "--pin-threads"
+#define GPU_REDUCE_ARGUMENT "--gpu-reduce"
+#define BATCH_ARGUMENT "--batch"
+#define HUGE_PAGES_ARGUMENT "--huge-pages"
+#define GREEDY_ARGUMENT "--greedy"
+#define ISLANDS_ARGUMENT "--islands"
+#define MIGRATION_INTERVAL_ARGUMENT "--migration-interval"
+#define SEED_ARGUMENT "--seed"
+
+typedef enum render_backend
+{
+	OPENGL_BACKEND,
+	SOFTWARE_BACKEND
+} render_backend_t;
+
+// Value following the argument, or the default if absent or not a count
+size_t parse_count(int argc, char** argv, const char* name, size_t default_value)
+{
+	const char* text = find_argument_value(argc, argv, name);
+	const long value = (text != NULL ? strtol(text, NULL, 10) : 0);
+	return (value > 0 ? (size_t)value : default_value);
+}
+
+// Seed following the argument, or the default if absent or not a number
+unsigned int parse_seed(int argc, char** argv, unsigned int default_value)
+{
+	const char* text = find_argument_value(argc, argv, SEED_ARGUMENT);
+	if (text == NULL)
+	{
+		return default_value;
+	}
+	char* end;
+	const unsigned long value = strtoul(text, &end, 10);
+	return ((end != text) && (*end == '\0') ? (unsigned int)value : default_value);
+}
+
+// Processor time of every thread so far, for comparing engines
+static double get_cpu_seconds(void)
+{
+	return (double)clock() / (double)CLOCKS_PER_SEC;
+}
+
+// Walks greedily from a random nail and starts every candidate from the result
+static bool seed_from_greedy(software_renderer_t* renderer, generation_t* candidates, size_t candidate_count, random_state_t* random)
+{
+	greedy_solver_t solver = null_greedy_solver();
+	if (!create_greedy_solver(renderer, (GLuint)random_below(random, POINT_COUNT), &solver))
+	{
+		destroy_greedy_solver(&solver);
+		return false;
+	}
+
+	while (greedy_step(&solver))
+	{
+		const size_t line_count = get_greedy_line_count(&solver);
+		if ((line_count % LOG_FREQUENCY) == 0)
+		{
+			printf("Greedy: Score = %f, Lines = %d, CPU time = %.1f s\n", get_greedy_score(&solver), (int)line_count, get_cpu_seconds());
+		}
+	}
+	printf("Greedy finished: Score = %f, Lines = %d, CPU time = %.1f s\n\n", get_greedy_score(&solver), (int)get_greedy_line_count(&solver), get_cpu_seconds());
+
+	// Exported once; the rest share its genome
+	const bool exported = export_greedy_solution(&solver, &candidates[0]);
+	destroy_greedy_solver(&solver);
+	if (!exported)
+	{
+		return false;
+	}
+	for (size_t i = 1; i < candidate_count; ++i)
+	{
+		copy_generation(&candidates[0], &candidates[i]);
+		candidates[i].mutation = null_mutation();
+	}
+	return true;
+}
+
+// Evolves software populations as islands on the pool until one fails,
+// starting from the seed genome if given
+static void run_islands
+(
+	const software_renderer_t* renderer,
+	const generation_t* seed_genome,
+	size_t island_count,
+	size_t migration_interval,
+	bool incremental,
+	bool checkpointing,
+	bool resume,
+	uint64_t seed
+)
+{
+	archipelago_t archipelago = null_archipelago();
+	if (!create_archipelago(renderer, island_count, migration_interval, incremental, seed, &archipelago))
+	{
+		destroy_archipelago(&archipelago);
+		return;
+	}
+	if (seed_genome != NULL)
+	{
+		seed_archipelago(&archipelago, seed_genome);
+	}
+
+	// Every island is checkpointed together; islands aren't journaled, as they
+	// step concurrently
+	population_t* populations = (population_t*)malloc(island_count * sizeof(population_t));
+	if (populations == NULL)
+	{
+		destroy_archipelago(&archipelago);
+		return;
+	}
+	for (size_t i = 0; i < island_count; ++i)
+	{
+		island_t* island = &archipelago.islands[i];
+		populations[i].candidates = island->candidates;
+		populations[i].random = &island->random;
+		populations[i].generation = &island->generation;
+	}
+	uint64_t run_id = 0;
+	checkpoint_writer_t checkpoint_writer = null_checkpoint_writer();
+	if ((resume && !load_checkpoint(CHECKPOINT_FILENAME, populations, island_count, &run_id))
+		|| (checkpointing && !create_checkpoint_writer(CHECKPOINT_FILENAME, NULL, seed, NULL, &checkpoint_writer)))
+	{
+		destroy_checkpoint_writer(&checkpoint_writer);
+		free(populations);
+		destroy_archipelago(&archipelago);
+		return;
+	}
+
+	int generation = archipelago.islands[0].generation;
+	bool stopping = false;
+	do
+	{
+		printf("Generation #%d (CPU time %.1f s):\n", generation + 1, get_cpu_seconds());
+		for (size_t i = 0; i < island_count; ++i)
+		{
+			const generation_t* best = get_island_best(&archipelago, i);
+			printf("Island #%d: Score = %f, Lines = %d\n", (int)i + 1, best->score, (int)get_generation_length(best));
+		}
+		printf("\n");
+
+		// A stop request ends the run on a final checkpoint
+		if (checkpointing)
+		{
+			stopping = is_stop_requested();
+			if (stopping)
+			{
+				flush_checkpoint(&checkpoint_writer, populations, island_count);
+			}
+			else if ((generation % CHECKPOINT_INTERVAL) == 0)
+			{
+				submit_checkpoint(&checkpoint_writer, populations, island_count);
+			}
+		}
+		generation += LOG_FREQUENCY;
+	} while (!stopping && run_archipelago(&archipelago, LOG_FREQUENCY));
+	destroy_checkpoint_writer(&checkpoint_writer);
+	free(populations);
+	destroy_archipelago(&archipelago);
+}
+
+// Picks the population up from the last checkpoint and the journal after
+// it, or rebuilds the given generation from the journal alone
+static bool restore_population(const population_t* population, size_t replay_generation)
+{
+	if (replay_generation > 0)
+	{
+		const int last_generation = (replay_generation < INT_MAX ? (int)replay_generation : INT_MAX);
+		return replay_journal(JOURNAL_FILENAME, 0, true, last_generation, population);
+	}
+
+	uint64_t run_id = 0;
+	return load_checkpoint(CHECKPOINT_FILENAME, population, 1, &run_id)
+		&& replay_journal(JOURNAL_FILENAME, run_id, false, INT_MAX, population);
+}
+
+// Journals the sorted survivors and checkpoints them now and then, or
+// right away when the run is ending
+static bool record_population(checkpoint_writer_t* writer, const population_t* population, bool final)
+{
+	if (!journal_generation(writer, population))
+	{
+		return false;
+	}
+	if (final)
+	{
+		return flush_checkpoint(writer, population, 1);
+	}
+	if ((*population->generation % CHECKPOINT_INTERVAL) == 0)
+	{
+		return submit_checkpoint(writer, population, 1);
+	}
+	return true;
+}
+
+// Maps a finished readback and sums it on the pool, straight from the buffer
+static bool score_readback(graphics_context_t* context, thread_pool_t* pool, task_group_t* groups, generation_t* candidate, size_t slot, size_t pixel_count)
+{
+	const GLfloat* pixels = map_readback(context, slot);
+	if (pixels == NULL)
+	{
+		return false;
+	}
+	candidate->score_pixels = pixels;
+	candidate->score_pixel_count = pixel_count;
+	submit_task(pool, &groups[slot], &compute_score, candidate);
+	return true;
+}
+
+// Hands a finished snapshot readback to the writer; only waits on either if
+// told to
+static void collect_snapshot(graphics_context_t* context, snapshot_writer_t* writer, bool wait)
+{
+	const GLubyte* pixels = poll_snapshot_readback(context, wait);
+	if (pixels != NULL)
+	{
+		submit_snapshot(writer, pixels);
+		unmap_snapshot_readback(context);
+	}
+}
+
+// Copies the window, drawn as the candidate's blurred lines, for a snapshot
+// unless the last one is still being read back. Frames to keep wait for it.
+static bool start_snapshot(graphics_context_t* context, snapshot_writer_t* writer, const char* name, bool keep, generation_t* candidate, int generation)
+{
+	if (keep)
+	{
+		collect_snapshot(context, writer, true);
+	}
+	if (!start_snapshot_readback(context))
+	{
+		return true;
+	}
+	const nail_t* nails = get_generation_nails(candidate);
+	return (nails != NULL) && stage_snapshot(writer, name, keep, generation, candidate->score, nails, get_generation_length(candidate));
+}
+
+// Next slot after the given one with a job in flight, which may be the same
+// slot, or the slot count if none are left
+static size_t get_next_job(const job_t* jobs, size_t slot_count, size_t slot)
+{
+	for (size_t i = 1; i <= slot_count; ++i)
+	{
+		const size_t next = (slot + i) % slot_count;
+		if (is_job_active(&jobs[next]))
+		{
+			return next;
+		}
+	}
+	return slot_count;
+}
+
+// Fills the slot with the next job on the list that can be prepared, if any
+static void start_next_job(const job_list_t* list, size_t* next_index, const job_settings_t* settings, thread_pool_t* pool, job_t* slot)
+{
+	while (!is_job_active(slot) && (*next_index < list->count))
+	{
+		const size_t index = (*next_index)++;
+		if (create_job(list, index, settings, pool, slot))
+		{
+			printf("Job %d/%d: %s\n", (int)index + 1, (int)list->count, slot->filename);
+		}
+		else
+		{
+			destroy_job(slot);
+		}
+	}
+}
+
+// Layer of the best candidate just scored, before they're sorted
+static size_t get_best_layer(const generation_t* candidates, size_t count)
+{
+	size_t best = 0;
+	for (size_t i = 1; i < count; ++i)
+	{
+		if (candidates[i].score < candidates[best].score)
+		{
+			best = i;
+		}
+	}
+	return best;
+}
+
+// Converts every image on the list a few at a time through one batch
+// renderer. Once a job is scored, the next one is drawn while the first
+// sorts and breeds, so the GPU and CPU each have a job to work on.
+static bool run_jobs
+(
+	graphics_context_t* context,
+	batch_renderer_t* renderer,
+	thread_pool_t* pool,
+	const job_list_t* list,
+	const job_settings_t* settings,
+	size_t snapshot_interval,
+	bool raw
+)
+{
+	const size_t slot_count = settings->slot_count;
+	job_t* jobs = (job_t*)malloc(slot_count * sizeof(job_t));
+	if (jobs == NULL)
+	{
+		printf("Failed to allocate jobs.\n");
+		return false;
+	}
+	for (size_t i = 0; i < slot_count; ++i)
+	{
+		jobs[i] = null_job();
+	}
+
+	// Every job's result goes through the writer, as well as any snapshots
+	snapshot_writer_t writer = null_snapshot_writer();
+	bool success = create_snapshot_writer(APPLICATION_WIDTH, APPLICATION_HEIGHT, raw, &writer);
+	size_t next_index = 0;
+	for (size_t i = 0; success && (i < slot_count); ++i)
+	{
+		start_next_job(list, &next_index, settings, pool, &jobs[i]);
+	}
+
+	// Quitting finishes the jobs in flight as they are, and starts no more
+	bool quit = false;
+	size_t finished_count = 0;
+	size_t slot = get_next_job(jobs, slot_count, slot_count - 1);
+	while (success && (slot < slot_count))
+	{
+		SDL_Event event;
+		while (!quit && SDL_PollEvent(&event))
+		{
+			quit = (event.type == SDL_QUIT);
+		}
+		collect_snapshot(context, &writer, false);
+
+		// Only a job drawn by the last turn is ready to score
+		job_t* job = &jobs[slot];
+		if (!job->rendered && !render_batch(renderer, job->candidates, CANDIDATE_COUNT, job->texture))
+		{
+			success = false;
+			break;
+		}
+		if (!score_batch(renderer, pool, job->candidates, CANDIDATE_COUNT))
+		{
+			success = false;
+			break;
+		}
+		job->rendered = false;
+		++job->generation;
+
+		// Best lines are read back before the next job's replace them
+		const bool finished = quit || is_job_finished(job, settings);
+		if (finished || ((snapshot_interval > 0) && (((size_t)job->generation % snapshot_interval) == 0)))
+		{
+			const size_t best = get_best_layer(job->candidates, CANDIDATE_COUNT);
+			if (!draw_batch_layer(renderer, best, 1, job->texture)
+				|| !start_snapshot(context, &writer, job->name, finished, &job->candidates[best], job->generation))
+			{
+				success = false;
+				break;
+			}
+		}
+
+		job_t* next = &jobs[get_next_job(jobs, slot_count, slot)];
+		if ((next != job) && !next->rendered)
+		{
+			if (!render_batch(renderer, next->candidates, CANDIDATE_COUNT, next->texture))
+			{
+				success = false;
+				break;
+			}
+			next->rendered = true;
+		}
+
+		sort_generations(job->candidates, job->ranks, CANDIDATE_COUNT);
+		if (finished)
+		{
+			const generation_t* best = &job->candidates[0];
+			printf("Job %d/%d finished: Score = %f, Lines = %d, Generations = %d (%.1f s)\n", (int)job->index + 1, (int)list->count, best->score, (int)get_generation_length(best), job->generation, get_job_seconds(job));
+			++finished_count;
+			destroy_job(job);
+			if (!quit)
+			{
+				start_next_job(list, &next_index, settings, pool, job);
+			}
+		}
+		else
+		{
+			if ((job->generation % LOG_FREQUENCY) == 0)
+			{
+				printf("Job %d/%d generation #%d: Score = %f\n", (int)job->index + 1, (int)list->count, job->generation, job->candidates[0].score);
+			}
+			breed_offspring(job->candidates, &job->random, pool);
+		}
+		slot = get_next_job(jobs, slot_count, slot);
+	}
+
+	// Results still being read back or written are waited for
+	collect_snapshot(context, &writer, true);
+	for (size_t i = 0; i < slot_count; ++i)
+	{
+		destroy_job(&jobs[i]);
+	}
+	free(jobs);
+	destroy_snapshot_writer(&writer);
+	printf("Finished %d of %d jobs (CPU time %.1f s).\n", (int)finished_count, (int)list->count, get_cpu_seconds());
+	return success;
+}
+
 int main(int argc, char** argv)
 {
-	const unsigned int seed = (unsigned int)(time(NULL));
-	srand(seed);
+	// Everything below is sized by the settings, so they come first
+	if (!parse_config_arguments(argc, argv, &config) || !validate_config(&config))
+	{
+		pause();
+		return -1;
+	}
+	print_config(&config);
+
+	// Runs with the same seed and settings search identically
+	const unsigned int seed = parse_seed(argc, argv, (unsigned int)(time(NULL)));
+	printf("Seed %u.\n", seed);
+	random_state_t random = seed_random(seed);
 
+	// Workers live for the whole run; the main thread makes up the last one
+	thread_pool_t thread_pool = null_thread_pool();
+	if (!create_thread_pool(get_processor_count(), has_argument(argc, argv, PIN_THREADS_ARGUMENT), &thread_pool))
+	{
+		pause();
+		return -1;
+	}
+
+	// Job list following the argument, or NULL for a single run on the usual
+	// target
+	const char* jobs_filename = find_argument_value(argc, argv, JOBS_ARGUMENT);
+
+	// Load the target before picking a backend; both need it. Jobs load
+	// their own instead.
+	target_t target = null_target();
+	if ((jobs_filename == NULL) && !load_target(TEXTURE_IMAGE_FILENAME, has_argument(argc, argv, SRGB_ARGUMENT), &thread_pool, &target))
+	{
+		printf("Failed to load texture image!\n");
+		destroy_thread_pool(&thread_pool);
+		pause();
+		return -1;
+	}
+
+	// Incremental scoring keeps canvases in system memory, so implies software
+	const bool incremental = has_argument(argc, argv, INCREMENTAL_ARGUMENT);
+	const render_backend_t backend = ((incremental || has_argument(argc, argv, SOFTWARE_BACKEND_ARGUMENT)) ? SOFTWARE_BACKEND : OPENGL_BACKEND);
 	graphics_context_t graphics_context = null_graphics_context();
-	if (!initialize_graphics(&graphics_context))
+	if ((jobs_filename != NULL) && (backend != OPENGL_BACKEND))
+	{
+		printf("Jobs only run on the OpenGL backend.\n");
+		destroy_thread_pool(&thread_pool);
+		pause();
+		return -1;
+	}
+	if ((backend == OPENGL_BACKEND) && !initialize_graphics(&graphics_context, ((jobs_filename == NULL) ? &target : NULL), has_argument(argc, argv, HEADLESS_ARGUMENT)))
 	{
 		destroy_graphics(&graphics_context);
+		destroy_thread_pool(&thread_pool);
+		destroy_target(&target);
+		pause();
+		return -1;
+	}
+
+	// Sum difference images on the GPU and read back one value per candidate;
+	// batches set up their own reduction
+	const bool batched = ((backend == OPENGL_BACKEND) && (has_argument(argc, argv, BATCH_ARGUMENT) || (jobs_filename != NULL)));
+	const bool gpu_reduce = ((backend == OPENGL_BACKEND) && !batched && has_argument(argc, argv, GPU_REDUCE_ARGUMENT));
+	if (gpu_reduce && !create_score_reduction(&graphics_context, CANDIDATE_COUNT))
+	{
+		destroy_graphics(&graphics_context);
+		destroy_thread_pool(&thread_pool);
+		destroy_target(&target);
 		pause();
 		return -1;
 	}
 
 	// Vertices of line points
-	vector2d_t line_vertices[POINT_COUNT];
-#if USE_CIRCLE
-	const float CIRCLE_RADIUS = TEXTURE_HEIGHT * 0.5f;
-	const float PI = 3.1415926f;
-	const float CENTER_X = TEXTURE_WIDTH / 2.f;
-	const float CENTER_Y = TEXTURE_HEIGHT / 2.f;
-	for (size_t i = 0; i < POINT_COUNT; ++i)
-	{
-		const float angle = 2.f * PI * ((float)i / POINT_COUNT);
-		const float x = CENTER_X + (CIRCLE_RADIUS * sinf(angle));
-		const float y = CENTER_Y + (CIRCLE_RADIUS * cosf(angle));
-		line_vertices[i] = vector2d(x, y);
-	}
-#else
-	vector2d_t* current_vertex = line_vertices;
-	for (size_t i = 0; i < SQUARE_SIDE_POINTS; ++i)
-	{
-		const float factor = ((float)i / SQUARE_SIDE_POINTS);
-		const float x = TEXTURE_WIDTH * factor;
-		const float y = TEXTURE_HEIGHT * factor;
-		*current_vertex++ = vector2d(x, 0.f);
-		*current_vertex++ = vector2d(x, TEXTURE_HEIGHT);
-		*current_vertex++ = vector2d(0.f, y);
-		*current_vertex++ = vector2d(TEXTURE_WIDTH, y);
-	}
-#endif
-
-	GLuint line_vertex_buffer;
-	glGenBuffers(1, &line_vertex_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, line_vertex_buffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(line_vertices), line_vertices, GL_STATIC_DRAW);
-
-	// Generate index buffer
-	GLuint line_index_buffer;
-	glGenBuffers(1, &line_index_buffer);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, line_index_buffer);
-
-	// Candidates with line points
-	generation_t candidates[CANDIDATE_COUNT];
+	vector2d_t* line_vertices = (vector2d_t*)malloc(POINT_COUNT * sizeof(vector2d_t));
+	if (line_vertices == NULL)
+	{
+		printf("Failed to allocate line vertices.\n");
+		destroy_graphics(&graphics_context);
+		destroy_thread_pool(&thread_pool);
+		destroy_target(&target);
+		pause();
+		return -1;
+	}
+	place_nails(line_vertices);
+
+	// The greedy walk scores chords incrementally in software, whichever
+	// backend is used
+	const bool greedy = ((jobs_filename == NULL) && has_argument(argc, argv, GREEDY_ARGUMENT));
+	const bool huge_pages = has_argument(argc, argv, HUGE_PAGES_ARGUMENT);
+	software_renderer_t software_renderer = null_software_renderer();
+	if (((backend == SOFTWARE_BACKEND) || greedy) && !create_software_renderer(line_vertices, POINT_COUNT, &target.levels[0], (incremental || greedy), huge_pages, &thread_pool, &software_renderer))
+	{
+		destroy_software_renderer(&software_renderer);
+		free(line_vertices);
+		destroy_graphics(&graphics_context);
+		destroy_thread_pool(&thread_pool);
+		destroy_target(&target);
+		pause();
+		return -1;
+	}
+
+	// Every candidate rendered and scored together, in its own layer
+	batch_renderer_t batch_renderer = null_batch_renderer();
+	if (batched && !create_batch_renderer(line_vertices, POINT_COUNT, CANDIDATE_COUNT, has_argument(argc, argv, GPU_REDUCE_ARGUMENT), &batch_renderer))
+	{
+		destroy_batch_renderer(&batch_renderer);
+		free(line_vertices);
+		destroy_graphics(&graphics_context);
+		destroy_thread_pool(&thread_pool);
+		destroy_target(&target);
+		pause();
+		return -1;
+	}
+
+	// Queued images share everything set up so far, taking turns with it
+	if (jobs_filename != NULL)
+	{
+		job_settings_t settings;
+		settings.slot_count = parse_count(argc, argv, JOB_SLOTS_ARGUMENT, JOB_SLOTS);
+		settings.generations = parse_count(argc, argv, JOB_GENERATIONS_ARGUMENT, JOB_GENERATIONS);
+		settings.seconds = (double)parse_count(argc, argv, JOB_SECONDS_ARGUMENT, 0);
+		settings.srgb = has_argument(argc, argv, SRGB_ARGUMENT);
+		settings.huge_pages = huge_pages;
+		settings.seed = seed;
+		job_list_t job_list = null_job_list();
+		const bool ran = load_job_list(jobs_filename, &job_list)
+			&& run_jobs(&graphics_context, &batch_renderer, &thread_pool, &job_list, &settings, parse_count(argc, argv, SNAPSHOT_INTERVAL_ARGUMENT, 0), has_argument(argc, argv, SNAPSHOT_RAW_ARGUMENT));
+		destroy_job_list(&job_list);
+		destroy_batch_renderer(&batch_renderer);
+		free(line_vertices);
+		destroy_graphics(&graphics_context);
+		destroy_thread_pool(&thread_pool);
+		destroy_target(&target);
+		return (ran ? 0 : -1);
+	}
+
+	// Candidates with line points, their ranks while sorting, and their
+	// scores when reduced on the GPU
+	arena_t population_arena = null_arena();
+	const size_t population_size = ALIGN_ARENA(CANDIDATE_COUNT * sizeof(generation_t))
+		+ ALIGN_ARENA(CANDIDATE_COUNT * sizeof(generation_rank_t))
+		+ ALIGN_ARENA(CANDIDATE_COUNT * sizeof(double));
+	if (!create_arena(population_size, huge_pages, &population_arena))
+	{
+		printf("Failed to allocate candidates.\n");
+		destroy_batch_renderer(&batch_renderer);
+		destroy_software_renderer(&software_renderer);
+		free(line_vertices);
+		destroy_graphics(&graphics_context);
+		destroy_thread_pool(&thread_pool);
+		destroy_target(&target);
+		pause();
+		return -1;
+	}
+	generation_t* candidates = (generation_t*)allocate_arena(&population_arena, CANDIDATE_COUNT * sizeof(generation_t));
+	generation_rank_t* ranks = (generation_rank_t*)allocate_arena(&population_arena, CANDIDATE_COUNT * sizeof(generation_rank_t));
+	double* scores = (double*)allocate_arena(&population_arena, CANDIDATE_COUNT * sizeof(double));
 	for (size_t i = 0; i < CANDIDATE_COUNT; ++i)
 	{
-		candidates[i] = create_generation();
+		candidates[i] = create_generation(&random);
+		candidates[i].parent_slot = i;
+	}
+
+	// Start the genetic search from the greedy walk instead of single chords
+	if (greedy)
+	{
+		if (!seed_from_greedy(&software_renderer, candidates, CANDIDATE_COUNT, &random))
+		{
+			printf("Failed to run greedy solver.\n");
+		}
+		if (backend != SOFTWARE_BACKEND)
+		{
+			destroy_software_renderer(&software_renderer);
+		}
+	}
+
+	// Checkpoints are taken after sorting, before offspring are drawn; the
+	// journal and replay cover the GL population only
+	const bool resume = has_argument(argc, argv, RESUME_ARGUMENT);
+	const size_t replay_generation = ((backend == OPENGL_BACKEND) ? parse_count(argc, argv, REPLAY_ARGUMENT, 0) : 0);
+	const bool checkpointing = (resume || (replay_generation > 0) || has_argument(argc, argv, CHECKPOINT_ARGUMENT));
+	if (checkpointing)
+	{
+		install_stop_handlers();
+	}
+
+	// Software populations run as islands; one behaves as a single population
+	if (backend == SOFTWARE_BACKEND)
+	{
+		const size_t island_count = parse_count(argc, argv, ISLANDS_ARGUMENT, 1);
+		const size_t migration_interval = parse_count(argc, argv, MIGRATION_INTERVAL_ARGUMENT, MIGRATION_INTERVAL);
+		run_islands(&software_renderer, (greedy ? &candidates[0] : NULL), island_count, migration_interval, incremental, checkpointing, resume, seed);
+	}
+
+	int generation = 0;
+	population_t population;
+	population.candidates = candidates;
+	population.random = &random;
+	population.generation = &generation;
+	checkpoint_writer_t checkpoint_writer = null_checkpoint_writer();
+	if (backend == OPENGL_BACKEND)
+	{
+		bool restored = true;
+		if (resume || (replay_generation > 0))
+		{
+			restored = restore_population(&population, replay_generation);
+		}
+		if (!restored || (checkpointing && !create_checkpoint_writer(CHECKPOINT_FILENAME, JOURNAL_FILENAME, seed, &population, &checkpoint_writer)))
+		{
+			destroy_checkpoint_writer(&checkpoint_writer);
+			for (size_t i = 0; i < CANDIDATE_COUNT; ++i)
+			{
+				destroy_generation(&candidates[i]);
+			}
+			destroy_arena(&population_arena);
+			destroy_batch_renderer(&batch_renderer);
+			free(line_vertices);
+			destroy_graphics(&graphics_context);
+			destroy_thread_pool(&thread_pool);
+			destroy_target(&target);
+			pause();
+			return -1;
+		}
+		if (resume || (replay_generation > 0))
+		{
+			breed_offspring(candidates, &random, &thread_pool);
+		}
 	}
 
-	// Create triangle buffer
+	// Screen quad for the texture pass
 	const vector2d_t vertices[] =
 	{
 		vector2d(-1.f, 1.f), vector2d(0.f, 0.f),
@@ -72,26 +667,78 @@ int main(int argc, char** argv)
 		vector2d(1.f, -1.f), vector2d(1.f, 1.f),
 		vector2d(-1.f, -1.f), vector2d(0.f, 1.f)
 	};
-	GLuint vertex_buffer;
-	glGenBuffers(1, &vertex_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-	// Create index buffer
 	const GLuint indices[] =
 	{
 		0, 1, 3,
 		1, 2, 3
 	};
-	GLuint index_buffer;
-	glGenBuffers(1, &index_buffer);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-	
+
+	GLuint line_vertex_buffer = INVALID_BUFFER;
+	GLuint line_index_buffer = INVALID_BUFFER;
+	GLuint vertex_buffer = INVALID_BUFFER;
+	GLuint index_buffer = INVALID_BUFFER;
+	GLuint line_vertex_array = INVALID_VERTEX_ARRAY;
+	GLuint quad_vertex_array = INVALID_VERTEX_ARRAY;
+	if (backend == OPENGL_BACKEND)
+	{
+		glGenBuffers(1, &line_vertex_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, line_vertex_buffer);
+		glBufferData(GL_ARRAY_BUFFER, POINT_COUNT * sizeof(vector2d_t), line_vertices, GL_STATIC_DRAW);
+
+		// Generate index buffer
+		glGenBuffers(1, &line_index_buffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, line_index_buffer);
+
+		// Create triangle buffer
+		glGenBuffers(1, &vertex_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+		// Create index buffer
+		glGenBuffers(1, &index_buffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+		// Each draw then binds its buffers and attribute layout at once
+		if (!create_vertex_array(LINE_MATERIAL, line_vertex_buffer, line_index_buffer, &line_vertex_array)
+			|| !create_vertex_array(TEXTURE_MATERIAL, vertex_buffer, index_buffer, &quad_vertex_array))
+		{
+			destroy_graphics(&graphics_context);
+			pause();
+			return -1;
+		}
+	}
+
+	// Stage timings of the GL loop
+	profiler_t profiler = null_profiler();
+	const char* profile_filename = find_argument_value(argc, argv, PROFILE_OUTPUT_ARGUMENT);
+	if ((backend == OPENGL_BACKEND) && has_argument(argc, argv, PROFILE_ARGUMENT)
+		&& create_profiler((profile_filename != NULL ? profile_filename : PROFILE_FILENAME), true, &profiler))
+	{
+		batch_renderer.profiler = &profiler;
+	}
+
+	// Candidates scored on the CPU may be screened at a coarser resolution
+	resolution_schedule_t schedule = create_resolution_schedule(parse_count(argc, argv, COARSE_ARGUMENT, 1), has_argument(argc, argv, REFINE_ARGUMENT));
+	if ((schedule.factor > 1) && (batched || gpu_reduce))
+	{
+		printf("Coarse scoring only applies to scores read back to the CPU.\n");
+	}
+
+	// Best candidate written out every so many generations, off the GL thread
+	const size_t snapshot_interval = ((backend == OPENGL_BACKEND) ? parse_count(argc, argv, SNAPSHOT_INTERVAL_ARGUMENT, 0) : 0);
+	snapshot_writer_t snapshot_writer = null_snapshot_writer();
+	if ((snapshot_interval > 0) && !create_snapshot_writer(APPLICATION_WIDTH, APPLICATION_HEIGHT, has_argument(argc, argv, SNAPSHOT_RAW_ARGUMENT), &snapshot_writer))
+	{
+		destroy_snapshot_writer(&snapshot_writer);
+		destroy_graphics(&graphics_context);
+		pause();
+		return -1;
+	}
+
 	// Feed indices
-	int generation = 0;
 	GLint render_mode = 0;
-	bool finished = false;
+	bool finished = (backend != OPENGL_BACKEND);
 	while (!finished)
 	{
 		SDL_Event event;
@@ -122,130 +769,166 @@ int main(int argc, char** argv)
 
 		if ((generation++ % LOG_FREQUENCY) == 0)
 		{
-			printf("Generation #%d:\n", generation);
-			for (size_t i = 0; i < FITTEST_COUNT; ++i)
+			printf("Generation #%d (CPU time %.1f s):\n", generation, get_cpu_seconds());
+			for (size_t i = 0; i < (size_t)FITTEST_COUNT; ++i)
 			{
 				const generation_t* candidate = &candidates[i];
-				printf("#%d: Score = %f, Lines = %d\n", (int)i + 1, candidate->score, (int)candidate->index_count);
+				printf("#%d: Score = %f, Lines = %d\n", (int)i + 1, candidate->score, (int)get_generation_length(candidate));
 			}
 			printf("\n");
 		}
 
-		for (size_t i = 0; i < CANDIDATE_COUNT; ++i)
+		// Last snapshot's copy is usually done by the next generation
+		const bool snapshotting = (snapshot_interval > 0) && (((size_t)generation % snapshot_interval) == 0);
+		if (snapshot_interval > 0)
+		{
+			collect_snapshot(&graphics_context, &snapshot_writer, false);
+		}
+
+		// Whole generation in a fixed number of draws; best is shown first so
+		// the readback has something to overlap with
+		if (batched)
 		{
-			generation_t* candidate = &candidates[i];
-			const size_t line_index_count = candidate->index_count;
-			const GLuint* line_indices = candidate->indices;
-			const GLsizei line_indices_size = line_index_count * sizeof(GLuint);
-			glBindBuffer(GL_ARRAY_BUFFER, line_vertex_buffer);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, line_index_buffer);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, line_indices_size, line_indices, GL_DYNAMIC_DRAW);
-
-			// Set parameters
-			if (!activate_material(&graphics_context.line_material, LINE_MATERIAL))
+			if (!render_batch(&batch_renderer, candidates, CANDIDATE_COUNT, graphics_context.texture_image))
 			{
-				printf("Failed to activate line material.\n");
-				destroy_graphics(&graphics_context);
-				return -1;
+				break;
 			}
-			if (!set_projection(&graphics_context.line_material, TEXTURE_WIDTH, TEXTURE_HEIGHT))
+			if (snapshotting
+				&& (!draw_batch_layer(&batch_renderer, 0, 1, graphics_context.texture_image)
+					|| !start_snapshot(&graphics_context, &snapshot_writer, SNAPSHOT_NAME, false, &candidates[0], generation)))
 			{
-				pause();
-				destroy_graphics(&graphics_context);
-				return -1;
+				break;
 			}
-
-			// Draw to texture first
-			glBindFramebuffer(GL_FRAMEBUFFER, graphics_context.frame_buffer);
-			glViewport(0, 0, TEXTURE_WIDTH, TEXTURE_HEIGHT);
-			glClear(GL_COLOR_BUFFER_BIT);
-
-			// Draw the quad
-			glDrawElements
-			(
-				GL_LINE_STRIP,
-				line_index_count,
-				GL_UNSIGNED_INT,
-				NULL
-			);
-
-			// Set main buffer back
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
-			glViewport(0, 0, APPLICATION_WIDTH, APPLICATION_HEIGHT);
-
-			// Bind vertex and index buffer back
-			glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
-
-			// Now draw that texture on screen
-			if (!activate_material(&graphics_context.texture_material, TEXTURE_MATERIAL))
+			if (!graphics_context.headless)
 			{
-				printf("Failed to activate texture material!\n");
-				destroy_graphics(&graphics_context);
-				pause();
-				return -1;
+				if (!draw_batch_layer(&batch_renderer, 0, render_mode, graphics_context.texture_image))
+				{
+					break;
+				}
+				present_frame(&graphics_context);
 			}
-
-			if (!set_texture(&graphics_context.texture_material, graphics_context.texture_target, graphics_context.texture_image))
+			if (!score_batch(&batch_renderer, &thread_pool, candidates, CANDIDATE_COUNT))
 			{
-				pause();
-				destroy_graphics(&graphics_context);
-				return -1;
+				break;
 			}
+		}
 
-			// Draw the quad
-			if (!set_mode(&graphics_context.texture_material, 0))
+		// Everyone is scored at the coarse resolution first, if there is one,
+		// and only the most promising again at full resolution
+		const size_t coarse_factor = (gpu_reduce ? 1 : schedule.factor);
+		bool evaluated = true;
+		for (int pass = (coarse_factor > 1 ? 0 : 1); (pass < 2) && !batched && evaluated; ++pass)
+		{
+			const bool coarse = (pass == 0);
+			const GLsizei output_width = (coarse ? (GLsizei)get_coarse_width(&schedule) : APPLICATION_WIDTH);
+			const GLsizei output_height = (coarse ? (GLsizei)get_coarse_height(&schedule) : APPLICATION_HEIGHT);
+			const size_t output_pixel_count = (size_t)output_width * (size_t)output_height;
+			const GLuint target_texture = (coarse ? graphics_context.texture_pyramid : graphics_context.texture_image);
+			size_t evaluated_count = CANDIDATE_COUNT;
+			if (!coarse && (coarse_factor > 1))
 			{
-				destroy_graphics(&graphics_context);
-				pause();
-				return -1;
+				// Survivors are always rescored, so the best is never lost to a
+				// coarse score; the offspring's pick who joins them, and the
+				// rest rank after them
+				const profile_span_t span = begin_cpu_span(&profiler, PROFILE_SORT);
+				sort_generations(candidates + FITTEST_COUNT, ranks, CANDIDATE_COUNT - (size_t)FITTEST_COUNT);
+				end_span(&profiler, span);
+				evaluated_count = get_promoted_count();
+				for (size_t i = evaluated_count; i < CANDIDATE_COUNT; ++i)
+				{
+					candidates[i].score = DBL_MAX;
+				}
 			}
 
-			if (!set_sample_radius(&graphics_context.texture_material, (float)SAMPLE_RADIUS / (float)TEXTURE_WIDTH))
-			{
-				destroy_graphics(&graphics_context);
-				pause();
-				return -1;
-			}
+			// Offspring stop being summed once they're worse than every
+			// survivor, unless a coarse pass may have passed over survivors
+			set_score_cutoffs(candidates, evaluated_count, (coarse_factor == 1));
 
-			GLsizei quad_index_count = sizeof(indices) / sizeof(GLuint);
-			glDrawElements
-			(
-				GL_TRIANGLES,
-				quad_index_count,
-				GL_UNSIGNED_INT,
-				NULL
-			);
-
-			// Read buffer and start compute job
-			GLfloat* score_buffer = candidate->score_buffer;
-			glReadPixels(0, 0, APPLICATION_WIDTH, APPLICATION_HEIGHT, GL_RED, GL_FLOAT, score_buffer);
-			if (i != LAST_CANDIDATE)
+			task_group_t readback_groups[READBACK_BUFFER_COUNT];
+			for (size_t i = 0; i < READBACK_BUFFER_COUNT; ++i)
 			{
-				start_score_thread(candidate);
+				readback_groups[i] = null_task_group();
 			}
-			else
+
+			for (size_t i = 0; i < evaluated_count; ++i)
 			{
-				// Compute our score on main thread
-				compute_score(candidate);
+				generation_t* candidate = &candidates[i];
+				const nail_t* line_indices = get_generation_nails(candidate);
+				if (line_indices == NULL)
+				{
+					printf("Failed to export candidate nails.\n");
+					destroy_graphics(&graphics_context);
+					return -1;
+				}
+				const size_t line_index_count = get_generation_length(candidate);
+				const GLsizei line_indices_size = line_index_count * sizeof(nail_t);
 
-				// Now wait for others
-				for (size_t j = 0; j < LAST_CANDIDATE; ++j)
+				// The line array holds the index buffer the upload goes to
+				profile_span_t span = begin_span(&profiler, PROFILE_UPLOAD);
+				activate_material(&graphics_context.line_material, line_vertex_array);
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, line_indices_size, line_indices, GL_DYNAMIC_DRAW);
+				end_span(&profiler, span);
+
+				// Set parameters
+				span = begin_span(&profiler, PROFILE_LINES);
+				if (!set_projection(&graphics_context.line_material, TEXTURE_WIDTH, TEXTURE_HEIGHT))
 				{
-					generation_t* other = &candidates[j];
-					join_score_thread(other);
+					pause();
+					destroy_graphics(&graphics_context);
+					return -1;
 				}
-			}
 
-			// Draw best
-			if (i == 0)
-			{
-				if (!set_mode(&graphics_context.texture_material, render_mode))
+				// Draw to texture first
+				glBindFramebuffer(GL_FRAMEBUFFER, graphics_context.frame_buffer);
+				glViewport(0, 0, TEXTURE_WIDTH, TEXTURE_HEIGHT);
+				glClear(GL_COLOR_BUFFER_BIT);
+
+				// Draw the quad
+				glDrawElements
+				(
+					GL_LINE_STRIP,
+					line_index_count,
+					NAIL_INDEX_TYPE,
+					NULL
+				);
+
+				end_span(&profiler, span);
+
+				// Blur across into the blur target, then down it as the
+				// difference is taken, at the size being scored
+				span = begin_span(&profiler, PROFILE_BLUR);
+				const GLsizei quad_index_count = sizeof(indices) / sizeof(GLuint);
+				if (!blur_lines(&graphics_context, quad_vertex_array, quad_index_count, output_width, output_height))
+				{
+					destroy_graphics(&graphics_context);
+					pause();
+					return -1;
+				}
+				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+				glViewport(0, 0, output_width, output_height);
+				activate_material(&graphics_context.texture_material, quad_vertex_array);
+				if (!set_texture(&graphics_context.texture_material, graphics_context.blur_texture, target_texture)
+					|| !set_blur_kernel(&graphics_context.texture_material, &graphics_context.blur_down))
+				{
+					pause();
+					destroy_graphics(&graphics_context);
+					return -1;
+				}
+
+				// Draw the quad
+				if (!set_mode(&graphics_context.texture_material, 0))
 				{
 					destroy_graphics(&graphics_context);
 					pause();
 					return -1;
 				}
+
+				// Difference goes to a float target when it's summed on the GPU
+				if (gpu_reduce)
+				{
+					glBindFramebuffer(GL_FRAMEBUFFER, graphics_context.score_frame_buffer);
+				}
+
 				glDrawElements
 				(
 					GL_TRIANGLES,
@@ -253,23 +936,164 @@ int main(int argc, char** argv)
 					GL_UNSIGNED_INT,
 					NULL
 				);
-				SDL_GL_SwapWindow(graphics_context.window);
+				end_span(&profiler, span);
+
+				// Read back without waiting, and score the oldest readback in flight
+				if (!gpu_reduce)
+				{
+					const size_t slot = i % READBACK_BUFFER_COUNT;
+					span = begin_span(&profiler, PROFILE_READBACK);
+					wait_task_group(&thread_pool, &readback_groups[slot]);
+					unmap_readback(&graphics_context, slot);
+					start_readback(&graphics_context, slot, output_width, output_height);
+					end_span(&profiler, span);
+					if (i >= READBACK_LATENCY)
+					{
+						const size_t scored = i - READBACK_LATENCY;
+						span = begin_cpu_span(&profiler, PROFILE_SCORE);
+						if (!score_readback(&graphics_context, &thread_pool, readback_groups, &candidates[scored], scored % READBACK_BUFFER_COUNT, output_pixel_count))
+						{
+							destroy_graphics(&graphics_context);
+							pause();
+							return -1;
+						}
+						end_span(&profiler, span);
+					}
+				}
+
+				// Draw best, at full size, if there's a window or snapshot for it
+				if ((i == 0) && !coarse && (snapshotting || !graphics_context.headless))
+				{
+					glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+					// Snapshots are of the lines alone, whatever is shown
+					if (snapshotting)
+					{
+						if (!set_mode(&graphics_context.texture_material, 1))
+						{
+							destroy_graphics(&graphics_context);
+							pause();
+							return -1;
+						}
+						glDrawElements
+						(
+							GL_TRIANGLES,
+							quad_index_count,
+							GL_UNSIGNED_INT,
+							NULL
+						);
+						if (!start_snapshot(&graphics_context, &snapshot_writer, SNAPSHOT_NAME, false, candidate, generation))
+						{
+							destroy_graphics(&graphics_context);
+							pause();
+							return -1;
+						}
+					}
+					if (!graphics_context.headless)
+					{
+						if (!set_mode(&graphics_context.texture_material, render_mode))
+						{
+							destroy_graphics(&graphics_context);
+							pause();
+							return -1;
+						}
+						glDrawElements
+						(
+							GL_TRIANGLES,
+							quad_index_count,
+							GL_UNSIGNED_INT,
+							NULL
+						);
+						present_frame(&graphics_context);
+					}
+				}
+
+				if (gpu_reduce)
+				{
+					span = begin_span(&profiler, PROFILE_SCORE);
+					if (!reduce_score(&graphics_context, i, quad_vertex_array, quad_index_count))
+					{
+						destroy_graphics(&graphics_context);
+						pause();
+						return -1;
+					}
+					end_span(&profiler, span);
+				}
+			}
+
+			// Score the readbacks still in flight; main thread helps with the sums
+			if (!gpu_reduce)
+			{
+				const profile_span_t span = begin_cpu_span(&profiler, PROFILE_SCORE);
+				const size_t first_unscored = (evaluated_count > READBACK_LATENCY ? evaluated_count - READBACK_LATENCY : 0);
+				bool scored = true;
+				for (size_t i = first_unscored; scored && (i < evaluated_count); ++i)
+				{
+					scored = score_readback(&graphics_context, &thread_pool, readback_groups, &candidates[i], i % READBACK_BUFFER_COUNT, output_pixel_count);
+				}
+				for (size_t i = 0; i < READBACK_BUFFER_COUNT; ++i)
+				{
+					wait_task_group(&thread_pool, &readback_groups[i]);
+					unmap_readback(&graphics_context, i);
+				}
+				for (size_t i = 0; i < evaluated_count; ++i)
+				{
+					candidates[i].score_pixels = NULL;
+				}
+				end_span(&profiler, span);
+				if (!scored)
+				{
+					evaluated = false;
+				}
+			}
+		}
+		if (!evaluated)
+		{
+			break;
+		}
+		if (gpu_reduce)
+		{
+			const profile_span_t span = begin_span(&profiler, PROFILE_READBACK);
+			const bool read = read_scores(&graphics_context, scores, CANDIDATE_COUNT);
+			end_span(&profiler, span);
+			if (!read)
+			{
+				break;
+			}
+			for (size_t i = 0; i < CANDIDATE_COUNT; ++i)
+			{
+				candidates[i].score = scores[i];
 			}
 		}
 
 		// Now sort the candidates by score
-		qsort(&candidates, CANDIDATE_COUNT, sizeof(generation_t), &compare_generations);
+		profile_span_t span = begin_cpu_span(&profiler, PROFILE_SORT);
+		sort_generations(candidates, ranks, CANDIDATE_COUNT);
+		end_span(&profiler, span);
+		if (update_resolution_schedule(&schedule, generation, candidates[0].score))
+		{
+			printf("Coarse scoring now at 1/%u resolution.\n", (unsigned int)schedule.factor);
+		}
 
-		// Generate off-spring for the best ones
-		generation_t* current_offspring = &candidates[FITTEST_COUNT];
-		for (size_t i = 0; i < FITTEST_COUNT; ++i)
+		// A stop request ends the run on a final checkpoint
+		if (checkpointing)
 		{
-			const generation_t* fittest = &candidates[i];
-			for (size_t j = 0; j < OFFSPRING_PER_FITTEST; ++j, ++current_offspring)
+			finished = finished || is_stop_requested();
+			if (!record_population(&checkpoint_writer, &population, finished))
 			{
-				mutate_generation(fittest, current_offspring);
+				break;
 			}
 		}
+
+		// Generate off-spring for the best ones
+		span = begin_cpu_span(&profiler, PROFILE_MUTATE);
+		breed_offspring(candidates, &random, &thread_pool);
+		end_span(&profiler, span);
+		if (!end_profile_generation(&profiler, generation))
+		{
+			printf("Failed to write profile.\n");
+			break;
+		}
 	}
 	
 	// Shutdown
@@ -278,6 +1102,18 @@ int main(int argc, char** argv)
 		generation_t* candidate = &candidates[i];
 		destroy_generation(candidate);
 	}
+	destroy_profiler(&profiler);
+	collect_snapshot(&graphics_context, &snapshot_writer, true);
+	destroy_snapshot_writer(&snapshot_writer);
+	destroy_checkpoint_writer(&checkpoint_writer);
+	destroy_arena(&population_arena);
+	destroy_software_renderer(&software_renderer);
+	destroy_batch_renderer(&batch_renderer);
+	destroy_vertex_array(&line_vertex_array);
+	destroy_vertex_array(&quad_vertex_array);
+	free(line_vertices);
 	destroy_graphics(&graphics_context);
+	destroy_thread_pool(&thread_pool);
+	destroy_target(&target);
 	return 0;
 }
@@ -3,8 +3,10 @@
 #include "matrix3d.h"
 #include "vector2d.h"
 
+#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define POSITION_ATTRIBUTE_NAME "in_position"
 #define UV_ATTRIBUTE_NAME "in_uv"
@@ -12,14 +14,70 @@
 #define LINE_TEXTURE_SAMPLER_NAME "line_texture"
 #define IMAGE_TEXTURE_SAMPLER_NAME "image_texture"
 #define MODE_NAME "mode"
-#define SAMPLE_RADIUS_NAME "sample_radius"
+#define SOURCE_TEXTURE_SAMPLER_NAME "source_texture"
+#define SOURCE_SIZE_NAME "source_size"
+#define OUTPUT_OFFSET_NAME "output_offset"
+#define START_ATTRIBUTE_NAME "in_start"
+#define END_ATTRIBUTE_NAME "in_end"
+#define LAYER_ATTRIBUTE_NAME "in_layer"
+#define CANVAS_SIZE_NAME "canvas_size"
+#define LINE_REACH_NAME "line_reach"
+#define LAYER_OFFSET_NAME "layer_offset"
+#define BLUR_SCALE_NAME "blur_scale"
+#define BLUR_OFFSETS_NAME "blur_offsets"
+#define BLUR_WEIGHTS_NAME "blur_weights"
+
+// Attribute locations every program is linked with; no program uses both a
+// point and a chord layout
+#define POSITION_LOCATION 0
+#define UV_LOCATION 1
+#define START_LOCATION 0
+#define END_LOCATION 1
+#define LAYER_LOCATION 2
+
+// Texture units the samplers are pointed at
+#define LINE_TEXTURE_UNIT 0
+#define IMAGE_TEXTURE_UNIT 1
+#define SOURCE_TEXTURE_UNIT 0
+
+// Uniforms with a value in material_uniforms_t
+#define PROJECTION_UNIFORM (1u << 0)
+#define MODE_UNIFORM (1u << 1)
+#define SOURCE_SIZE_UNIFORM (1u << 2)
+#define OUTPUT_OFFSET_UNIFORM (1u << 3)
+#define CANVAS_SIZE_UNIFORM (1u << 4)
+#define LINE_REACH_UNIFORM (1u << 5)
+#define LAYER_OFFSET_UNIFORM (1u << 6)
+#define BLUR_KERNEL_UNIFORM (1u << 7)
+
+// Program and vertex array last bound; everything binding them goes through
+// here, and there's only ever the one context
+static GLuint bound_program = INVALID_PROGRAM;
+static GLuint bound_vertex_array = INVALID_VERTEX_ARRAY;
 
 material_t null_material()
 {
 	material_t material;
 	material.vertex_shader = INVALID_SHADER;
+	material.geometry_shader = INVALID_SHADER;
 	material.fragment_shader = INVALID_SHADER;
 	material.program = INVALID_PROGRAM;
+	material.type = LINE_MATERIAL;
+	material.projection_location = INVALID_LOCATION;
+	material.line_texture_location = INVALID_LOCATION;
+	material.image_texture_location = INVALID_LOCATION;
+	material.mode_location = INVALID_LOCATION;
+	material.source_texture_location = INVALID_LOCATION;
+	material.source_size_location = INVALID_LOCATION;
+	material.output_offset_location = INVALID_LOCATION;
+	material.canvas_size_location = INVALID_LOCATION;
+	material.line_reach_location = INVALID_LOCATION;
+	material.layer_offset_location = INVALID_LOCATION;
+	material.blur_scale_location = INVALID_LOCATION;
+	material.blur_offsets_location = INVALID_LOCATION;
+	material.blur_weights_location = INVALID_LOCATION;
+	const material_uniforms_t uniforms = { 0 };
+	material.uniforms = uniforms;
 	return material;
 }
 
@@ -76,7 +134,18 @@ bool create_program(material_t* out)
 		return false;
 	}
 	glAttachShader(program, out->vertex_shader);
+	if (out->geometry_shader != INVALID_SHADER)
+	{
+		glAttachShader(program, out->geometry_shader);
+	}
 	glAttachShader(program, out->fragment_shader);
+
+	// Fixed locations let materials with the same layout share vertex arrays
+	glBindAttribLocation(program, POSITION_LOCATION, POSITION_ATTRIBUTE_NAME);
+	glBindAttribLocation(program, UV_LOCATION, UV_ATTRIBUTE_NAME);
+	glBindAttribLocation(program, START_LOCATION, START_ATTRIBUTE_NAME);
+	glBindAttribLocation(program, END_LOCATION, END_ATTRIBUTE_NAME);
+	glBindAttribLocation(program, LAYER_LOCATION, LAYER_ATTRIBUTE_NAME);
 	glLinkProgram(program);
 
 	// Check link status
@@ -101,57 +170,141 @@ bool create_program(material_t* out)
 	return true;
 }
 
-bool set_line_shader_parameters(material_t* material)
+static void use_program(GLuint program)
 {
-	const GLuint program = material->program;
-	const GLint position_index = glGetAttribLocation(program, POSITION_ATTRIBUTE_NAME);
-	if (position_index == INVALID_LOCATION)
+	if (program != bound_program)
 	{
-		printf("Failed to find attribute '%s' in shader.\n", POSITION_ATTRIBUTE_NAME);
-		return false;
+		glUseProgram(program);
+		bound_program = program;
+	}
+}
+
+static void bind_vertex_array(GLuint vertex_array)
+{
+	if (vertex_array != bound_vertex_array)
+	{
+		glBindVertexArray(vertex_array);
+		bound_vertex_array = vertex_array;
 	}
+}
 
-	const GLsizei position_size = sizeof(vector2d_t);
-	const GLsizei vertex_size = position_size;
-	const GLint position_floats = (GLint)(vertex_size / sizeof(float));
-	glEnableVertexAttribArray(position_index);
-	glVertexAttribPointer(position_index, position_floats, GL_FLOAT, GL_FALSE, vertex_size, NULL);
+static bool find_attribute(GLuint program, const char* name)
+{
+	if (glGetAttribLocation(program, name) == INVALID_LOCATION)
+	{
+		printf("Failed to find attribute '%s' in shader.\n", name);
+		return false;
+	}
 	return true;
 }
 
-bool set_texture_shader_parameters(material_t* material)
+// Checks the program has the attributes its type's layout feeds
+static bool find_attributes(const material_t* material)
 {
 	const GLuint program = material->program;
-	const GLint position_index = glGetAttribLocation(program, POSITION_ATTRIBUTE_NAME);
-	if (position_index == INVALID_LOCATION)
+	switch (material->type)
 	{
-		printf("Failed to find attribute '%s' in shader.\n", POSITION_ATTRIBUTE_NAME);
+	case LINE_MATERIAL:
+	case REDUCE_MATERIAL:
+	case BLUR_MATERIAL:
+		return find_attribute(program, POSITION_ATTRIBUTE_NAME);
+
+	case TEXTURE_MATERIAL:
+		return find_attribute(program, POSITION_ATTRIBUTE_NAME)
+			&& find_attribute(program, UV_ATTRIBUTE_NAME);
+
+	case BATCH_LINE_MATERIAL:
+		return find_attribute(program, START_ATTRIBUTE_NAME)
+			&& find_attribute(program, END_ATTRIBUTE_NAME)
+			&& find_attribute(program, LAYER_ATTRIBUTE_NAME);
+
+	// Full screen quads are generated from the vertex index
+	case BATCH_QUAD_MATERIAL:
+		return true;
+
+	default:
+		printf("Invalid material type specified!\n");
 		return false;
 	}
+}
 
-	const GLint uv_index = glGetAttribLocation(program, UV_ATTRIBUTE_NAME);
-	if (uv_index == INVALID_LOCATION)
+// Looks up every uniform once and points the samplers at their units
+static void find_uniforms(material_t* material)
+{
+	const GLuint program = material->program;
+	material->projection_location = glGetUniformLocation(program, PROJECTION_MATRIX_NAME);
+	material->line_texture_location = glGetUniformLocation(program, LINE_TEXTURE_SAMPLER_NAME);
+	material->image_texture_location = glGetUniformLocation(program, IMAGE_TEXTURE_SAMPLER_NAME);
+	material->mode_location = glGetUniformLocation(program, MODE_NAME);
+	material->source_texture_location = glGetUniformLocation(program, SOURCE_TEXTURE_SAMPLER_NAME);
+	material->source_size_location = glGetUniformLocation(program, SOURCE_SIZE_NAME);
+	material->output_offset_location = glGetUniformLocation(program, OUTPUT_OFFSET_NAME);
+	material->canvas_size_location = glGetUniformLocation(program, CANVAS_SIZE_NAME);
+	material->line_reach_location = glGetUniformLocation(program, LINE_REACH_NAME);
+	material->layer_offset_location = glGetUniformLocation(program, LAYER_OFFSET_NAME);
+	material->blur_scale_location = glGetUniformLocation(program, BLUR_SCALE_NAME);
+	material->blur_offsets_location = glGetUniformLocation(program, BLUR_OFFSETS_NAME);
+	material->blur_weights_location = glGetUniformLocation(program, BLUR_WEIGHTS_NAME);
+	material->uniforms.set = 0;
+
+	use_program(program);
+	if (material->line_texture_location != INVALID_LOCATION)
+	{
+		glUniform1i(material->line_texture_location, LINE_TEXTURE_UNIT);
+	}
+	if (material->image_texture_location != INVALID_LOCATION)
+	{
+		glUniform1i(material->image_texture_location, IMAGE_TEXTURE_UNIT);
+	}
+	if (material->source_texture_location != INVALID_LOCATION)
 	{
-		printf("Failed to find attribute '%s' in shader.\n", UV_ATTRIBUTE_NAME);
+		glUniform1i(material->source_texture_location, SOURCE_TEXTURE_UNIT);
+	}
+}
+
+// Links the shaders and resolves everything the program is set through
+static bool link_material(material_type_t type, material_t* out)
+{
+	if (!create_program(out))
+	{
+		destroy_material(out);
+		printf("Failed to create shader program.\n");
 		return false;
 	}
+	out->type = type;
+	if (!find_attributes(out))
+	{
+		destroy_material(out);
+		printf("Failed to set shader parameters.\n");
+		return false;
+	}
+	find_uniforms(out);
+	return true;
+}
 
-	const GLsizei position_size = sizeof(vector2d_t);
-	const size_t position_offset = 0;
-	const GLsizei uv_size = sizeof(vector2d_t);
-	const size_t uv_offset = (size_t)position_size;
-	const GLsizei vertex_size = position_size + uv_size;
-	const GLint position_floats = (GLint)(position_size / sizeof(float));
-	const GLint uv_floats = (GLint)(position_size / sizeof(float));
-	glEnableVertexAttribArray(position_index);
-	glEnableVertexAttribArray(uv_index);
-	glVertexAttribPointer(position_index, position_floats, GL_FLOAT, GL_FALSE, vertex_size, (const void*)position_offset);
-	glVertexAttribPointer(uv_index, uv_floats, GL_FLOAT, GL_FALSE, vertex_size, (const void*)uv_offset);
+static bool find_location(GLint location, const char* name)
+{
+	if (location == INVALID_LOCATION)
+	{
+		printf("Failed to find uniform '%s'.\n", name);
+		return false;
+	}
 	return true;
 }
 
+// Whether a cached uniform needs setting; marks it set either way
+static bool update_uniform(material_t* material, unsigned int uniform, bool changed)
+{
+	assert(material->program == bound_program);
+	material_uniforms_t* uniforms = &material->uniforms;
+	const bool update = ((uniforms->set & uniform) == 0) || changed;
+	uniforms->set |= uniform;
+	return update;
+}
+
 bool create_material
 (
+	material_type_t type,
 	const char* vertex_file,
 	const char* fragment_file,
 	material_t* out
@@ -175,14 +328,46 @@ bool create_material
 	out->fragment_shader = fragment_shader;
 
 	// Link the shader
-	if (!create_program(out))
+	return link_material(type, out);
+}
+
+bool create_layered_material
+(
+	material_type_t type,
+	const char* vertex_file,
+	const char* geometry_file,
+	const char* fragment_file,
+	material_t* out
+)
+{
+	GLuint vertex_shader = create_shader(vertex_file, GL_VERTEX_SHADER);
+	if (vertex_shader == INVALID_SHADER)
+	{
+		printf("Failed to load vertex shader from %s.\n", vertex_file);
+		return false;
+	}
+	out->vertex_shader = vertex_shader;
+
+	GLuint geometry_shader = create_shader(geometry_file, GL_GEOMETRY_SHADER);
+	if (geometry_shader == INVALID_SHADER)
 	{
 		destroy_material(out);
-		printf("Failed to create shader program.\n");
+		printf("Failed to load geometry shader from %s.\n", geometry_file);
 		return false;
 	}
+	out->geometry_shader = geometry_shader;
 
-	return true;
+	GLuint fragment_shader = create_shader(fragment_file, GL_FRAGMENT_SHADER);
+	if (fragment_shader == INVALID_SHADER)
+	{
+		destroy_material(out);
+		printf("Failed to load fragment shader from %s.\n", fragment_file);
+		return false;
+	}
+	out->fragment_shader = fragment_shader;
+
+	// Link the shader
+	return link_material(type, out);
 }
 
 void destroy_material(material_t* material)
@@ -190,9 +375,15 @@ void destroy_material(material_t* material)
 	const GLuint program = material->program;
 	if (program != INVALID_PROGRAM)
 	{
+		// Deleting it only takes effect once it's no longer in use
+		if (program == bound_program)
+		{
+			use_program(INVALID_PROGRAM);
+		}
 		glDeleteProgram(program);
 		material->program = INVALID_PROGRAM;
 	}
+	material->uniforms.set = 0;
 
 	const GLuint vertex_shader = material->vertex_shader;
 	if (vertex_shader != INVALID_SHADER)
@@ -201,6 +392,13 @@ void destroy_material(material_t* material)
 		material->vertex_shader = INVALID_SHADER;
 	}
 	
+	const GLuint geometry_shader = material->geometry_shader;
+	if (geometry_shader != INVALID_SHADER)
+	{
+		glDeleteShader(geometry_shader);
+		material->geometry_shader = INVALID_SHADER;
+	}
+
 	const GLuint fragment_shader = material->fragment_shader;
 	if (fragment_shader != INVALID_SHADER)
 	{
@@ -209,45 +407,121 @@ void destroy_material(material_t* material)
 	}
 }
 
-bool activate_material(material_t* material, material_type_t type)
+
+void set_texture_filtering(GLenum target, GLint minify_filter)
 {
-	glUseProgram(material->program);
+	glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, minify_filter);
+}
 
-	// Vertex attributes and uniforms
+bool create_vertex_array(material_type_t type, GLuint vertex_buffer, GLuint index_buffer, GLuint* out)
+{
+	GLuint vertex_array;
+	glGenVertexArrays(1, &vertex_array);
+	bind_vertex_array(vertex_array);
+	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+
+	const GLsizei point_size = sizeof(vector2d_t);
+	const GLint point_floats = (GLint)(point_size / sizeof(float));
 	switch (type)
 	{
 	case LINE_MATERIAL:
-		if (!set_line_shader_parameters(material))
-		{
-			printf("Failed to set line shader parameters.\n");
-			return false;
-		}
+		glEnableVertexAttribArray(POSITION_LOCATION);
+		glVertexAttribPointer(POSITION_LOCATION, point_floats, GL_FLOAT, GL_FALSE, point_size, NULL);
 		break;
 
+	// Reduction and blurring share the texture quad and skip over its UVs
 	case TEXTURE_MATERIAL:
-		if (!set_texture_shader_parameters(material))
-		{
-			printf("Failed to set texture shader parameters.\n");
-			return false;
-		}
+	case REDUCE_MATERIAL:
+	case BLUR_MATERIAL:
+	{
+		const size_t uv_offset = (size_t)point_size;
+		const GLsizei vertex_size = 2 * point_size;
+		glEnableVertexAttribArray(POSITION_LOCATION);
+		glEnableVertexAttribArray(UV_LOCATION);
+		glVertexAttribPointer(POSITION_LOCATION, point_floats, GL_FLOAT, GL_FALSE, vertex_size, NULL);
+		glVertexAttribPointer(UV_LOCATION, point_floats, GL_FLOAT, GL_FALSE, vertex_size, (const void*)uv_offset);
+		break;
+	}
+
+	// One chord per instance; quad corners come from the vertex index
+	case BATCH_LINE_MATERIAL:
+	{
+		const size_t end_offset = (size_t)point_size;
+		const size_t layer_offset = (size_t)(2 * point_size);
+		const GLsizei chord_size = (2 * point_size) + sizeof(GLfloat);
+		glEnableVertexAttribArray(START_LOCATION);
+		glEnableVertexAttribArray(END_LOCATION);
+		glEnableVertexAttribArray(LAYER_LOCATION);
+		glVertexAttribPointer(START_LOCATION, point_floats, GL_FLOAT, GL_FALSE, chord_size, NULL);
+		glVertexAttribPointer(END_LOCATION, point_floats, GL_FLOAT, GL_FALSE, chord_size, (const void*)end_offset);
+		glVertexAttribPointer(LAYER_LOCATION, 1, GL_FLOAT, GL_FALSE, chord_size, (const void*)layer_offset);
+		glVertexAttribDivisor(START_LOCATION, 1);
+		glVertexAttribDivisor(END_LOCATION, 1);
+		glVertexAttribDivisor(LAYER_LOCATION, 1);
+		break;
+	}
+
+	case BATCH_QUAD_MATERIAL:
 		break;
 
 	default:
 		printf("Invalid material type specified!\n");
+		destroy_vertex_array(&vertex_array);
 		return false;
 	}
+	bind_vertex_array(INVALID_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	*out = vertex_array;
 
+	const GLenum error = glGetError();
+	if (error != GL_NO_ERROR)
+	{
+		printf("Failed to create vertex array: %d (0x%x)\n", error, error);
+		return false;
+	}
 	return true;
 }
 
+void destroy_vertex_array(GLuint* vertex_array)
+{
+	if (*vertex_array == INVALID_VERTEX_ARRAY)
+	{
+		return;
+	}
+
+	// Deleting the bound array falls back to none
+	if (*vertex_array == bound_vertex_array)
+	{
+		bound_vertex_array = INVALID_VERTEX_ARRAY;
+	}
+	glDeleteVertexArrays(1, vertex_array);
+	*vertex_array = INVALID_VERTEX_ARRAY;
+}
+
+void activate_material(material_t* material, GLuint vertex_array)
+{
+	use_program(material->program);
+	bind_vertex_array(vertex_array);
+}
+
 bool set_projection(material_t* material, int width, int height)
 {
-	GLint location = glGetUniformLocation(material->program, PROJECTION_MATRIX_NAME);
-	if (location == INVALID_LOCATION)
+	if (!find_location(material->projection_location, PROJECTION_MATRIX_NAME))
 	{
-		printf("Failed to find uniform '%s'.\n", PROJECTION_MATRIX_NAME);
 		return false;
 	}
+	material_uniforms_t* uniforms = &material->uniforms;
+	const bool changed = (uniforms->projection_width != width) || (uniforms->projection_height != height);
+	if (!update_uniform(material, PROJECTION_UNIFORM, changed))
+	{
+		return true;
+	}
+	uniforms->projection_width = width;
+	uniforms->projection_height = height;
 
 	// Scale X from [0, Width] and Y from [0, Height] to [0, 2], then subtract 1
 	// from X and add 1 to Y to get them between [-1, 1].
@@ -264,71 +538,168 @@ bool set_projection(material_t* material, int width, int height)
 	elements[2][2] = 1.f;
 	const GLsizei matrix_count = 1;
 	const GLboolean transpose = GL_FALSE;
-	glUniformMatrix3fv(location, matrix_count, transpose, *elements);
+	glUniformMatrix3fv(material->projection_location, matrix_count, transpose, *elements);
 	return true;
 }
 
 bool set_texture(material_t* material, GLuint line_texture, GLuint image_texture)
 {
-	const GLint line_location = glGetUniformLocation(material->program, LINE_TEXTURE_SAMPLER_NAME);
-	if (line_location == INVALID_LOCATION)
+	if (!find_location(material->line_texture_location, LINE_TEXTURE_SAMPLER_NAME)
+		|| !find_location(material->image_texture_location, IMAGE_TEXTURE_SAMPLER_NAME))
 	{
-		printf("Failed to find uniform '%s'.\n", LINE_TEXTURE_SAMPLER_NAME);
 		return false;
 	}
 
-	const GLint image_location = glGetUniformLocation(material->program, IMAGE_TEXTURE_SAMPLER_NAME);
-	if (image_location == INVALID_LOCATION)
+	glActiveTexture(GL_TEXTURE0 + LINE_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, line_texture);
+	glActiveTexture(GL_TEXTURE0 + IMAGE_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, image_texture);
+	return true;
+}
+
+bool set_line_texture(material_t* material, GLenum target, GLuint line_texture)
+{
+	if (!find_location(material->line_texture_location, LINE_TEXTURE_SAMPLER_NAME))
 	{
-		printf("Failed to find uniform '%s'.\n", IMAGE_TEXTURE_SAMPLER_NAME);
 		return false;
 	}
 
-	// Bind line texture to index 0
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, line_texture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glGenerateMipmap(GL_TEXTURE_2D);
-	glUniform1i(line_location, 0);
-
-	// Bind image texture to index 1
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, image_texture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glUniform1i(image_location, 1);
+	glActiveTexture(GL_TEXTURE0 + LINE_TEXTURE_UNIT);
+	glBindTexture(target, line_texture);
+	return true;
+}
 
+bool set_blur_kernel(material_t* material, const blur_kernel_t* kernel)
+{
+	if (!find_location(material->blur_offsets_location, BLUR_OFFSETS_NAME)
+		|| !find_location(material->blur_weights_location, BLUR_WEIGHTS_NAME))
+	{
+		return false;
+	}
+	blur_kernel_t* cached = &material->uniforms.blur_kernel;
+	if (!update_uniform(material, BLUR_KERNEL_UNIFORM, (memcmp(cached, kernel, sizeof(blur_kernel_t)) != 0)))
+	{
+		return true;
+	}
+	*cached = *kernel;
+	if (material->blur_scale_location != INVALID_LOCATION)
+	{
+		glUniform1f(material->blur_scale_location, kernel->scale);
+	}
+	glUniform1fv(material->blur_offsets_location, BLUR_MAXIMUM_TAPS, kernel->offsets);
+	glUniform1fv(material->blur_weights_location, BLUR_MAXIMUM_TAPS, kernel->weights);
 	return true;
 }
 
 bool set_mode(material_t* material, GLint mode)
 {
-	const GLint mode_location = glGetUniformLocation(material->program, MODE_NAME);
-	if (mode_location == INVALID_LOCATION)
+	if (!find_location(material->mode_location, MODE_NAME))
+	{
+		return false;
+	}
+	if (update_uniform(material, MODE_UNIFORM, (material->uniforms.mode != mode)))
+	{
+		material->uniforms.mode = mode;
+		glUniform1i(material->mode_location, mode);
+	}
+	return true;
+}
+
+bool set_texture_array(material_t* material, GLuint line_texture_array, GLuint image_texture)
+{
+	if (!find_location(material->line_texture_location, LINE_TEXTURE_SAMPLER_NAME)
+		|| !find_location(material->image_texture_location, IMAGE_TEXTURE_SAMPLER_NAME))
 	{
-		printf("Failed to find uniform '%s'.\n", MODE_NAME);
 		return false;
 	}
 
-	glUniform1i(mode_location, mode);
+	glActiveTexture(GL_TEXTURE0 + LINE_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, line_texture_array);
+	glActiveTexture(GL_TEXTURE0 + IMAGE_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, image_texture);
 	return true;
 }
 
-bool set_sample_radius(material_t* material, GLfloat radius)
+bool set_reduce_source(material_t* material, GLenum target, GLuint source_texture, GLint width, GLint height)
 {
-	const GLint radius_location = glGetUniformLocation(material->program, SAMPLE_RADIUS_NAME);
-	if (radius_location == INVALID_LOCATION)
+	if (!find_location(material->source_texture_location, SOURCE_TEXTURE_SAMPLER_NAME)
+		|| !find_location(material->source_size_location, SOURCE_SIZE_NAME))
 	{
-		printf("Failed to find uniform '%s'.\n", SAMPLE_RADIUS_NAME);
 		return false;
 	}
 
-	glUniform1f(radius_location, radius);
+	// Texels are fetched directly, so no filtering state is needed
+	glActiveTexture(GL_TEXTURE0 + SOURCE_TEXTURE_UNIT);
+	glBindTexture(target, source_texture);
+	material_uniforms_t* uniforms = &material->uniforms;
+	const bool changed = (uniforms->source_size[0] != width) || (uniforms->source_size[1] != height);
+	if (update_uniform(material, SOURCE_SIZE_UNIFORM, changed))
+	{
+		uniforms->source_size[0] = width;
+		uniforms->source_size[1] = height;
+		glUniform2i(material->source_size_location, width, height);
+	}
 	return true;
 }
 
+bool set_output_offset(material_t* material, GLint x, GLint y)
+{
+	if (!find_location(material->output_offset_location, OUTPUT_OFFSET_NAME))
+	{
+		return false;
+	}
+	material_uniforms_t* uniforms = &material->uniforms;
+	const bool changed = (uniforms->output_offset[0] != x) || (uniforms->output_offset[1] != y);
+	if (update_uniform(material, OUTPUT_OFFSET_UNIFORM, changed))
+	{
+		uniforms->output_offset[0] = x;
+		uniforms->output_offset[1] = y;
+		glUniform2i(material->output_offset_location, x, y);
+	}
+	return true;
+}
+
+bool set_canvas_size(material_t* material, GLfloat width, GLfloat height)
+{
+	if (!find_location(material->canvas_size_location, CANVAS_SIZE_NAME))
+	{
+		return false;
+	}
+	material_uniforms_t* uniforms = &material->uniforms;
+	const bool changed = (uniforms->canvas_size[0] != width) || (uniforms->canvas_size[1] != height);
+	if (update_uniform(material, CANVAS_SIZE_UNIFORM, changed))
+	{
+		uniforms->canvas_size[0] = width;
+		uniforms->canvas_size[1] = height;
+		glUniform2f(material->canvas_size_location, width, height);
+	}
+	return true;
+}
+
+bool set_line_reach(material_t* material, GLfloat reach)
+{
+	if (!find_location(material->line_reach_location, LINE_REACH_NAME))
+	{
+		return false;
+	}
+	if (update_uniform(material, LINE_REACH_UNIFORM, (material->uniforms.line_reach != reach)))
+	{
+		material->uniforms.line_reach = reach;
+		glUniform1f(material->line_reach_location, reach);
+	}
+	return true;
+}
+
+bool set_layer_offset(material_t* material, GLint offset)
+{
+	if (!find_location(material->layer_offset_location, LAYER_OFFSET_NAME))
+	{
+		return false;
+	}
+	if (update_uniform(material, LAYER_OFFSET_UNIFORM, (material->uniforms.layer_offset != offset)))
+	{
+		material->uniforms.layer_offset = offset;
+		glUniform1i(material->layer_offset_location, offset);
+	}
+	return true;
+}
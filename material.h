@@ -8,34 +8,112 @@
 #include <GL/gl.h>
 #include <stdbool.h>
 
+#include "blur.h"
+
 #define INVALID_SHADER 0
 #define INVALID_PROGRAM 0
 #define INVALID_LOCATION -1
+#define INVALID_VERTEX_ARRAY 0
 
 typedef enum material_type
 {
 	LINE_MATERIAL,
-	TEXTURE_MATERIAL
+	TEXTURE_MATERIAL,
+	REDUCE_MATERIAL,
+	BLUR_MATERIAL,
+	BATCH_LINE_MATERIAL,
+	BATCH_QUAD_MATERIAL
 } material_type_t;
 
+// Uniform values last given to a program, so setting them again is skipped
+typedef struct material_uniforms
+{
+	unsigned int set;
+	int projection_width;
+	int projection_height;
+	GLint mode;
+	GLint source_size[2];
+	GLint output_offset[2];
+	GLfloat canvas_size[2];
+	GLfloat line_reach;
+	GLint layer_offset;
+	blur_kernel_t blur_kernel;
+} material_uniforms_t;
+
+// Shader program with its uniform locations looked up once at creation.
+// Attribute locations are fixed at link, so the vertex arrays made for a
+// type serve every material drawing the same layout. The program and vertex
+// array in use are tracked, so only changes reach the driver.
 typedef struct material
 {
 	GLuint vertex_shader;
+	GLuint geometry_shader;
 	GLuint fragment_shader;
 	GLuint program;
+	material_type_t type;
+
+	// INVALID_LOCATION for any the program doesn't use
+	GLint projection_location;
+	GLint line_texture_location;
+	GLint image_texture_location;
+	GLint mode_location;
+	GLint source_texture_location;
+	GLint source_size_location;
+	GLint output_offset_location;
+	GLint canvas_size_location;
+	GLint line_reach_location;
+	GLint layer_offset_location;
+	GLint blur_scale_location;
+	GLint blur_offsets_location;
+	GLint blur_weights_location;
+
+	material_uniforms_t uniforms;
 } material_t;
 
 material_t null_material();
 bool create_material
 (
+	material_type_t type,
+	const char* vertex_file,
+	const char* fragment_file,
+	material_t* out
+);
+
+// Material with a geometry shader, for drawing into texture array layers
+bool create_layered_material
+(
+	material_type_t type,
 	const char* vertex_file,
+	const char* geometry_file,
 	const char* fragment_file,
 	material_t* out
 );
 void destroy_material(material_t* material);
-bool activate_material(material_t* material, material_type_t type);
+
+// Wrapping and filtering the shaders expect of the texture bound to the
+// target, set once when it's created
+void set_texture_filtering(GLenum target, GLint minify_filter);
+
+// Vertex array with the attribute layout of a material type over the
+// buffers; a buffer of 0 is left unbound
+bool create_vertex_array(material_type_t type, GLuint vertex_buffer, GLuint index_buffer, GLuint* out);
+void destroy_vertex_array(GLuint* vertex_array);
+
+// Uses the material's program and the vertex array, binding only what changed
+void activate_material(material_t* material, GLuint vertex_array);
 bool set_projection(material_t* material, int width, int height);
+
+// Binds the textures to the units the samplers were pointed at on creation
 bool set_texture(material_t* material, GLuint line_texture, GLuint image_texture);
+bool set_line_texture(material_t* material, GLenum target, GLuint line_texture);
+
+// Weights of a blur pass; the scale is only set where the shader reads it
+bool set_blur_kernel(material_t* material, const blur_kernel_t* kernel);
 bool set_mode(material_t* material, GLint mode);
-bool set_sample_radius(material_t* material, GLfloat radius);
+bool set_texture_array(material_t* material, GLuint line_texture_array, GLuint image_texture);
+bool set_reduce_source(material_t* material, GLenum target, GLuint source_texture, GLint width, GLint height);
+bool set_output_offset(material_t* material, GLint x, GLint y);
+bool set_canvas_size(material_t* material, GLfloat width, GLfloat height);
+bool set_line_reach(material_t* material, GLfloat reach);
+bool set_layer_offset(material_t* material, GLint offset);
 
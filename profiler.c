@@ -0,0 +1,387 @@
+#include "profiler.h"
+#include "thread.h"
+#include <SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROFILE_RING_MASK (PROFILE_RING_CAPACITY - 1)
+
+static const char* stage_names[PROFILE_STAGE_COUNT] =
+{
+	"upload",
+	"lines",
+	"blur",
+	"readback",
+	"score",
+	"sort",
+	"mutate"
+};
+
+static profile_gpu_frame_t null_gpu_frame(void)
+{
+	profile_gpu_frame_t result;
+	result.queries = NULL;
+	result.stages = NULL;
+	result.span_count = 0;
+	result.span_capacity = 0;
+	result.pending = false;
+	return result;
+}
+
+static profile_series_t null_series(void)
+{
+	profile_series_t result;
+	for (size_t i = 0; i < PROFILE_STAGE_COUNT; ++i)
+	{
+		result.milliseconds[i] = NULL;
+		result.counts[i] = 0;
+	}
+	return result;
+}
+
+static bool create_series(profile_series_t* out)
+{
+	for (size_t i = 0; i < PROFILE_STAGE_COUNT; ++i)
+	{
+		out->milliseconds[i] = (double*)malloc(PROFILE_INTERVAL * sizeof(double));
+		if (out->milliseconds[i] == NULL)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static void destroy_series(profile_series_t* series)
+{
+	for (size_t i = 0; i < PROFILE_STAGE_COUNT; ++i)
+	{
+		free(series->milliseconds[i]);
+		series->milliseconds[i] = NULL;
+	}
+}
+
+profiler_t null_profiler(void)
+{
+	profiler_t result;
+	result.enabled = false;
+	result.gpu = false;
+	result.file = NULL;
+	result.json = false;
+	result.ring = NULL;
+	result.claimed = 0;
+	result.drained = 0;
+	result.dropped = 0;
+	result.tick_frequency = 1;
+	for (size_t i = 0; i < PROFILE_GPU_LATENCY; ++i)
+	{
+		result.frames[i] = null_gpu_frame();
+	}
+	result.frame = 0;
+	result.cpu = null_series();
+	result.gpu_series = null_series();
+	result.generation_count = 0;
+	result.last_generation = 0;
+	return result;
+}
+
+bool create_profiler(const char* filename, bool gpu, profiler_t* out)
+{
+	profiler_t result = null_profiler();
+	result.gpu = gpu;
+	if (gpu && !GLEW_ARB_timer_query)
+	{
+		printf("Timer queries aren't supported; profiling on the CPU only.\n");
+		result.gpu = false;
+	}
+	result.tick_frequency = SDL_GetPerformanceFrequency();
+	result.ring = (profile_sample_t*)calloc(PROFILE_RING_CAPACITY, sizeof(profile_sample_t));
+	if ((result.ring == NULL) || !create_series(&result.cpu) || !create_series(&result.gpu_series))
+	{
+		printf("Failed to allocate profiler.\n");
+		destroy_profiler(&result);
+		return false;
+	}
+
+	result.file = fopen(filename, "w");
+	if (result.file == NULL)
+	{
+		printf("Failed to open profile output %s.\n", filename);
+		destroy_profiler(&result);
+		return false;
+	}
+	const size_t length = strlen(filename);
+	result.json = ((length >= 5) && (strcmp(filename + length - 5, ".json") == 0));
+	if (!result.json)
+	{
+		fprintf(result.file, "generation,stage,clock,samples,mean_ms,p50_ms,p90_ms,p99_ms,max_ms\n");
+	}
+
+	result.enabled = true;
+	*out = result;
+	return true;
+}
+
+static int compare_doubles(const void* a, const void* b)
+{
+	const double first = *(const double*)a;
+	const double second = *(const double*)b;
+	return (first > second) - (first < second);
+}
+
+// Nearest rank of the sorted values
+static double get_percentile(const double* sorted, size_t count, size_t percent)
+{
+	const size_t rank = ((percent * count) + 99) / 100;
+	return sorted[(rank > 0 ? rank : 1) - 1];
+}
+
+static void write_series(profiler_t* profiler, profile_series_t* series, const char* clock, int generation)
+{
+	for (size_t i = 0; i < PROFILE_STAGE_COUNT; ++i)
+	{
+		const size_t count = series->counts[i];
+		if (count == 0)
+		{
+			continue;
+		}
+
+		double* values = series->milliseconds[i];
+		qsort(values, count, sizeof(double), &compare_doubles);
+		double sum = 0.0;
+		for (size_t j = 0; j < count; ++j)
+		{
+			sum += values[j];
+		}
+		const double mean = sum / (double)count;
+		const double p50 = get_percentile(values, count, 50);
+		const double p90 = get_percentile(values, count, 90);
+		const double p99 = get_percentile(values, count, 99);
+		const double maximum = values[count - 1];
+		if (profiler->json)
+		{
+			fprintf(profiler->file,
+				"{\"generation\": %d, \"stage\": \"%s\", \"clock\": \"%s\", \"samples\": %d, \"mean_ms\": %.6f, \"p50_ms\": %.6f, \"p90_ms\": %.6f, \"p99_ms\": %.6f, \"max_ms\": %.6f}\n",
+				generation, stage_names[i], clock, (int)count, mean, p50, p90, p99, maximum);
+		}
+		else
+		{
+			fprintf(profiler->file, "%d,%s,%s,%d,%.6f,%.6f,%.6f,%.6f,%.6f\n",
+				generation, stage_names[i], clock, (int)count, mean, p50, p90, p99, maximum);
+		}
+		series->counts[i] = 0;
+	}
+}
+
+static void write_report(profiler_t* profiler, int generation)
+{
+	write_series(profiler, &profiler->cpu, "cpu", generation);
+	write_series(profiler, &profiler->gpu_series, "gpu", generation);
+	fflush(profiler->file);
+	profiler->generation_count = 0;
+}
+
+static void add_to_series(profile_series_t* series, const double* totals, const bool* seen)
+{
+	for (size_t i = 0; i < PROFILE_STAGE_COUNT; ++i)
+	{
+		if (seen[i] && (series->counts[i] < PROFILE_INTERVAL))
+		{
+			series->milliseconds[i][series->counts[i]++] = totals[i];
+		}
+	}
+}
+
+// Totals the timestamps of a frame queued PROFILE_GPU_LATENCY generations ago
+static void resolve_gpu_frame(profiler_t* profiler, profile_gpu_frame_t* frame)
+{
+	double totals[PROFILE_STAGE_COUNT] = { 0.0 };
+	bool seen[PROFILE_STAGE_COUNT] = { false };
+	for (size_t i = 0; i < frame->span_count; ++i)
+	{
+		GLuint64 start;
+		GLuint64 end;
+		glGetQueryObjectui64v(frame->queries[(i * 2) + 0], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(frame->queries[(i * 2) + 1], GL_QUERY_RESULT, &end);
+		const size_t stage = frame->stages[i];
+		totals[stage] += (double)(end - start) * 1e-6;
+		seen[stage] = true;
+	}
+	add_to_series(&profiler->gpu_series, totals, seen);
+	frame->span_count = 0;
+	frame->pending = false;
+}
+
+void destroy_profiler(profiler_t* profiler)
+{
+	if (profiler->file != NULL)
+	{
+		for (size_t i = 1; i <= PROFILE_GPU_LATENCY; ++i)
+		{
+			profile_gpu_frame_t* frame = &profiler->frames[(profiler->frame + i) % PROFILE_GPU_LATENCY];
+			if (frame->pending)
+			{
+				resolve_gpu_frame(profiler, frame);
+			}
+		}
+		write_report(profiler, profiler->last_generation);
+		if (profiler->dropped > 0)
+		{
+			printf("Profiler dropped %d CPU spans.\n", (int)profiler->dropped);
+		}
+		fclose(profiler->file);
+		profiler->file = NULL;
+	}
+	for (size_t i = 0; i < PROFILE_GPU_LATENCY; ++i)
+	{
+		profile_gpu_frame_t* frame = &profiler->frames[i];
+		if (frame->queries != NULL)
+		{
+			glDeleteQueries((GLsizei)(frame->span_capacity * 2), frame->queries);
+		}
+		free(frame->queries);
+		free(frame->stages);
+		*frame = null_gpu_frame();
+	}
+	destroy_series(&profiler->gpu_series);
+	destroy_series(&profiler->cpu);
+	free(profiler->ring);
+	profiler->ring = NULL;
+	profiler->enabled = false;
+}
+
+// Makes room for another span in the frame, creating queries as needed
+static bool reserve_gpu_span(profile_gpu_frame_t* frame)
+{
+	if (frame->span_count < frame->span_capacity)
+	{
+		return true;
+	}
+
+	const size_t capacity = (frame->span_capacity == 0 ? 16 : frame->span_capacity * 2);
+	GLuint* queries = (GLuint*)realloc(frame->queries, capacity * 2 * sizeof(GLuint));
+	if (queries == NULL)
+	{
+		return false;
+	}
+	frame->queries = queries;
+	uint8_t* stages = (uint8_t*)realloc(frame->stages, capacity * sizeof(uint8_t));
+	if (stages == NULL)
+	{
+		return false;
+	}
+	frame->stages = stages;
+	glGenQueries((GLsizei)((capacity - frame->span_capacity) * 2), &queries[frame->span_capacity * 2]);
+	frame->span_capacity = capacity;
+	return true;
+}
+
+profile_span_t begin_cpu_span(profiler_t* profiler, profile_stage_t stage)
+{
+	profile_span_t span;
+	span.stage = stage;
+	span.start = 0;
+	span.gpu = false;
+	span.query = 0;
+	if ((profiler != NULL) && profiler->enabled)
+	{
+		span.start = SDL_GetPerformanceCounter();
+	}
+	return span;
+}
+
+profile_span_t begin_span(profiler_t* profiler, profile_stage_t stage)
+{
+	profile_span_t span = begin_cpu_span(profiler, stage);
+	if ((profiler != NULL) && profiler->enabled && profiler->gpu)
+	{
+		profile_gpu_frame_t* frame = &profiler->frames[profiler->frame];
+		if (reserve_gpu_span(frame))
+		{
+			span.gpu = true;
+			span.query = frame->span_count++;
+			frame->stages[span.query] = (uint8_t)stage;
+			glQueryCounter(frame->queries[span.query * 2], GL_TIMESTAMP);
+		}
+	}
+	return span;
+}
+
+void end_span(profiler_t* profiler, profile_span_t span)
+{
+	if ((profiler == NULL) || !profiler->enabled)
+	{
+		return;
+	}
+	const uint64_t end = SDL_GetPerformanceCounter();
+	if (span.gpu)
+	{
+		const profile_gpu_frame_t* frame = &profiler->frames[profiler->frame];
+		glQueryCounter(frame->queries[(span.query * 2) + 1], GL_TIMESTAMP);
+	}
+
+	// Claim a slot, hide it while it is written, then publish it
+	const long index = add_atomic(&profiler->claimed, 1) - 1;
+	profile_sample_t* sample = &profiler->ring[index & PROFILE_RING_MASK];
+	store_atomic(&sample->sequence, 0);
+	sample->stage = (uint32_t)span.stage;
+	sample->ticks = end - span.start;
+	store_atomic(&sample->sequence, index + 1);
+}
+
+bool end_profile_generation(profiler_t* profiler, int generation)
+{
+	if ((profiler == NULL) || !profiler->enabled)
+	{
+		return true;
+	}
+
+	// Spans overwritten before this drain are lost rather than waited for
+	const long claimed = load_atomic(&profiler->claimed);
+	if (claimed - profiler->drained > PROFILE_RING_CAPACITY)
+	{
+		profiler->dropped += (size_t)(claimed - profiler->drained - PROFILE_RING_CAPACITY);
+		profiler->drained = claimed - PROFILE_RING_CAPACITY;
+	}
+	double totals[PROFILE_STAGE_COUNT] = { 0.0 };
+	bool seen[PROFILE_STAGE_COUNT] = { false };
+	const double milliseconds_per_tick = 1e3 / (double)profiler->tick_frequency;
+	while (profiler->drained < claimed)
+	{
+		profile_sample_t* sample = &profiler->ring[profiler->drained & PROFILE_RING_MASK];
+		const long sequence = profiler->drained + 1;
+		if (load_atomic(&sample->sequence) != sequence)
+		{
+			// Still being written; picked up with the next generation
+			break;
+		}
+		const uint32_t stage = sample->stage;
+		const uint64_t ticks = sample->ticks;
+		if ((load_atomic(&sample->sequence) == sequence) && (stage < PROFILE_STAGE_COUNT))
+		{
+			totals[stage] += (double)ticks * milliseconds_per_tick;
+			seen[stage] = true;
+		}
+		++profiler->drained;
+	}
+	add_to_series(&profiler->cpu, totals, seen);
+	profiler->last_generation = generation;
+
+	// Queries of this generation are read once the ring comes back round
+	if (profiler->gpu)
+	{
+		profiler->frames[profiler->frame].pending = true;
+		profiler->frame = (profiler->frame + 1) % PROFILE_GPU_LATENCY;
+		profile_gpu_frame_t* frame = &profiler->frames[profiler->frame];
+		if (frame->pending)
+		{
+			resolve_gpu_frame(profiler, frame);
+		}
+	}
+
+	if (++profiler->generation_count == PROFILE_INTERVAL)
+	{
+		write_report(profiler, generation);
+	}
+	return !ferror(profiler->file);
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define PROFILE_ARGUMENT "--profile"
+#define PROFILE_OUTPUT_ARGUMENT "--profile-output"
+#define PROFILE_FILENAME "profile.csv"
+
+// CPU spans the ring holds between drains; a power of two
+#define PROFILE_RING_CAPACITY 4096
+
+// Generations summarized by each line of percentiles
+#define PROFILE_INTERVAL 100
+
+// Generations of timestamp queries left in flight before the oldest is read,
+// so reading them never stalls the pipeline
+#define PROFILE_GPU_LATENCY 4
+
+typedef enum profile_stage
+{
+	PROFILE_UPLOAD,
+	PROFILE_LINES,
+	PROFILE_BLUR,
+	PROFILE_READBACK,
+	PROFILE_SCORE,
+	PROFILE_SORT,
+	PROFILE_MUTATE,
+	PROFILE_STAGE_COUNT
+} profile_stage_t;
+
+// Stage being timed, from begin_span to end_span, and its pair of
+// timestamp queries if it is timed on the GPU too
+typedef struct profile_span
+{
+	profile_stage_t stage;
+	uint64_t start;
+	bool gpu;
+	size_t query;
+} profile_span_t;
+
+// CPU span in the ring; the sequence is one past the span's index once it
+// is fully written, and zero while it is being written
+typedef struct profile_sample
+{
+	volatile long sequence;
+	uint32_t stage;
+	uint64_t ticks;
+} profile_sample_t;
+
+// Timestamp queries of one generation, begin and end per span
+typedef struct profile_gpu_frame
+{
+	GLuint* queries;
+	uint8_t* stages;
+	size_t span_count;
+	size_t span_capacity;
+	bool pending;
+} profile_gpu_frame_t;
+
+// Per-generation totals of every stage over the current interval
+typedef struct profile_series
+{
+	double* milliseconds[PROFILE_STAGE_COUNT];
+	size_t counts[PROFILE_STAGE_COUNT];
+} profile_series_t;
+
+// Splits each generation into stages, timed on the CPU through a ring any
+// thread can write without locking, and on the GPU with timestamp queries.
+// Percentiles of the per-generation totals go to a CSV file, or JSON lines
+// if the filename ends in .json.
+typedef struct profiler
+{
+	bool enabled;
+	bool gpu;
+	FILE* file;
+	bool json;
+
+	profile_sample_t* ring;
+	volatile long claimed;
+	long drained;
+	size_t dropped;
+	uint64_t tick_frequency;
+
+	profile_gpu_frame_t frames[PROFILE_GPU_LATENCY];
+	size_t frame;
+
+	profile_series_t cpu;
+	profile_series_t gpu_series;
+	size_t generation_count;
+	int last_generation;
+} profiler_t;
+
+profiler_t null_profiler(void);
+
+// Timestamp queries are only issued with gpu set, which needs a current GL
+// context until the profiler is destroyed
+bool create_profiler(const char* filename, bool gpu, profiler_t* out);
+
+// Writes percentiles of the generations since the last report
+void destroy_profiler(profiler_t* profiler);
+
+// Spans cost nothing on a null or disabled profiler. CPU spans may end on
+// any thread; GPU spans only on the one with the GL context.
+profile_span_t begin_span(profiler_t* profiler, profile_stage_t stage);
+profile_span_t begin_cpu_span(profiler_t* profiler, profile_stage_t stage);
+void end_span(profiler_t* profiler, profile_span_t span);
+
+// Totals the stages of the generation just finished, reading back the
+// oldest timestamps, and reports every PROFILE_INTERVAL generations
+bool end_profile_generation(profiler_t* profiler, int generation);
@@ -0,0 +1,74 @@
+#include "random.h"
+#include <assert.h>
+
+// Odd constant spacing the streams derive_random keys apart
+#define RANDOM_STREAM_STRIDE 0xD1B54A32D192ED03ull
+
+// SplitMix64 step, used to spread a seed over the whole state
+static uint64_t mix_seed(uint64_t* seed)
+{
+	uint64_t mixed = (*seed += 0x9E3779B97F4A7C15ull);
+	mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9ull;
+	mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EBull;
+	return mixed ^ (mixed >> 31);
+}
+
+static uint64_t rotate_left(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+random_state_t seed_random(uint64_t seed)
+{
+	// SplitMix64 gives four distinct words, so the state is never all zero
+	random_state_t result;
+	for (int i = 0; i < 4; ++i)
+	{
+		result.state[i] = mix_seed(&seed);
+	}
+	return result;
+}
+
+random_state_t derive_random(uint64_t key, uint64_t stream)
+{
+	return seed_random(key + ((stream + 1) * RANDOM_STREAM_STRIDE));
+}
+
+uint64_t next_random64(random_state_t* random)
+{
+	uint64_t* state = random->state;
+	const uint64_t result = rotate_left(state[1] * 5, 7) * 9;
+	const uint64_t shifted = state[1] << 17;
+	state[2] ^= state[0];
+	state[3] ^= state[1];
+	state[1] ^= state[2];
+	state[0] ^= state[3];
+	state[2] ^= shifted;
+	state[3] = rotate_left(state[3], 45);
+	return result;
+}
+
+uint32_t next_random(random_state_t* random)
+{
+	// High bits are the strongest
+	return (uint32_t)(next_random64(random) >> 32);
+}
+
+uint32_t random_below(random_state_t* random, uint32_t bound)
+{
+	// Multiply into the high word, rejecting the few low words that would
+	// favour some values (Lemire's method); usually no division at all
+	assert(bound > 0);
+	uint64_t product = (uint64_t)next_random(random) * bound;
+	uint32_t low = (uint32_t)product;
+	if (low < bound)
+	{
+		const uint32_t threshold = (0u - bound) % bound;
+		while (low < threshold)
+		{
+			product = (uint64_t)next_random(random) * bound;
+			low = (uint32_t)product;
+		}
+	}
+	return (uint32_t)(product >> 32);
+}
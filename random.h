@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+
+// Generator owned by one thread of work, so populations running at once
+// neither share nor lock rand()'s state. xoshiro256**, with a period of
+// 2^256 - 1.
+typedef struct random_state
+{
+	uint64_t state[4];
+} random_state_t;
+
+random_state_t seed_random(uint64_t seed);
+
+// Generator for one of many streams keyed by the same value, such as one
+// per offspring, so work can be split any way and draw the same numbers
+random_state_t derive_random(uint64_t key, uint64_t stream);
+
+uint64_t next_random64(random_state_t* random);
+uint32_t next_random(random_state_t* random);
+
+// Value in [0, bound), with every value equally likely
+uint32_t random_below(random_state_t* random, uint32_t bound);
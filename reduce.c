@@ -0,0 +1,377 @@
+#include "reduce.h"
+#include <assert.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define X86_REDUCE 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET(isa)
+#else
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+#else
+#define X86_REDUCE 0
+#endif
+
+// Deepest the reduction tree goes, well past any image size
+#define SUM_TREE_DEPTH 64
+
+// Subtrees of the reduction handed to the pool, 2^depth at most
+#define SUM_TASK_DEPTH 4
+#define SUM_TASK_COUNT (1 << SUM_TASK_DEPTH)
+
+typedef double (*sum_block_t)(const float* values, size_t count);
+
+// Walk of the tree that may stop early, with the sums of the left subtrees
+// it is to the right of
+typedef struct bounded_sum
+{
+	sum_block_t sum_block;
+	double bound;
+	double lefts[SUM_TREE_DEPTH];
+} bounded_sum_t;
+
+// Part of the tree summed by one task
+typedef struct sum_task
+{
+	sum_block_t sum_block;
+	const float* values;
+	size_t count;
+	double sum;
+} sum_task_t;
+
+// Not yet detected until set
+static simd_level_t simd_level = SIMD_LEVEL_COUNT;
+
+// Folds the lanes pairwise into the first
+static double combine_lanes(double* lanes)
+{
+	for (size_t width = SUM_LANES / 2; width > 0; width /= 2)
+	{
+		for (size_t i = 0; i < width; ++i)
+		{
+			lanes[i] += lanes[i + width];
+		}
+	}
+	return lanes[0];
+}
+
+static double sum_block_scalar(const float* values, size_t count)
+{
+	double lanes[SUM_LANES] = { 0.0 };
+	for (size_t i = 0; i < count; ++i)
+	{
+		lanes[i % SUM_LANES] += (double)values[i];
+	}
+	return combine_lanes(lanes);
+}
+
+#if X86_REDUCE
+// Each register holds consecutive lanes; leftovers go to the lanes in order
+TARGET("sse2")
+static double sum_block_sse2(const float* values, size_t count)
+{
+	__m128d sum0 = _mm_setzero_pd();
+	__m128d sum1 = _mm_setzero_pd();
+	__m128d sum2 = _mm_setzero_pd();
+	__m128d sum3 = _mm_setzero_pd();
+	__m128d sum4 = _mm_setzero_pd();
+	__m128d sum5 = _mm_setzero_pd();
+	__m128d sum6 = _mm_setzero_pd();
+	__m128d sum7 = _mm_setzero_pd();
+	const size_t whole_count = count - (count % SUM_LANES);
+	for (size_t i = 0; i < whole_count; i += SUM_LANES)
+	{
+		const __m128 values0 = _mm_loadu_ps(values + i);
+		const __m128 values1 = _mm_loadu_ps(values + i + 4);
+		const __m128 values2 = _mm_loadu_ps(values + i + 8);
+		const __m128 values3 = _mm_loadu_ps(values + i + 12);
+		sum0 = _mm_add_pd(sum0, _mm_cvtps_pd(values0));
+		sum1 = _mm_add_pd(sum1, _mm_cvtps_pd(_mm_movehl_ps(values0, values0)));
+		sum2 = _mm_add_pd(sum2, _mm_cvtps_pd(values1));
+		sum3 = _mm_add_pd(sum3, _mm_cvtps_pd(_mm_movehl_ps(values1, values1)));
+		sum4 = _mm_add_pd(sum4, _mm_cvtps_pd(values2));
+		sum5 = _mm_add_pd(sum5, _mm_cvtps_pd(_mm_movehl_ps(values2, values2)));
+		sum6 = _mm_add_pd(sum6, _mm_cvtps_pd(values3));
+		sum7 = _mm_add_pd(sum7, _mm_cvtps_pd(_mm_movehl_ps(values3, values3)));
+	}
+
+	double lanes[SUM_LANES];
+	_mm_storeu_pd(lanes, sum0);
+	_mm_storeu_pd(lanes + 2, sum1);
+	_mm_storeu_pd(lanes + 4, sum2);
+	_mm_storeu_pd(lanes + 6, sum3);
+	_mm_storeu_pd(lanes + 8, sum4);
+	_mm_storeu_pd(lanes + 10, sum5);
+	_mm_storeu_pd(lanes + 12, sum6);
+	_mm_storeu_pd(lanes + 14, sum7);
+	for (size_t i = whole_count; i < count; ++i)
+	{
+		lanes[i % SUM_LANES] += (double)values[i];
+	}
+	return combine_lanes(lanes);
+}
+
+TARGET("avx2")
+static double sum_block_avx2(const float* values, size_t count)
+{
+	__m256d sum0 = _mm256_setzero_pd();
+	__m256d sum1 = _mm256_setzero_pd();
+	__m256d sum2 = _mm256_setzero_pd();
+	__m256d sum3 = _mm256_setzero_pd();
+	const size_t whole_count = count - (count % SUM_LANES);
+	for (size_t i = 0; i < whole_count; i += SUM_LANES)
+	{
+		sum0 = _mm256_add_pd(sum0, _mm256_cvtps_pd(_mm_loadu_ps(values + i)));
+		sum1 = _mm256_add_pd(sum1, _mm256_cvtps_pd(_mm_loadu_ps(values + i + 4)));
+		sum2 = _mm256_add_pd(sum2, _mm256_cvtps_pd(_mm_loadu_ps(values + i + 8)));
+		sum3 = _mm256_add_pd(sum3, _mm256_cvtps_pd(_mm_loadu_ps(values + i + 12)));
+	}
+
+	double lanes[SUM_LANES];
+	_mm256_storeu_pd(lanes, sum0);
+	_mm256_storeu_pd(lanes + 4, sum1);
+	_mm256_storeu_pd(lanes + 8, sum2);
+	_mm256_storeu_pd(lanes + 12, sum3);
+	for (size_t i = whole_count; i < count; ++i)
+	{
+		lanes[i % SUM_LANES] += (double)values[i];
+	}
+	return combine_lanes(lanes);
+}
+
+TARGET("avx512f")
+static double sum_block_avx512(const float* values, size_t count)
+{
+	__m512d sum0 = _mm512_setzero_pd();
+	__m512d sum1 = _mm512_setzero_pd();
+	const size_t whole_count = count - (count % SUM_LANES);
+	for (size_t i = 0; i < whole_count; i += SUM_LANES)
+	{
+		sum0 = _mm512_add_pd(sum0, _mm512_cvtps_pd(_mm256_loadu_ps(values + i)));
+		sum1 = _mm512_add_pd(sum1, _mm512_cvtps_pd(_mm256_loadu_ps(values + i + 8)));
+	}
+
+	double lanes[SUM_LANES];
+	_mm512_storeu_pd(lanes, sum0);
+	_mm512_storeu_pd(lanes + 8, sum1);
+	for (size_t i = whole_count; i < count; ++i)
+	{
+		lanes[i % SUM_LANES] += (double)values[i];
+	}
+	return combine_lanes(lanes);
+}
+#endif
+
+simd_level_t get_supported_simd_level(void)
+{
+#if !X86_REDUCE
+	return SIMD_SCALAR;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	const int maximum_leaf = info[0];
+	__cpuid(info, 1);
+	const bool sse2 = ((info[3] & (1 << 26)) != 0);
+	const bool os_saves_ymm = ((info[2] & (1 << 27)) != 0) && ((info[2] & (1 << 28)) != 0) && ((_xgetbv(0) & 0x6) == 0x6);
+	const bool os_saves_zmm = os_saves_ymm && ((_xgetbv(0) & 0xE6) == 0xE6);
+	bool avx2 = false;
+	bool avx512 = false;
+	if (maximum_leaf >= 7)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = os_saves_ymm && ((info[1] & (1 << 5)) != 0);
+		avx512 = os_saves_zmm && ((info[1] & (1 << 16)) != 0);
+	}
+	return (avx512 ? SIMD_AVX512 : (avx2 ? SIMD_AVX2 : (sse2 ? SIMD_SSE2 : SIMD_SCALAR)));
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+	{
+		return SIMD_AVX512;
+	}
+	else if (__builtin_cpu_supports("avx2"))
+	{
+		return SIMD_AVX2;
+	}
+	else if (__builtin_cpu_supports("sse2"))
+	{
+		return SIMD_SSE2;
+	}
+	return SIMD_SCALAR;
+#endif
+}
+
+simd_level_t get_simd_level(void)
+{
+	// Detection gives the same answer on every thread, so racing is harmless
+	if (simd_level == SIMD_LEVEL_COUNT)
+	{
+		simd_level = get_supported_simd_level();
+	}
+	return simd_level;
+}
+
+void set_simd_level(simd_level_t level)
+{
+	const simd_level_t supported = get_supported_simd_level();
+	simd_level = (level < supported ? level : supported);
+}
+
+const char* get_simd_level_name(simd_level_t level)
+{
+	switch (level)
+	{
+		case SIMD_SSE2:
+			return "sse2";
+
+		case SIMD_AVX2:
+			return "avx2";
+
+		case SIMD_AVX512:
+			return "avx512";
+
+		default:
+			return "scalar";
+	}
+}
+
+static sum_block_t get_sum_block(void)
+{
+	switch (get_simd_level())
+	{
+#if X86_REDUCE
+		case SIMD_SSE2:
+			return &sum_block_sse2;
+
+		case SIMD_AVX2:
+			return &sum_block_avx2;
+
+		case SIMD_AVX512:
+			return &sum_block_avx512;
+#endif
+
+		default:
+			return &sum_block_scalar;
+	}
+}
+
+// Splits on the block boundary nearest the middle
+static size_t split_count(size_t count)
+{
+	const size_t block_count = (count + SUM_BLOCK_SIZE - 1) / SUM_BLOCK_SIZE;
+	return (block_count / 2) * SUM_BLOCK_SIZE;
+}
+
+static double sum_tree(sum_block_t sum_block, const float* values, size_t count)
+{
+	if (count <= SUM_BLOCK_SIZE)
+	{
+		return sum_block(values, count);
+	}
+	const size_t left_count = split_count(count);
+	return sum_tree(sum_block, values, left_count) + sum_tree(sum_block, values + left_count, count - left_count);
+}
+
+double sum_floats(const float* values, size_t count)
+{
+	return sum_tree(get_sum_block(), values, count);
+}
+
+// The whole tree is added up after every block as if the blocks after it
+// were zero; rounding can't make a sum with more in it any smaller
+static bool sum_tree_bounded(bounded_sum_t* walk, const float* values, size_t count, size_t depth, double* sum)
+{
+	if (count > SUM_BLOCK_SIZE)
+	{
+		const size_t left_count = split_count(count);
+		double left;
+		if (!sum_tree_bounded(walk, values, left_count, depth, &left))
+		{
+			*sum = left;
+			return false;
+		}
+		assert(depth < SUM_TREE_DEPTH);
+		walk->lefts[depth] = left;
+		double right;
+		if (!sum_tree_bounded(walk, values + left_count, count - left_count, depth + 1, &right))
+		{
+			*sum = right;
+			return false;
+		}
+		*sum = left + right;
+		return true;
+	}
+
+	*sum = walk->sum_block(values, count);
+	double partial = *sum;
+	for (size_t i = depth; i > 0; --i)
+	{
+		partial = walk->lefts[i - 1] + partial;
+	}
+	if (partial > walk->bound)
+	{
+		*sum = partial;
+		return false;
+	}
+	return true;
+}
+
+double sum_floats_bounded(const float* values, size_t count, double bound)
+{
+	bounded_sum_t walk;
+	walk.sum_block = get_sum_block();
+	walk.bound = bound;
+	double sum;
+	sum_tree_bounded(&walk, values, count, 0, &sum);
+	return sum;
+}
+
+// Subtrees at the task depth, in order
+static size_t gather_subtrees(const float* values, size_t count, int depth, sum_task_t* tasks, size_t task_count)
+{
+	if ((depth == 0) || (count <= SUM_BLOCK_SIZE))
+	{
+		assert(task_count < SUM_TASK_COUNT);
+		tasks[task_count].values = values;
+		tasks[task_count].count = count;
+		return task_count + 1;
+	}
+	const size_t left_count = split_count(count);
+	task_count = gather_subtrees(values, left_count, depth - 1, tasks, task_count);
+	return gather_subtrees(values + left_count, count - left_count, depth - 1, tasks, task_count);
+}
+
+// Adds the subtree sums back up the same tree
+static double combine_subtrees(size_t count, int depth, const sum_task_t* tasks, size_t* next)
+{
+	if ((depth == 0) || (count <= SUM_BLOCK_SIZE))
+	{
+		return tasks[(*next)++].sum;
+	}
+	const size_t left_count = split_count(count);
+	const double left = combine_subtrees(left_count, depth - 1, tasks, next);
+	return left + combine_subtrees(count - left_count, depth - 1, tasks, next);
+}
+
+static void sum_subtree(void* task_pointer)
+{
+	sum_task_t* task = (sum_task_t*)task_pointer;
+	task->sum = sum_tree(task->sum_block, task->values, task->count);
+}
+
+double sum_floats_parallel(thread_pool_t* pool, const float* values, size_t count)
+{
+	sum_task_t tasks[SUM_TASK_COUNT];
+	const size_t task_count = gather_subtrees(values, count, SUM_TASK_DEPTH, tasks, 0);
+	const sum_block_t sum_block = get_sum_block();
+	for (size_t i = 0; i < task_count; ++i)
+	{
+		tasks[i].sum_block = sum_block;
+	}
+	run_tasks(pool, &sum_subtree, tasks, sizeof(sum_task_t), task_count);
+
+	size_t next = 0;
+	return combine_subtrees(count, SUM_TASK_DEPTH, tasks, &next);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "thread_pool.h"
+#include <stddef.h>
+
+// Floats summed per leaf of the reduction tree
+#define SUM_BLOCK_SIZE 4096
+
+// Floats added by each block lane in turn; every instruction set uses the
+// same lanes in the same order, so results match bit for bit
+#define SUM_LANES 16
+
+typedef enum simd_level
+{
+	SIMD_SCALAR,
+	SIMD_SSE2,
+	SIMD_AVX2,
+	SIMD_AVX512,
+	SIMD_LEVEL_COUNT
+} simd_level_t;
+
+// Best instruction set the processor and OS support
+simd_level_t get_supported_simd_level(void);
+
+// Instruction set in use; requests past what is supported are clamped
+simd_level_t get_simd_level(void);
+void set_simd_level(simd_level_t level);
+const char* get_simd_level_name(simd_level_t level);
+
+// Sums in double precision: each block in SUM_LANES strided lanes, then the
+// lanes and blocks pairwise. The tree only depends on the count, so the
+// result is the same on every instruction set and however it is split.
+double sum_floats(const float* values, size_t count);
+
+// Same as sum_floats when the sum is at most the bound. Otherwise, as values
+// must not be negative, the blocks still unsummed can only add to it, so it
+// stops at the first block past the bound and returns a value between the
+// bound and the sum.
+double sum_floats_bounded(const float* values, size_t count, double bound);
+
+// Same result as sum_floats, with the top of the tree spread over the pool
+double sum_floats_parallel(thread_pool_t* pool, const float* values, size_t count);
@@ -0,0 +1,61 @@
+#include "resolution.h"
+#include "shared.h"
+#include <float.h>
+
+resolution_schedule_t create_resolution_schedule(size_t factor, bool refine)
+{
+	resolution_schedule_t result;
+	result.factor = (factor > 1 ? factor : 1);
+	result.refine = refine;
+	result.interval_best = DBL_MAX;
+	result.interval_start = 0;
+	return result;
+}
+
+size_t get_coarse_width(const resolution_schedule_t* schedule)
+{
+	const size_t width = APPLICATION_WIDTH / schedule->factor;
+	return (width > 0 ? width : 1);
+}
+
+size_t get_coarse_height(const resolution_schedule_t* schedule)
+{
+	const size_t height = APPLICATION_HEIGHT / schedule->factor;
+	return (height > 0 ? height : 1);
+}
+
+size_t get_promoted_count(void)
+{
+	const size_t promoted_count = FITTEST_COUNT * COARSE_PROMOTION_FACTOR;
+	return (promoted_count < CANDIDATE_COUNT ? promoted_count : CANDIDATE_COUNT);
+}
+
+bool update_resolution_schedule(resolution_schedule_t* schedule, int generation, double best_score)
+{
+	if (!schedule->refine || (schedule->factor == 1))
+	{
+		return false;
+	}
+	if (schedule->interval_best == DBL_MAX)
+	{
+		schedule->interval_best = best_score;
+		schedule->interval_start = generation;
+		return false;
+	}
+	if ((generation - schedule->interval_start) < REFINE_INTERVAL)
+	{
+		return false;
+	}
+
+	// Too small a drop in the best score over the interval, or a rise when
+	// coarse scores passed over the best, means the run stalled
+	const double improvement = (schedule->interval_best - best_score) / schedule->interval_best;
+	schedule->interval_best = best_score;
+	schedule->interval_start = generation;
+	if (improvement >= REFINE_THRESHOLD)
+	{
+		return false;
+	}
+	schedule->factor /= 2;
+	return true;
+}
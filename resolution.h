@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define COARSE_ARGUMENT "--coarse"
+#define REFINE_ARGUMENT "--refine"
+
+// Candidates rescored at full resolution for every survivor
+#define COARSE_PROMOTION_FACTOR 2
+
+// Generations between checks whether the run has converged enough to refine
+#define REFINE_INTERVAL 200
+
+// Least relative improvement of the best score over an interval that keeps
+// the working resolution where it is
+#define REFINE_THRESHOLD 0.002
+
+// Resolution candidates are first scored at, as a factor the output width
+// and height are divided by. The best few are then rescored at full
+// resolution. When refining, the factor halves whenever the run stalls at
+// the current one, until every candidate is scored at full resolution.
+typedef struct resolution_schedule
+{
+	size_t factor;
+	bool refine;
+
+	// Best score at the start of the current interval
+	double interval_best;
+	int interval_start;
+} resolution_schedule_t;
+
+// A factor of 1 scores every candidate at full resolution only
+resolution_schedule_t create_resolution_schedule(size_t factor, bool refine);
+
+// Output size of the coarse pass, never less than a pixel
+size_t get_coarse_width(const resolution_schedule_t* schedule);
+size_t get_coarse_height(const resolution_schedule_t* schedule);
+
+// Candidates the full resolution pass rescores after a coarse pass
+size_t get_promoted_count(void);
+
+// Takes the best score of the generation just sorted; returns true if the
+// working resolution went up
+bool update_resolution_schedule(resolution_schedule_t* schedule, int generation, double best_score);
@@ -1,4 +1,5 @@
 #include "shared.h"
+#include <math.h>
 #include <stdio.h>
 
 void pause()
@@ -7,3 +8,31 @@ void pause()
 	getchar();
 }
 
+void place_nails(vector2d_t* vertices)
+{
+#if USE_CIRCLE
+	const float CIRCLE_RADIUS = TEXTURE_HEIGHT * 0.5f;
+	const float PI = 3.1415926f;
+	const float CENTER_X = TEXTURE_WIDTH / 2.f;
+	const float CENTER_Y = TEXTURE_HEIGHT / 2.f;
+	for (size_t i = 0; i < (size_t)POINT_COUNT; ++i)
+	{
+		const float angle = 2.f * PI * ((float)i / POINT_COUNT);
+		const float x = CENTER_X + (CIRCLE_RADIUS * sinf(angle));
+		const float y = CENTER_Y + (CIRCLE_RADIUS * cosf(angle));
+		vertices[i] = vector2d(x, y);
+	}
+#else
+	vector2d_t* current_vertex = vertices;
+	for (size_t i = 0; i < (size_t)SQUARE_SIDE_POINTS; ++i)
+	{
+		const float factor = ((float)i / SQUARE_SIDE_POINTS);
+		const float x = TEXTURE_WIDTH * factor;
+		const float y = TEXTURE_HEIGHT * factor;
+		*current_vertex++ = vector2d(x, 0.f);
+		*current_vertex++ = vector2d(x, TEXTURE_HEIGHT);
+		*current_vertex++ = vector2d(0.f, y);
+		*current_vertex++ = vector2d(TEXTURE_WIDTH, y);
+	}
+#endif
+}
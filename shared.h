@@ -1,11 +1,21 @@
 #pragma once
 
-#define APPLICATION_WIDTH 1024
-#define APPLICATION_HEIGHT 1024
-#define APPLICATION_PIXEL_COUNT (APPLICATION_WIDTH * APPLICATION_HEIGHT)
-#define SCALE_FACTOR 2
+#include "config.h"
+#include "vector2d.h"
+#include <stddef.h>
+
+// Defaults for the settings in config.h
+#define DEFAULT_APPLICATION_WIDTH 1024
+#define DEFAULT_APPLICATION_HEIGHT 1024
+#define DEFAULT_SCALE_FACTOR 2
+#define DEFAULT_SAMPLE_RADIUS 2
+
+#define APPLICATION_WIDTH (config.application_width)
+#define APPLICATION_HEIGHT (config.application_height)
+#define APPLICATION_PIXEL_COUNT ((size_t)APPLICATION_WIDTH * (size_t)APPLICATION_HEIGHT)
+#define SCALE_FACTOR (config.scale_factor)
 #define LINE_WIDTH 2.f
-#define SAMPLE_RADIUS 2
+#define SAMPLE_RADIUS (config.sample_radius)
 #define TEXTURE_WIDTH (APPLICATION_WIDTH * SCALE_FACTOR)
 #define TEXTURE_HEIGHT (APPLICATION_HEIGHT * SCALE_FACTOR)
 
@@ -13,25 +23,39 @@
 #define USE_CIRCLE 1
 #if USE_CIRCLE
 	#define CIRCLE_POINTS 180
-	#define POINT_COUNT CIRCLE_POINTS
+	#define DEFAULT_POINT_COUNT CIRCLE_POINTS
 #else
-	#define SQUARE_SIDE_POINTS 100
 	#define SQUARE_SIDES 4
-	#define SQUARE_POINTS (SQUARE_SIDES * SQUARE_SIDE_POINTS)
-	#define POINT_COUNT SQUARE_POINTS
+	#define DEFAULT_POINT_COUNT (SQUARE_SIDES * 100)
+	#define SQUARE_SIDE_POINTS (POINT_COUNT / SQUARE_SIDES)
 #endif
+#define POINT_COUNT (config.point_count)
+
+// Every pair of nails has a chord table entry, so the table grows with the
+// square of this; it's well inside the 16 bits genomes store nails in
+#define MAXIMUM_POINT_COUNT 2048
 
 // Maximum number of lines per generation
-#define LINES 1000
-#define LINES_INDEX_COUNT (LINES * 2)
+#define DEFAULT_LINES 1000
+#define MAXIMUM_LINES (1 << 20)
+#define LINES (config.lines)
+#define LINES_INDEX_COUNT ((size_t)LINES * 2)
 
 #define LOG_FREQUENCY 100
 
 // Genetic algorithm
-#define FITTEST_COUNT 5
-#define OFFSPRING_PER_FITTEST 3
-#define CANDIDATE_COUNT (FITTEST_COUNT + (FITTEST_COUNT * OFFSPRING_PER_FITTEST))
+#define DEFAULT_FITTEST_COUNT 5
+#define DEFAULT_OFFSPRING_PER_FITTEST 3
+#define FITTEST_COUNT (config.fittest_count)
+#define OFFSPRING_PER_FITTEST (config.offspring_per_fittest)
+#define CANDIDATE_COUNT ((size_t)FITTEST_COUNT + ((size_t)FITTEST_COUNT * (size_t)OFFSPRING_PER_FITTEST))
+
+// Batches draw every candidate's chords in one call, which counts them in an
+// int, and give each candidate a texture array layer
+#define MAXIMUM_CANDIDATE_COUNT (1 << 16)
 #define LAST_CANDIDATE (CANDIDATE_COUNT - 1)
 
 void pause(void);
 
+// Positions of the nails in texture space, POINT_COUNT of them
+void place_nails(vector2d_t* vertices);
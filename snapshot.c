@@ -0,0 +1,294 @@
+#include "snapshot.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+#include <SDL_image.h>
+
+#define SNAPSHOT_IMAGE_FORMAT "%s-%06d.png"
+#define SNAPSHOT_RAW_FORMAT "%s-%06d.pgm"
+#define SNAPSHOT_GENOME_FORMAT "%s-%06d.genome"
+
+// Long enough for any name with any of the formats
+#define SNAPSHOT_FILENAME_LENGTH (SNAPSHOT_NAME_LENGTH + 32)
+
+// Greyscale expanded to 24-bit colour for PNG
+#define ENCODED_BYTES_PER_PIXEL 3
+
+static snapshot_frame_t null_snapshot_frame(void)
+{
+	snapshot_frame_t result;
+	result.name[0] = '\0';
+	result.keep = false;
+	result.generation = 0;
+	result.score = 0.0;
+	result.pixels = NULL;
+	result.nails = NULL;
+	result.nail_count = 0;
+	result.nail_capacity = 0;
+	return result;
+}
+
+static void destroy_snapshot_frame(snapshot_frame_t* frame)
+{
+	free(frame->pixels);
+	free(frame->nails);
+	*frame = null_snapshot_frame();
+}
+
+static void swap_snapshot_frames(snapshot_frame_t* first, snapshot_frame_t* second)
+{
+	const snapshot_frame_t swapped = *first;
+	*first = *second;
+	*second = swapped;
+}
+
+snapshot_writer_t null_snapshot_writer(void)
+{
+	snapshot_writer_t result;
+	result.width = 0;
+	result.height = 0;
+	result.raw = false;
+	result.started = false;
+	result.stopping = false;
+	for (size_t i = 0; i < SNAPSHOT_QUEUE_LENGTH; ++i)
+	{
+		result.queue[i] = null_snapshot_frame();
+	}
+	result.head = 0;
+	result.count = 0;
+	result.dropped = 0;
+	result.staged = null_snapshot_frame();
+	result.writing = null_snapshot_frame();
+	result.encoded = NULL;
+	return result;
+}
+
+static bool write_genome(const snapshot_frame_t* frame, const char* filename)
+{
+	FILE* file = fopen(filename, "w");
+	if (file == NULL)
+	{
+		return false;
+	}
+	bool success = (fprintf(file, "%.6f\n", frame->score) > 0);
+	for (size_t i = 0; success && (i < frame->nail_count); ++i)
+	{
+		success = (fprintf(file, (i + 1 < frame->nail_count ? "%u " : "%u\n"), (unsigned int)frame->nails[i]) > 0);
+	}
+	return (fclose(file) == 0) && success;
+}
+
+// Binary PGM, rows flipped to run from the top
+static bool write_raw_image(const snapshot_writer_t* writer, const snapshot_frame_t* frame, const char* filename)
+{
+	FILE* file = fopen(filename, "wb");
+	if (file == NULL)
+	{
+		return false;
+	}
+	const size_t width = (size_t)writer->width;
+	bool success = (fprintf(file, "P5\n%d %d\n255\n", writer->width, writer->height) > 0);
+	for (int y = writer->height - 1; success && (y >= 0); --y)
+	{
+		success = (fwrite(frame->pixels + ((size_t)y * width), 1, width, file) == width);
+	}
+	return (fclose(file) == 0) && success;
+}
+
+static bool write_png_image(snapshot_writer_t* writer, const snapshot_frame_t* frame, const char* filename)
+{
+	// Every channel is the same grey, so the masks' order doesn't matter
+	const size_t width = (size_t)writer->width;
+	const size_t height = (size_t)writer->height;
+	uint8_t* encoded = writer->encoded;
+	for (size_t y = 0; y < height; ++y)
+	{
+		const uint8_t* source = frame->pixels + ((height - 1 - y) * width);
+		uint8_t* row = encoded + (y * width * ENCODED_BYTES_PER_PIXEL);
+		for (size_t x = 0; x < width; ++x)
+		{
+			row[(x * ENCODED_BYTES_PER_PIXEL) + 0] = source[x];
+			row[(x * ENCODED_BYTES_PER_PIXEL) + 1] = source[x];
+			row[(x * ENCODED_BYTES_PER_PIXEL) + 2] = source[x];
+		}
+	}
+
+	SDL_Surface* surface = SDL_CreateRGBSurfaceFrom(encoded, writer->width, writer->height, 8 * ENCODED_BYTES_PER_PIXEL, writer->width * ENCODED_BYTES_PER_PIXEL, 0x0000FF, 0x00FF00, 0xFF0000, 0);
+	if (surface == NULL)
+	{
+		return false;
+	}
+	const bool success = (IMG_SavePNG(surface, filename) == 0);
+	SDL_FreeSurface(surface);
+	return success;
+}
+
+static void write_frame(snapshot_writer_t* writer, const snapshot_frame_t* frame)
+{
+	char filename[SNAPSHOT_FILENAME_LENGTH];
+	snprintf(filename, sizeof(filename), (writer->raw ? SNAPSHOT_RAW_FORMAT : SNAPSHOT_IMAGE_FORMAT), frame->name, frame->generation);
+	const bool image_written = (writer->raw ? write_raw_image(writer, frame, filename) : write_png_image(writer, frame, filename));
+	if (!image_written)
+	{
+		printf("Failed to write snapshot %s.\n", filename);
+	}
+
+	snprintf(filename, sizeof(filename), SNAPSHOT_GENOME_FORMAT, frame->name, frame->generation);
+	if (!write_genome(frame, filename))
+	{
+		printf("Failed to write snapshot %s.\n", filename);
+	}
+}
+
+static void run_snapshot_writer(void* writer_pointer)
+{
+	snapshot_writer_t* writer = (snapshot_writer_t*)writer_pointer;
+	lock_mutex(&writer->lock);
+	while (true)
+	{
+		while ((writer->count == 0) && !writer->stopping)
+		{
+			wait_condition(&writer->changed, &writer->lock);
+		}
+		if (writer->count == 0)
+		{
+			break;
+		}
+
+		// Take the oldest frame and leave its slot the buffers just written
+		swap_snapshot_frames(&writer->writing, &writer->queue[writer->head]);
+		writer->head = (writer->head + 1) % SNAPSHOT_QUEUE_LENGTH;
+		--writer->count;
+		broadcast_condition(&writer->changed);
+		unlock_mutex(&writer->lock);
+
+		write_frame(writer, &writer->writing);
+
+		lock_mutex(&writer->lock);
+	}
+	unlock_mutex(&writer->lock);
+}
+
+bool create_snapshot_writer(int width, int height, bool raw, snapshot_writer_t* out)
+{
+	*out = null_snapshot_writer();
+	if (!create_mutex(&out->lock))
+	{
+		printf("Failed to create snapshot lock.\n");
+		return false;
+	}
+	if (!create_condition(&out->changed))
+	{
+		destroy_mutex(&out->lock);
+		printf("Failed to create snapshot condition.\n");
+		return false;
+	}
+
+	// Locks exist from here, so destroying cleans up
+	out->width = width;
+	out->height = height;
+	out->raw = raw;
+
+	// Every image buffer is allocated up front; only nails grow
+	const size_t pixel_count = (size_t)width * (size_t)height;
+	bool allocated = true;
+	for (size_t i = 0; i < SNAPSHOT_QUEUE_LENGTH; ++i)
+	{
+		out->queue[i].pixels = (uint8_t*)malloc(pixel_count);
+		allocated = allocated && (out->queue[i].pixels != NULL);
+	}
+	out->staged.pixels = (uint8_t*)malloc(pixel_count);
+	out->writing.pixels = (uint8_t*)malloc(pixel_count);
+	out->encoded = (uint8_t*)malloc(raw ? 1 : pixel_count * ENCODED_BYTES_PER_PIXEL);
+	if (!allocated || (out->staged.pixels == NULL) || (out->writing.pixels == NULL) || (out->encoded == NULL))
+	{
+		printf("Failed to allocate snapshot frames.\n");
+		return false;
+	}
+
+	out->started = start_thread(&out->thread, &run_snapshot_writer, out);
+	if (!out->started)
+	{
+		printf("Failed to start snapshot writer.\n");
+		return false;
+	}
+	return true;
+}
+
+void destroy_snapshot_writer(snapshot_writer_t* writer)
+{
+	if (writer->width > 0)
+	{
+		if (writer->started)
+		{
+			lock_mutex(&writer->lock);
+			writer->stopping = true;
+			broadcast_condition(&writer->changed);
+			unlock_mutex(&writer->lock);
+			join_thread(&writer->thread);
+		}
+		destroy_condition(&writer->changed);
+		destroy_mutex(&writer->lock);
+		if (writer->dropped > 0)
+		{
+			printf("Snapshot writer dropped %d frames.\n", (int)writer->dropped);
+		}
+	}
+	for (size_t i = 0; i < SNAPSHOT_QUEUE_LENGTH; ++i)
+	{
+		destroy_snapshot_frame(&writer->queue[i]);
+	}
+	destroy_snapshot_frame(&writer->staged);
+	destroy_snapshot_frame(&writer->writing);
+	free(writer->encoded);
+	*writer = null_snapshot_writer();
+}
+
+bool stage_snapshot(snapshot_writer_t* writer, const char* name, bool keep, int generation, double score, const nail_t* nails, size_t nail_count)
+{
+	snapshot_frame_t* frame = &writer->staged;
+	if (nail_count > frame->nail_capacity)
+	{
+		nail_t* grown = (nail_t*)realloc(frame->nails, nail_count * sizeof(nail_t));
+		if (grown == NULL)
+		{
+			printf("Failed to allocate snapshot nails.\n");
+			return false;
+		}
+		frame->nails = grown;
+		frame->nail_capacity = nail_count;
+	}
+	memcpy(frame->nails, nails, nail_count * sizeof(nail_t));
+	frame->nail_count = nail_count;
+	snprintf(frame->name, sizeof(frame->name), "%s", name);
+	frame->keep = keep;
+	frame->generation = generation;
+	frame->score = score;
+	return true;
+}
+
+bool submit_snapshot(snapshot_writer_t* writer, const uint8_t* pixels)
+{
+	// Copied before taking the lock, so the writer thread never waits on it
+	memcpy(writer->staged.pixels, pixels, (size_t)writer->width * (size_t)writer->height);
+	lock_mutex(&writer->lock);
+	while (writer->staged.keep && (writer->count == SNAPSHOT_QUEUE_LENGTH))
+	{
+		wait_condition(&writer->changed, &writer->lock);
+	}
+	const bool queued = (writer->count < SNAPSHOT_QUEUE_LENGTH);
+	if (queued)
+	{
+		const size_t tail = (writer->head + writer->count) % SNAPSHOT_QUEUE_LENGTH;
+		swap_snapshot_frames(&writer->staged, &writer->queue[tail]);
+		++writer->count;
+		broadcast_condition(&writer->changed);
+	}
+	else
+	{
+		++writer->dropped;
+	}
+	unlock_mutex(&writer->lock);
+	return queued;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "genome.h"
+#include "thread.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SNAPSHOT_INTERVAL_ARGUMENT "--snapshot-interval"
+#define SNAPSHOT_RAW_ARGUMENT "--snapshot-raw"
+
+// Frames waiting to be written; frames submitted while it's full are dropped
+#define SNAPSHOT_QUEUE_LENGTH 4
+
+// Files are named after the frame and its generation
+#define SNAPSHOT_NAME "snapshot"
+#define SNAPSHOT_NAME_LENGTH 256
+
+// Best candidate of one generation: its lines as drawn, in greyscale rows
+// from the bottom up as GL reads them, and its nails
+typedef struct snapshot_frame
+{
+	char name[SNAPSHOT_NAME_LENGTH];
+	bool keep;
+	int generation;
+	double score;
+	uint8_t* pixels;
+	nail_t* nails;
+	size_t nail_count;
+	size_t nail_capacity;
+} snapshot_frame_t;
+
+// Writes numbered frames of the search on its own thread, so the search
+// never waits on encoding or the disk. Each frame is an image, PNG or raw
+// PGM, and a text file of the score and nails.
+typedef struct snapshot_writer
+{
+	int width;
+	int height;
+	bool raw;
+
+	thread_t thread;
+	bool started;
+	mutex_t lock;
+	condition_t changed;
+	bool stopping;
+
+	// Ring of frames waiting for the writer thread
+	snapshot_frame_t queue[SNAPSHOT_QUEUE_LENGTH];
+	size_t head;
+	size_t count;
+	size_t dropped;
+
+	// Frame filled by the caller until submitted, and the frame being
+	// written; both swap buffers with queue entries rather than copy
+	snapshot_frame_t staged;
+	snapshot_frame_t writing;
+	uint8_t* encoded;
+} snapshot_writer_t;
+
+snapshot_writer_t null_snapshot_writer(void);
+
+// Frames are width by height pixels; raw frames skip PNG compression
+bool create_snapshot_writer(int width, int height, bool raw, snapshot_writer_t* out);
+
+// Writes every frame still queued before stopping
+void destroy_snapshot_writer(snapshot_writer_t* writer);
+
+// Copies the candidate's nails into the staged frame, for the image that
+// is read back after. Frames to keep are never dropped.
+bool stage_snapshot(snapshot_writer_t* writer, const char* name, bool keep, int generation, double score, const nail_t* nails, size_t nail_count);
+
+// Queues the staged frame with its image. If the queue is full, frames to
+// keep wait for room; others are dropped, returning false without waiting.
+bool submit_snapshot(snapshot_writer_t* writer, const uint8_t* pixels);
@@ -0,0 +1,1223 @@
+#include "software_renderer.h"
+#include "blur.h"
+#include "reduce.h"
+#include "shared.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define X86_SOFTWARE 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define TARGET(isa)
+#else
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+#else
+#define X86_SOFTWARE 0
+#endif
+
+// Must match line.fragment
+#define LINE_DARKNESS 0.05f
+
+// Must match texture.fragment and batch_texture.fragment
+#define OVERSHOOT_WEIGHT 0.75f
+
+#if defined(_MSC_VER)
+#define FORCE_INLINE __forceinline
+#else
+#define FORCE_INLINE inline __attribute__((always_inline))
+#endif
+
+#define CANVAS_PIXEL_COUNT ((size_t)TEXTURE_WIDTH * (size_t)TEXTURE_HEIGHT)
+
+// Output pixel flags while scoring a mutation
+#define DOWNSAMPLED_CHANGED 0x1
+#define ERROR_AFFECTED 0x2
+
+typedef struct software_band
+{
+	software_renderer_t* renderer;
+	const nail_t* nails;
+	size_t nail_count;
+	software_state_t* state;
+	size_t row_begin;
+	size_t row_end;
+	float* down_row;
+	float* blurred_row;
+	chord_buffer_t chord_buffer;
+} software_band_t;
+
+static double evaluate_mutation_power_of_two(software_renderer_t* renderer, const software_state_t* parent, const mutation_t* mutation, software_state_t* out);
+static double evaluate_mutation_generic(software_renderer_t* renderer, const software_state_t* parent, const mutation_t* mutation, software_state_t* out);
+
+software_state_t null_software_state(void)
+{
+	software_state_t result;
+	result.log_transmittance = NULL;
+	result.opaque_count = NULL;
+	result.downsampled = NULL;
+	result.error = NULL;
+	result.score = 0.0;
+	return result;
+}
+
+bool create_software_state(software_state_t* out)
+{
+	out->log_transmittance = (float*)malloc(CANVAS_PIXEL_COUNT * sizeof(float));
+	out->opaque_count = (uint16_t*)malloc(CANVAS_PIXEL_COUNT * sizeof(uint16_t));
+	out->downsampled = (float*)malloc(APPLICATION_PIXEL_COUNT * sizeof(float));
+	out->error = (float*)malloc(APPLICATION_PIXEL_COUNT * sizeof(float));
+	out->score = 0.0;
+	return (out->log_transmittance != NULL) && (out->opaque_count != NULL) && (out->downsampled != NULL) && (out->error != NULL);
+}
+
+void destroy_software_state(software_state_t* state)
+{
+	free(state->log_transmittance);
+	free(state->opaque_count);
+	free(state->downsampled);
+	free(state->error);
+	*state = null_software_state();
+}
+
+static size_t get_software_state_size(void)
+{
+	return ALIGN_ARENA(CANVAS_PIXEL_COUNT * sizeof(float))
+		+ ALIGN_ARENA(CANVAS_PIXEL_COUNT * sizeof(uint16_t))
+		+ (2 * ALIGN_ARENA(APPLICATION_PIXEL_COUNT * sizeof(float)));
+}
+
+// State whose buffers belong to the arena, so it is never destroyed alone
+static bool carve_software_state(arena_t* arena, software_state_t* out)
+{
+	out->log_transmittance = (float*)allocate_arena(arena, CANVAS_PIXEL_COUNT * sizeof(float));
+	out->opaque_count = (uint16_t*)allocate_arena(arena, CANVAS_PIXEL_COUNT * sizeof(uint16_t));
+	out->downsampled = (float*)allocate_arena(arena, APPLICATION_PIXEL_COUNT * sizeof(float));
+	out->error = (float*)allocate_arena(arena, APPLICATION_PIXEL_COUNT * sizeof(float));
+	out->score = 0.0;
+	return (out->log_transmittance != NULL) && (out->opaque_count != NULL) && (out->downsampled != NULL) && (out->error != NULL);
+}
+
+static void copy_software_state(const software_state_t* source, software_state_t* destination)
+{
+	memcpy(destination->log_transmittance, source->log_transmittance, CANVAS_PIXEL_COUNT * sizeof(float));
+	memcpy(destination->opaque_count, source->opaque_count, CANVAS_PIXEL_COUNT * sizeof(uint16_t));
+	memcpy(destination->downsampled, source->downsampled, APPLICATION_PIXEL_COUNT * sizeof(float));
+	memcpy(destination->error, source->error, APPLICATION_PIXEL_COUNT * sizeof(float));
+	destination->score = source->score;
+}
+
+static software_scratch_t null_software_scratch(void)
+{
+	software_scratch_t result;
+	result.delta_log = NULL;
+	result.delta_opaque = NULL;
+	result.canvas_touched = NULL;
+	result.canvas_list = NULL;
+	result.canvas_count = 0;
+	result.downsampled = NULL;
+	result.output_flags = NULL;
+	result.downsampled_list = NULL;
+	result.downsampled_count = 0;
+	result.error_list = NULL;
+	result.error_count = 0;
+	result.chord_buffer = null_chord_buffer();
+	return result;
+}
+
+static size_t get_software_scratch_size(void)
+{
+	return ALIGN_ARENA(CANVAS_PIXEL_COUNT * sizeof(float))
+		+ ALIGN_ARENA(CANVAS_PIXEL_COUNT * sizeof(int16_t))
+		+ ALIGN_ARENA(CANVAS_PIXEL_COUNT * sizeof(uint8_t))
+		+ ALIGN_ARENA(CANVAS_PIXEL_COUNT * sizeof(uint32_t))
+		+ ALIGN_ARENA(APPLICATION_PIXEL_COUNT * sizeof(float))
+		+ ALIGN_ARENA(APPLICATION_PIXEL_COUNT * sizeof(uint8_t))
+		+ (2 * ALIGN_ARENA(APPLICATION_PIXEL_COUNT * sizeof(uint32_t)));
+}
+
+// Flags start cleared, as arena memory is zeroed
+static bool create_software_scratch(arena_t* arena, software_scratch_t* out)
+{
+	out->delta_log = (float*)allocate_arena(arena, CANVAS_PIXEL_COUNT * sizeof(float));
+	out->delta_opaque = (int16_t*)allocate_arena(arena, CANVAS_PIXEL_COUNT * sizeof(int16_t));
+	out->canvas_touched = (uint8_t*)allocate_arena(arena, CANVAS_PIXEL_COUNT * sizeof(uint8_t));
+	out->canvas_list = (uint32_t*)allocate_arena(arena, CANVAS_PIXEL_COUNT * sizeof(uint32_t));
+	out->downsampled = (float*)allocate_arena(arena, APPLICATION_PIXEL_COUNT * sizeof(float));
+	out->output_flags = (uint8_t*)allocate_arena(arena, APPLICATION_PIXEL_COUNT * sizeof(uint8_t));
+	out->downsampled_list = (uint32_t*)allocate_arena(arena, APPLICATION_PIXEL_COUNT * sizeof(uint32_t));
+	out->error_list = (uint32_t*)allocate_arena(arena, APPLICATION_PIXEL_COUNT * sizeof(uint32_t));
+	return (out->delta_log != NULL) && (out->delta_opaque != NULL) && (out->canvas_touched != NULL) && (out->canvas_list != NULL)
+		&& (out->downsampled != NULL) && (out->output_flags != NULL) && (out->downsampled_list != NULL) && (out->error_list != NULL);
+}
+
+// Buffers go with the arena; only the chord buffer grows on its own
+static void destroy_software_scratch(software_scratch_t* scratch)
+{
+	destroy_chord_buffer(&scratch->chord_buffer);
+	*scratch = null_software_scratch();
+}
+
+static bool is_power_of_two(uint32_t value)
+{
+	return (value != 0) && ((value & (value - 1)) == 0);
+}
+
+static uint32_t log2_floor(uint32_t value)
+{
+	uint32_t result = 0;
+	while ((value >>= 1) != 0)
+	{
+		++result;
+	}
+	return result;
+}
+
+static software_layout_t create_software_layout(void)
+{
+	software_layout_t result;
+	result.width = (uint32_t)APPLICATION_WIDTH;
+	result.height = (uint32_t)APPLICATION_HEIGHT;
+	result.scale = (uint32_t)SCALE_FACTOR;
+	result.canvas_width = (uint32_t)TEXTURE_WIDTH;
+	result.width_shift = log2_floor(result.width);
+	result.scale_shift = log2_floor(result.scale);
+	result.canvas_width_shift = log2_floor(result.canvas_width);
+	result.power_of_two = is_power_of_two(result.width) && is_power_of_two(result.height) && is_power_of_two(result.scale);
+	return result;
+}
+
+software_renderer_t null_software_renderer(void)
+{
+	software_renderer_t result;
+	result.vertices = NULL;
+	result.vertex_count = 0;
+	result.target = NULL;
+	result.kernel = NULL;
+	result.kernel_radius = 0;
+	result.chord_cache = null_chord_cache();
+	result.state = null_software_state();
+	result.states = NULL;
+	result.state_used = NULL;
+	result.scratches = NULL;
+	result.scratch_count = 0;
+	result.jobs = NULL;
+	result.layout = create_software_layout();
+	result.evaluate_mutation = NULL;
+	result.pool = NULL;
+	result.serial = false;
+	result.band_count = 0;
+	result.bands = NULL;
+	result.arena = null_arena();
+	result.owns_tables = true;
+	return result;
+}
+
+static int wrap_index(int value, int size)
+{
+	const int wrapped = value % size;
+	return (wrapped < 0 ? wrapped + size : wrapped);
+}
+
+// Helpers for the resolution-specialized kernels; power_of_two is a constant
+// in each specialization, so the other branch folds away
+static FORCE_INLINE uint32_t wrap_layout(int value, uint32_t size, bool power_of_two)
+{
+	return (power_of_two ? ((uint32_t)value & (size - 1)) : (uint32_t)wrap_index(value, (int)size));
+}
+
+static FORCE_INLINE uint32_t divide_layout(uint32_t value, uint32_t divisor, uint32_t shift, bool power_of_two)
+{
+	return (power_of_two ? (value >> shift) : (value / divisor));
+}
+
+static FORCE_INLINE uint32_t modulo_layout(uint32_t value, uint32_t divisor, bool power_of_two)
+{
+	return (power_of_two ? (value & (divisor - 1)) : (value % divisor));
+}
+
+// The GL passes' kernel at output resolution, where the box filter has
+// already averaged the texels under each pixel. Output pixels are square, so
+// the same weights blur down and across.
+static bool create_kernel(software_renderer_t* renderer)
+{
+	const blur_kernel_t blur = create_blur_kernel(1.f, get_blur_sigma(SAMPLE_RADIUS) / (float)SCALE_FACTOR);
+	const int kernel_radius = get_blur_kernel_radius(&blur);
+	float* kernel = (float*)malloc((size_t)((2 * kernel_radius) + 1) * sizeof(float));
+	if (kernel == NULL)
+	{
+		return false;
+	}
+	expand_blur_kernel(&blur, kernel_radius, kernel);
+
+	renderer->kernel = kernel;
+	renderer->kernel_radius = kernel_radius;
+	return true;
+}
+
+// Split output rows evenly between workers
+static size_t get_band_count(const software_renderer_t* renderer)
+{
+	const size_t band_count = (renderer->serial ? 1 : get_worker_count(renderer->pool));
+	return (band_count > (size_t)APPLICATION_HEIGHT ? (size_t)APPLICATION_HEIGHT : band_count);
+}
+
+static bool create_software_bands(software_renderer_t* out)
+{
+	const size_t band_count = get_band_count(out);
+	out->bands = (software_band_t*)calloc(band_count, sizeof(software_band_t));
+	if (out->bands == NULL)
+	{
+		destroy_software_renderer(out);
+		printf("Failed to allocate software render bands.\n");
+		return false;
+	}
+	out->band_count = band_count;
+	for (size_t i = 0; i < band_count; ++i)
+	{
+		software_band_t* band = &out->bands[i];
+		band->renderer = out;
+		band->row_begin = (i * APPLICATION_HEIGHT) / band_count;
+		band->row_end = ((i + 1) * APPLICATION_HEIGHT) / band_count;
+		band->chord_buffer = null_chord_buffer();
+		band->down_row = (float*)allocate_arena(&out->arena, APPLICATION_WIDTH * sizeof(float));
+		band->blurred_row = (float*)allocate_arena(&out->arena, APPLICATION_WIDTH * sizeof(float));
+		if ((band->down_row == NULL) || (band->blurred_row == NULL))
+		{
+			destroy_software_renderer(out);
+			printf("Failed to allocate software render band.\n");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Render states, band rows and, for the renderer owning the tables, worker
+// scratch, carved from one arena. Survivor states are only kept in
+// incremental mode.
+static bool create_software_slots(software_renderer_t* out, bool incremental, bool huge_pages)
+{
+	const size_t state_count = (incremental ? SOFTWARE_STATE_COUNT : 0);
+	const size_t scratch_count = ((incremental && out->owns_tables) ? get_worker_count(out->pool) : 0);
+	const size_t capacity = ((1 + state_count) * get_software_state_size())
+		+ (scratch_count * get_software_scratch_size())
+		+ (get_band_count(out) * 2 * ALIGN_ARENA(APPLICATION_WIDTH * sizeof(float)));
+	if (!create_arena(capacity, huge_pages, &out->arena) || !carve_software_state(&out->arena, &out->state))
+	{
+		return false;
+	}
+
+	out->states = (software_state_t*)malloc(SOFTWARE_STATE_COUNT * sizeof(software_state_t));
+	if (out->states == NULL)
+	{
+		return false;
+	}
+	for (size_t i = 0; i < SOFTWARE_STATE_COUNT; ++i)
+	{
+		out->states[i] = null_software_state();
+		if ((i < state_count) && !carve_software_state(&out->arena, &out->states[i]))
+		{
+			return false;
+		}
+	}
+	out->state_used = (bool*)calloc(SOFTWARE_STATE_COUNT, sizeof(bool));
+	out->jobs = (software_job_t*)malloc(CANDIDATE_COUNT * sizeof(software_job_t));
+	if ((out->state_used == NULL) || (out->jobs == NULL))
+	{
+		return false;
+	}
+
+	if (scratch_count > 0)
+	{
+		out->scratches = (software_scratch_t*)malloc(scratch_count * sizeof(software_scratch_t));
+		if (out->scratches == NULL)
+		{
+			return false;
+		}
+		for (size_t i = 0; i < scratch_count; ++i)
+		{
+			out->scratches[i] = null_software_scratch();
+		}
+		out->scratch_count = scratch_count;
+		for (size_t i = 0; i < scratch_count; ++i)
+		{
+			if (!create_software_scratch(&out->arena, &out->scratches[i]))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool create_software_renderer
+(
+	const vector2d_t* vertices,
+	size_t vertex_count,
+	const image_t* target_image,
+	bool incremental,
+	bool huge_pages,
+	thread_pool_t* pool,
+	software_renderer_t* out
+)
+{
+	out->pool = pool;
+	out->layout = create_software_layout();
+	out->evaluate_mutation = (out->layout.power_of_two ? &evaluate_mutation_power_of_two : &evaluate_mutation_generic);
+
+	// Flip into frame buffer row order so the canvas lines up with the GL path
+	vector2d_t* canvas_vertices = (vector2d_t*)malloc(vertex_count * sizeof(vector2d_t));
+	if (canvas_vertices == NULL)
+	{
+		printf("Failed to allocate software renderer vertices.\n");
+		return false;
+	}
+	for (size_t i = 0; i < vertex_count; ++i)
+	{
+		canvas_vertices[i] = vector2d(vertices[i].x, (float)TEXTURE_HEIGHT - vertices[i].y);
+	}
+	out->vertices = canvas_vertices;
+	out->vertex_count = vertex_count;
+
+	out->target = (float*)malloc(APPLICATION_PIXEL_COUNT * sizeof(float));
+	if ((out->target == NULL) || !create_software_slots(out, incremental, huge_pages))
+	{
+		destroy_software_renderer(out);
+		printf("Failed to allocate software render targets.\n");
+		return false;
+	}
+
+	// Sample the target the same way the GL path does at each output pixel
+	float* current_target = out->target;
+	for (size_t row = 0; row < (size_t)APPLICATION_HEIGHT; ++row)
+	{
+		const float v = ((float)row + 0.5f) / (float)APPLICATION_HEIGHT;
+		for (size_t column = 0; column < (size_t)APPLICATION_WIDTH; ++column)
+		{
+			const float u = ((float)column + 0.5f) / (float)APPLICATION_WIDTH;
+			*current_target++ = sample_image(target_image, u, v);
+		}
+	}
+
+	if (!create_kernel(out))
+	{
+		destroy_software_renderer(out);
+		printf("Failed to create software blur kernel.\n");
+		return false;
+	}
+
+	// Footprints cover everything the blur can spread a chord into
+	if (!create_chord_cache(out->vertices, vertex_count, out->kernel_radius, CHORD_CACHE_BUDGET, CHORD_CACHE_FILENAME, pool, &out->chord_cache))
+	{
+		destroy_software_renderer(out);
+		printf("Failed to create chord cache.\n");
+		return false;
+	}
+
+	return create_software_bands(out);
+}
+
+bool share_software_renderer(const software_renderer_t* source, bool serial, software_renderer_t* out)
+{
+	// Tables are only read, and each scratch is only used by its own worker
+	out->vertices = source->vertices;
+	out->vertex_count = source->vertex_count;
+	out->target = source->target;
+	out->kernel = source->kernel;
+	out->kernel_radius = source->kernel_radius;
+	out->chord_cache = source->chord_cache;
+	out->scratches = source->scratches;
+	out->scratch_count = source->scratch_count;
+	out->layout = source->layout;
+	out->evaluate_mutation = source->evaluate_mutation;
+	out->pool = source->pool;
+	out->serial = serial;
+	out->owns_tables = false;
+	if (!create_software_slots(out, (source->scratch_count > 0), source->arena.huge_pages))
+	{
+		destroy_software_renderer(out);
+		printf("Failed to allocate software render targets.\n");
+		return false;
+	}
+	return create_software_bands(out);
+}
+
+void destroy_software_renderer(software_renderer_t* renderer)
+{
+	software_band_t* bands = renderer->bands;
+	if (bands != NULL)
+	{
+		for (size_t i = 0; i < renderer->band_count; ++i)
+		{
+			destroy_chord_buffer(&bands[i].chord_buffer);
+		}
+		free(bands);
+		renderer->bands = NULL;
+	}
+	renderer->band_count = 0;
+
+	free(renderer->states);
+	renderer->states = NULL;
+	free(renderer->state_used);
+	renderer->state_used = NULL;
+	free(renderer->jobs);
+	renderer->jobs = NULL;
+	renderer->state = null_software_state();
+
+	// Shared tables belong to the renderer they came from
+	if (renderer->owns_tables)
+	{
+		for (size_t i = 0; i < renderer->scratch_count; ++i)
+		{
+			destroy_software_scratch(&renderer->scratches[i]);
+		}
+		free(renderer->scratches);
+		destroy_chord_cache(&renderer->chord_cache);
+		free(renderer->kernel);
+		free(renderer->target);
+		free(renderer->vertices);
+	}
+	renderer->scratches = NULL;
+	renderer->scratch_count = 0;
+	renderer->chord_cache = null_chord_cache();
+	renderer->kernel = NULL;
+	renderer->kernel_radius = 0;
+	renderer->target = NULL;
+	renderer->vertices = NULL;
+	renderer->vertex_count = 0;
+
+	// Scratch shared with other renderers lives here too, so this goes last
+	destroy_arena(&renderer->arena);
+	renderer->owns_tables = true;
+}
+
+// Source-alpha blending of every line over white leaves
+// darkness + (1 - darkness) * product(1 - coverage)
+static float canvas_lightness(float log_transmittance, int opaque_count)
+{
+	if (opaque_count > 0)
+	{
+		return LINE_DARKNESS;
+	}
+	return LINE_DARKNESS + ((1.f - LINE_DARKNESS) * expf(log_transmittance));
+}
+
+// Equivalent of sampling the mip level matching the output resolution. The
+// scratch deltas are applied on top of the state when given.
+static FORCE_INLINE float downsample_pixel
+(
+	const software_layout_t* layout,
+	const software_state_t* state,
+	const software_scratch_t* scratch,
+	size_t row,
+	size_t column
+)
+{
+	const size_t scale = layout->scale;
+	const float inverse_area = 1.f / (float)(scale * scale);
+	float sum = 0.f;
+	for (size_t y = 0; y < scale; ++y)
+	{
+		const size_t canvas_row = (row * scale) + y;
+		float row_sum = 0.f;
+		for (size_t x = 0; x < scale; ++x)
+		{
+			const size_t index = (canvas_row * layout->canvas_width) + (column * scale) + x;
+			float log_transmittance = state->log_transmittance[index];
+			int opaque_count = (int)state->opaque_count[index];
+			if ((scratch != NULL) && scratch->canvas_touched[index])
+			{
+				log_transmittance += scratch->delta_log[index];
+				opaque_count += (int)scratch->delta_opaque[index];
+			}
+			row_sum += canvas_lightness(log_transmittance, opaque_count);
+		}
+		sum += row_sum;
+	}
+	return sum * inverse_area;
+}
+
+// Weigh over-shooting the darkness less
+static float pixel_error(float blurred, float target)
+{
+	const float delta = blurred - target;
+	const float overshoot = -delta * OVERSHOOT_WEIGHT;
+	return (delta < 0.f ? overshoot * overshoot : delta);
+}
+
+// Row kernels of the full render. Every instruction set does the same
+// operations on each pixel, so results match bit for bit, and match
+// blur_pixel and pixel_error in the incremental path.
+typedef void (*accumulate_row_t)(float* row, const float* source, float weight, size_t count);
+typedef void (*error_row_t)(float* error, const float* blurred, const float* target, size_t count);
+
+static void accumulate_row_scalar(float* row, const float* source, float weight, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		row[i] += weight * source[i];
+	}
+}
+
+static void error_row_scalar(float* error, const float* blurred, const float* target, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		error[i] = pixel_error(blurred[i], target[i]);
+	}
+}
+
+#if X86_SOFTWARE
+TARGET("sse2")
+static void accumulate_row_sse2(float* row, const float* source, float weight, size_t count)
+{
+	const __m128 weights = _mm_set1_ps(weight);
+	const size_t whole_count = count - (count % 8);
+	for (size_t i = 0; i < whole_count; i += 8)
+	{
+		const __m128 source0 = _mm_loadu_ps(source + i);
+		const __m128 source1 = _mm_loadu_ps(source + i + 4);
+		_mm_storeu_ps(row + i, _mm_add_ps(_mm_loadu_ps(row + i), _mm_mul_ps(weights, source0)));
+		_mm_storeu_ps(row + i + 4, _mm_add_ps(_mm_loadu_ps(row + i + 4), _mm_mul_ps(weights, source1)));
+	}
+	accumulate_row_scalar(row + whole_count, source + whole_count, weight, count - whole_count);
+}
+
+TARGET("avx2")
+static void accumulate_row_avx2(float* row, const float* source, float weight, size_t count)
+{
+	const __m256 weights = _mm256_set1_ps(weight);
+	const size_t whole_count = count - (count % 16);
+	for (size_t i = 0; i < whole_count; i += 16)
+	{
+		const __m256 source0 = _mm256_loadu_ps(source + i);
+		const __m256 source1 = _mm256_loadu_ps(source + i + 8);
+		_mm256_storeu_ps(row + i, _mm256_add_ps(_mm256_loadu_ps(row + i), _mm256_mul_ps(weights, source0)));
+		_mm256_storeu_ps(row + i + 8, _mm256_add_ps(_mm256_loadu_ps(row + i + 8), _mm256_mul_ps(weights, source1)));
+	}
+	accumulate_row_scalar(row + whole_count, source + whole_count, weight, count - whole_count);
+}
+
+// Both branches of pixel_error, with the one the sign picks kept
+TARGET("sse2")
+static void error_row_sse2(float* error, const float* blurred, const float* target, size_t count)
+{
+	const __m128 sign = _mm_set1_ps(-0.f);
+	const __m128 weight = _mm_set1_ps(OVERSHOOT_WEIGHT);
+	const __m128 zero = _mm_setzero_ps();
+	const size_t whole_count = count - (count % 4);
+	for (size_t i = 0; i < whole_count; i += 4)
+	{
+		const __m128 delta = _mm_sub_ps(_mm_loadu_ps(blurred + i), _mm_loadu_ps(target + i));
+		const __m128 overshoot = _mm_mul_ps(_mm_xor_ps(delta, sign), weight);
+		const __m128 under = _mm_cmplt_ps(delta, zero);
+		const __m128 squared = _mm_mul_ps(overshoot, overshoot);
+		_mm_storeu_ps(error + i, _mm_or_ps(_mm_and_ps(under, squared), _mm_andnot_ps(under, delta)));
+	}
+	error_row_scalar(error + whole_count, blurred + whole_count, target + whole_count, count - whole_count);
+}
+
+TARGET("avx2")
+static void error_row_avx2(float* error, const float* blurred, const float* target, size_t count)
+{
+	const __m256 sign = _mm256_set1_ps(-0.f);
+	const __m256 weight = _mm256_set1_ps(OVERSHOOT_WEIGHT);
+	const __m256 zero = _mm256_setzero_ps();
+	const size_t whole_count = count - (count % 8);
+	for (size_t i = 0; i < whole_count; i += 8)
+	{
+		const __m256 delta = _mm256_sub_ps(_mm256_loadu_ps(blurred + i), _mm256_loadu_ps(target + i));
+		const __m256 overshoot = _mm256_mul_ps(_mm256_xor_ps(delta, sign), weight);
+		const __m256 under = _mm256_cmp_ps(delta, zero, _CMP_LT_OQ);
+		const __m256 squared = _mm256_mul_ps(overshoot, overshoot);
+		_mm256_storeu_ps(error + i, _mm256_blendv_ps(delta, squared, under));
+	}
+	error_row_scalar(error + whole_count, blurred + whole_count, target + whole_count, count - whole_count);
+}
+#endif
+
+static accumulate_row_t get_accumulate_row(void)
+{
+	switch (get_simd_level())
+	{
+#if X86_SOFTWARE
+		case SIMD_SSE2:
+			return &accumulate_row_sse2;
+
+		case SIMD_AVX2:
+		case SIMD_AVX512:
+			return &accumulate_row_avx2;
+#endif
+
+		default:
+			return &accumulate_row_scalar;
+	}
+}
+
+static error_row_t get_error_row(void)
+{
+	switch (get_simd_level())
+	{
+#if X86_SOFTWARE
+		case SIMD_SSE2:
+			return &error_row_sse2;
+
+		case SIMD_AVX2:
+		case SIMD_AVX512:
+			return &error_row_avx2;
+#endif
+
+		default:
+			return &error_row_scalar;
+	}
+}
+
+// Clears, draws and box-filters one band of rows
+static void rasterize_band(void* band_pointer)
+{
+	software_band_t* band = (software_band_t*)band_pointer;
+	const software_renderer_t* renderer = band->renderer;
+	software_state_t* state = band->state;
+	const int canvas_row_begin = (int)(band->row_begin * SCALE_FACTOR);
+	const int canvas_row_end = (int)(band->row_end * SCALE_FACTOR);
+
+	const size_t band_offset = (size_t)canvas_row_begin * TEXTURE_WIDTH;
+	const size_t band_pixel_count = (size_t)(canvas_row_end - canvas_row_begin) * TEXTURE_WIDTH;
+	memset(state->log_transmittance + band_offset, 0, band_pixel_count * sizeof(float));
+	memset(state->opaque_count + band_offset, 0, band_pixel_count * sizeof(uint16_t));
+
+	// Line strip through the nails
+	const chord_cache_t* chord_cache = &renderer->chord_cache;
+	const nail_t* nails = band->nails;
+	const size_t nail_count = band->nail_count;
+	for (size_t i = 1; i < nail_count; ++i)
+	{
+		chord_view_t chord;
+		if (!get_chord(chord_cache, nails[i - 1], nails[i], canvas_row_begin, canvas_row_end, &band->chord_buffer, &chord))
+		{
+			continue;
+		}
+
+		// Spans are sorted by row; skip to the first in this band
+		size_t low = 0;
+		size_t high = chord.span_count;
+		while (low < high)
+		{
+			const size_t middle = (low + high) / 2;
+			if ((int)chord.spans[middle].row < canvas_row_begin)
+			{
+				low = middle + 1;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+		const uint8_t* coverage = chord.coverage;
+		for (size_t j = 0; j < low; ++j)
+		{
+			coverage += chord.spans[j].length;
+		}
+
+		for (size_t j = low; (j < chord.span_count) && ((int)chord.spans[j].row < canvas_row_end); ++j)
+		{
+			const chord_span_t* span = &chord.spans[j];
+			const size_t offset = ((size_t)span->row * TEXTURE_WIDTH) + span->column;
+			float* log_transmittance = state->log_transmittance + offset;
+			uint16_t* opaque_count = state->opaque_count + offset;
+			for (size_t k = 0; k < span->length; ++k)
+			{
+				const uint8_t level = coverage[k];
+				if (level == OPAQUE_COVERAGE)
+				{
+					++opaque_count[k];
+				}
+				else
+				{
+					log_transmittance[k] += chord_cache->log_transmittance[level];
+				}
+			}
+			coverage += span->length;
+		}
+	}
+
+	const software_layout_t* layout = &renderer->layout;
+	for (size_t row = band->row_begin; row < band->row_end; ++row)
+	{
+		float* output = state->downsampled + (row * layout->width);
+		for (size_t column = 0; column < layout->width; ++column)
+		{
+			output[column] = downsample_pixel(layout, state, NULL, row, column);
+		}
+	}
+}
+
+// Blurs one band of rows and compares against the target
+static void score_band(void* band_pointer)
+{
+	software_band_t* band = (software_band_t*)band_pointer;
+	const software_renderer_t* renderer = band->renderer;
+	software_state_t* state = band->state;
+	const float* downsampled = state->downsampled;
+	const float* kernel = renderer->kernel;
+	const int kernel_radius = renderer->kernel_radius;
+	const int kernel_size = (2 * kernel_radius) + 1;
+	const int width = APPLICATION_WIDTH;
+	float* down = band->down_row;
+	float* blurred = band->blurred_row;
+	const accumulate_row_t accumulate_row = get_accumulate_row();
+	const error_row_t error_row = get_error_row();
+	for (size_t row = band->row_begin; row < band->row_end; ++row)
+	{
+		// Down the columns, then across the row they make
+		for (int column = 0; column < width; ++column)
+		{
+			down[column] = 0.f;
+			blurred[column] = 0.f;
+		}
+		for (int kernel_row = 0; kernel_row < kernel_size; ++kernel_row)
+		{
+			const float weight = kernel[kernel_row];
+			const int source_row = wrap_index((int)row + kernel_row - kernel_radius, APPLICATION_HEIGHT);
+			accumulate_row(down, downsampled + ((size_t)source_row * width), weight, (size_t)width);
+		}
+
+		// Interior without wrapping, then the wrapped edges
+		for (int kernel_column = 0; kernel_column < kernel_size; ++kernel_column)
+		{
+			const float weight = kernel[kernel_column];
+			const int offset = kernel_column - kernel_radius;
+			if (width > 2 * kernel_radius)
+			{
+				accumulate_row(blurred + kernel_radius, down + kernel_radius + offset, weight, (size_t)(width - (2 * kernel_radius)));
+			}
+			for (int column = 0; column < kernel_radius; ++column)
+			{
+				blurred[column] += weight * down[wrap_index(column + offset, width)];
+				const int right = width - 1 - column;
+				blurred[right] += weight * down[wrap_index(right + offset, width)];
+			}
+		}
+
+		error_row(state->error + (row * width), blurred, renderer->target + (row * width), (size_t)width);
+	}
+}
+
+// On the pool, or one after another for serial renderers
+static void run_renderer_tasks(software_renderer_t* renderer, thread_function_t function, void* arguments, size_t stride, size_t count)
+{
+	if (!renderer->serial)
+	{
+		run_tasks(renderer->pool, function, arguments, stride, count);
+		return;
+	}
+
+	uint8_t* argument = (uint8_t*)arguments;
+	for (size_t i = 0; i < count; ++i, argument += stride)
+	{
+		function(argument);
+	}
+}
+
+static void run_bands(software_renderer_t* renderer, thread_function_t function)
+{
+	run_renderer_tasks(renderer, function, renderer->bands, sizeof(software_band_t), renderer->band_count);
+}
+
+void software_render_state(software_renderer_t* renderer, generation_t* generation, software_state_t* state)
+{
+	// Exported once here, since every band walks the whole strip
+	const nail_t* nails = get_generation_nails(generation);
+	size_t nail_count = get_generation_length(generation);
+	if (nails == NULL)
+	{
+		printf("Failed to export candidate nails.\n");
+		nail_count = 0;
+	}
+
+	const size_t band_count = renderer->band_count;
+	for (size_t i = 0; i < band_count; ++i)
+	{
+		software_band_t* band = &renderer->bands[i];
+		band->nails = nails;
+		band->nail_count = nail_count;
+		band->state = state;
+	}
+
+	// Blur reads neighbouring bands, so all rows must be drawn first
+	run_bands(renderer, &rasterize_band);
+	run_bands(renderer, &score_band);
+
+	// Summed separately so the score doesn't depend on the band split
+	state->score = (renderer->serial ? sum_floats(state->error, APPLICATION_PIXEL_COUNT) : sum_floats_parallel(renderer->pool, state->error, APPLICATION_PIXEL_COUNT));
+}
+
+void software_render_generation(software_renderer_t* renderer, generation_t* generation)
+{
+	software_render_state(renderer, generation, &renderer->state);
+	generation->score = renderer->state.score;
+}
+
+// Accumulates the coverage change of adding (sign 1) or removing (sign -1) a
+// chord, and marks the output pixels whose error it can change
+static FORCE_INLINE void gather_chord(software_renderer_t* renderer, software_scratch_t* scratch, const chord_t* chord, int sign, bool power_of_two)
+{
+	const chord_cache_t* chord_cache = &renderer->chord_cache;
+	const software_layout_t* layout = &renderer->layout;
+	chord_view_t view;
+	if (!get_chord(chord_cache, chord->start, chord->end, 0, TEXTURE_HEIGHT, &scratch->chord_buffer, &view))
+	{
+		return;
+	}
+
+	const uint8_t* coverage = view.coverage;
+	for (size_t i = 0; i < view.span_count; ++i)
+	{
+		const chord_span_t* span = &view.spans[i];
+		const uint32_t offset = ((uint32_t)span->row * layout->canvas_width) + span->column;
+		for (uint32_t j = 0; j < span->length; ++j)
+		{
+			const uint32_t index = offset + j;
+			if (!scratch->canvas_touched[index])
+			{
+				scratch->canvas_touched[index] = 1;
+				scratch->delta_log[index] = 0.f;
+				scratch->delta_opaque[index] = 0;
+				scratch->canvas_list[scratch->canvas_count++] = index;
+			}
+
+			const uint8_t level = coverage[j];
+			if (level == OPAQUE_COVERAGE)
+			{
+				scratch->delta_opaque[index] += (int16_t)sign;
+			}
+			else
+			{
+				scratch->delta_log[index] += (float)sign * chord_cache->log_transmittance[level];
+			}
+		}
+		coverage += span->length;
+	}
+
+	for (size_t i = 0; i < view.footprint_count; ++i)
+	{
+		const footprint_span_t* footprint = &view.footprints[i];
+		const uint32_t row = wrap_layout(footprint->row, layout->height, power_of_two);
+		for (int j = 0; j < (int)footprint->length; ++j)
+		{
+			const uint32_t column = wrap_layout(footprint->column + j, layout->width, power_of_two);
+			const uint32_t index = (row * layout->width) + column;
+			if (!(scratch->output_flags[index] & ERROR_AFFECTED))
+			{
+				scratch->output_flags[index] |= ERROR_AFFECTED;
+				scratch->error_list[scratch->error_count++] = index;
+			}
+		}
+	}
+}
+
+// Same sums in the same order as score_band, reading changed pixels from the scratch
+static FORCE_INLINE float blur_pixel
+(
+	const software_renderer_t* renderer,
+	const float* downsampled,
+	const software_scratch_t* scratch,
+	int row,
+	int column,
+	bool power_of_two
+)
+{
+	const software_layout_t* layout = &renderer->layout;
+	const float* kernel = renderer->kernel;
+	const int kernel_radius = renderer->kernel_radius;
+	const int kernel_size = (2 * kernel_radius) + 1;
+	const int width = (int)layout->width;
+	const int height = (int)layout->height;
+	const bool interior = (row >= kernel_radius) && (row < height - kernel_radius)
+		&& (column >= kernel_radius) && (column < width - kernel_radius);
+	float blurred = 0.f;
+	for (int kernel_column = 0; kernel_column < kernel_size; ++kernel_column)
+	{
+		const int offset_column = column + kernel_column - kernel_radius;
+		const int source_column = (interior ? offset_column : (int)wrap_layout(offset_column, layout->width, power_of_two));
+		float down = 0.f;
+		for (int kernel_row = 0; kernel_row < kernel_size; ++kernel_row)
+		{
+			const int offset_row = row + kernel_row - kernel_radius;
+			const int source_row = (interior ? offset_row : (int)wrap_layout(offset_row, layout->height, power_of_two));
+			const size_t index = ((size_t)source_row * layout->width) + (size_t)source_column;
+			const float value = ((scratch->output_flags[index] & DOWNSAMPLED_CHANGED) ? scratch->downsampled[index] : downsampled[index]);
+			down += kernel[kernel_row] * value;
+		}
+		blurred += kernel[kernel_column] * down;
+	}
+	return blurred;
+}
+
+// Scores the parent with the mutation applied, and writes the resulting
+// state to out if given. Only instantiated through the wrappers below.
+static FORCE_INLINE double evaluate_mutation
+(
+	software_renderer_t* renderer,
+	const software_state_t* parent,
+	const mutation_t* mutation,
+	software_state_t* out,
+	bool power_of_two
+)
+{
+	assert(renderer->scratch_count == get_worker_count(renderer->pool));
+	assert(renderer->layout.power_of_two || !power_of_two);
+	const software_layout_t* layout = &renderer->layout;
+	software_scratch_t* scratch = &renderer->scratches[get_worker_index(renderer->pool)];
+	for (size_t i = 0; i < mutation->removed_count; ++i)
+	{
+		gather_chord(renderer, scratch, &mutation->removed[i], -1, power_of_two);
+	}
+	for (size_t i = 0; i < mutation->added_count; ++i)
+	{
+		gather_chord(renderer, scratch, &mutation->added[i], 1, power_of_two);
+	}
+
+	// Output pixels whose box filter reads a changed canvas pixel
+	for (size_t i = 0; i < scratch->canvas_count; ++i)
+	{
+		const uint32_t canvas_index = scratch->canvas_list[i];
+		const uint32_t canvas_row = divide_layout(canvas_index, layout->canvas_width, layout->canvas_width_shift, power_of_two);
+		const uint32_t canvas_column = modulo_layout(canvas_index, layout->canvas_width, power_of_two);
+		const uint32_t row = divide_layout(canvas_row, layout->scale, layout->scale_shift, power_of_two);
+		const uint32_t column = divide_layout(canvas_column, layout->scale, layout->scale_shift, power_of_two);
+		const uint32_t index = (row * layout->width) + column;
+		if (!(scratch->output_flags[index] & DOWNSAMPLED_CHANGED))
+		{
+			scratch->output_flags[index] |= DOWNSAMPLED_CHANGED;
+			scratch->downsampled_list[scratch->downsampled_count++] = index;
+		}
+	}
+	for (size_t i = 0; i < scratch->downsampled_count; ++i)
+	{
+		const uint32_t index = scratch->downsampled_list[i];
+		const uint32_t row = divide_layout(index, layout->width, layout->width_shift, power_of_two);
+		const uint32_t column = modulo_layout(index, layout->width, power_of_two);
+		scratch->downsampled[index] = downsample_pixel(layout, parent, scratch, row, column);
+	}
+
+	// Updating the parent in place only writes what changed
+	if ((out != NULL) && (out != parent))
+	{
+		copy_software_state(parent, out);
+	}
+
+	double delta = 0.0;
+	for (size_t i = 0; i < scratch->error_count; ++i)
+	{
+		const uint32_t index = scratch->error_list[i];
+		const int row = (int)divide_layout(index, layout->width, layout->width_shift, power_of_two);
+		const int column = (int)modulo_layout(index, layout->width, power_of_two);
+		const float blurred = blur_pixel(renderer, parent->downsampled, scratch, row, column, power_of_two);
+		const float error = pixel_error(blurred, renderer->target[index]);
+		delta += (double)error - (double)parent->error[index];
+		if (out != NULL)
+		{
+			out->error[index] = error;
+		}
+	}
+	const double score = parent->score + delta;
+
+	if (out != NULL)
+	{
+		for (size_t i = 0; i < scratch->canvas_count; ++i)
+		{
+			const uint32_t index = scratch->canvas_list[i];
+			const int opaque_count = (int)out->opaque_count[index] + (int)scratch->delta_opaque[index];
+			assert(opaque_count >= 0);
+			out->log_transmittance[index] += scratch->delta_log[index];
+			out->opaque_count[index] = (uint16_t)opaque_count;
+		}
+		for (size_t i = 0; i < scratch->downsampled_count; ++i)
+		{
+			const uint32_t index = scratch->downsampled_list[i];
+			out->downsampled[index] = scratch->downsampled[index];
+		}
+		out->score = score;
+	}
+
+	// Leave the scratch clean for the next mutation
+	for (size_t i = 0; i < scratch->canvas_count; ++i)
+	{
+		scratch->canvas_touched[scratch->canvas_list[i]] = 0;
+	}
+	for (size_t i = 0; i < scratch->error_count; ++i)
+	{
+		scratch->output_flags[scratch->error_list[i]] = 0;
+	}
+	for (size_t i = 0; i < scratch->downsampled_count; ++i)
+	{
+		scratch->output_flags[scratch->downsampled_list[i]] = 0;
+	}
+	scratch->canvas_count = 0;
+	scratch->downsampled_count = 0;
+	scratch->error_count = 0;
+	return score;
+}
+
+// Picked at creation when every dimension is a power of two
+static double evaluate_mutation_power_of_two(software_renderer_t* renderer, const software_state_t* parent, const mutation_t* mutation, software_state_t* out)
+{
+	return evaluate_mutation(renderer, parent, mutation, out, true);
+}
+
+static double evaluate_mutation_generic(software_renderer_t* renderer, const software_state_t* parent, const mutation_t* mutation, software_state_t* out)
+{
+	return evaluate_mutation(renderer, parent, mutation, out, false);
+}
+
+double software_mutation_score(software_renderer_t* renderer, const software_state_t* parent, const mutation_t* mutation)
+{
+	return renderer->evaluate_mutation(renderer, parent, mutation, NULL);
+}
+
+void software_apply_mutation(software_renderer_t* renderer, software_state_t* state, const mutation_t* mutation)
+{
+	renderer->evaluate_mutation(renderer, state, mutation, state);
+}
+
+static void score_offspring(void* job_pointer)
+{
+	software_job_t* job = (software_job_t*)job_pointer;
+	generation_t* generation = job->generation;
+	generation->score = software_mutation_score(job->renderer, generation->parent_state, &generation->mutation);
+}
+
+void software_score_offspring(software_renderer_t* renderer, generation_t* candidates, size_t candidate_count)
+{
+	assert(candidate_count <= CANDIDATE_COUNT);
+	size_t job_count = 0;
+	for (size_t i = 0; i < candidate_count; ++i)
+	{
+		generation_t* candidate = &candidates[i];
+		if ((candidate->state == NULL) && (candidate->parent_state != NULL))
+		{
+			software_job_t* job = &renderer->jobs[job_count++];
+			job->renderer = renderer;
+			job->generation = candidate;
+		}
+	}
+	run_renderer_tasks(renderer, &score_offspring, renderer->jobs, sizeof(software_job_t), job_count);
+}
+
+static software_state_t* acquire_software_state(software_renderer_t* renderer)
+{
+	for (size_t i = 0; i < SOFTWARE_STATE_COUNT; ++i)
+	{
+		if (!renderer->state_used[i])
+		{
+			software_state_t* state = &renderer->states[i];
+			if (state->log_transmittance == NULL)
+			{
+				return NULL;
+			}
+			renderer->state_used[i] = true;
+			return state;
+		}
+	}
+	return NULL;
+}
+
+static void release_software_state(software_renderer_t* renderer, software_state_t* state)
+{
+	const size_t index = (size_t)(state - renderer->states);
+	assert(index < SOFTWARE_STATE_COUNT);
+	renderer->state_used[index] = false;
+}
+
+// Candidate past the survivors still holding the state, if any
+static generation_t* find_released_owner(generation_t* candidates, size_t survivor_count, size_t candidate_count, const software_state_t* state)
+{
+	for (size_t i = survivor_count; i < candidate_count; ++i)
+	{
+		if (candidates[i].state == state)
+		{
+			return &candidates[i];
+		}
+	}
+	return NULL;
+}
+
+bool update_software_states(software_renderer_t* renderer, generation_t* candidates, size_t candidate_count, bool refresh)
+{
+	// Survivors first, so parents are still held while children derive from them
+	const size_t survivor_count = (candidate_count < (size_t)FITTEST_COUNT ? candidate_count : (size_t)FITTEST_COUNT);
+	for (size_t i = 0; i < survivor_count; ++i)
+	{
+		generation_t* candidate = &candidates[i];
+		software_state_t* state = candidate->state;
+		const software_state_t* parent_state = candidate->parent_state;
+		if (state != NULL)
+		{
+			if (refresh)
+			{
+				software_render_state(renderer, candidate, state);
+			}
+		}
+		else if ((parent_state != NULL) && !refresh)
+		{
+			// Take over the parent's state if it died and no other survivor
+			// still has to derive from it
+			generation_t* owner = find_released_owner(candidates, survivor_count, candidate_count, parent_state);
+			bool shared = false;
+			for (size_t j = i + 1; j < survivor_count; ++j)
+			{
+				shared = shared || ((candidates[j].state == NULL) && (candidates[j].parent_state == parent_state));
+			}
+
+			if ((owner != NULL) && !shared)
+			{
+				state = owner->state;
+				owner->state = NULL;
+			}
+			else
+			{
+				state = acquire_software_state(renderer);
+				if (state == NULL)
+				{
+					printf("Failed to allocate incremental render state.\n");
+					return false;
+				}
+			}
+			renderer->evaluate_mutation(renderer, parent_state, &candidate->mutation, state);
+			candidate->state = state;
+		}
+		else
+		{
+			state = acquire_software_state(renderer);
+			if (state == NULL)
+			{
+				printf("Failed to allocate incremental render state.\n");
+				return false;
+			}
+			software_render_state(renderer, candidate, state);
+			candidate->state = state;
+		}
+		candidate->score = state->score;
+	}
+
+	for (size_t i = survivor_count; i < candidate_count; ++i)
+	{
+		generation_t* candidate = &candidates[i];
+		if (candidate->state != NULL)
+		{
+			release_software_state(renderer, candidate->state);
+			candidate->state = NULL;
+		}
+	}
+	for (size_t i = 0; i < candidate_count; ++i)
+	{
+		candidates[i].parent_state = NULL;
+	}
+	return true;
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "arena.h"
+#include "chord_cache.h"
+#include "generation.h"
+#include "image.h"
+#include "thread_pool.h"
+#include "vector2d.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Enough to hold every survivor and a replacement for each
+#define SOFTWARE_STATE_COUNT ((size_t)FITTEST_COUNT * 2)
+
+// Rendered line texture kept in a form lines can be added to and removed
+// from. Every line blends towards the same colour, so the canvas only
+// depends on the product of each line's (1 - coverage) at a pixel; that is
+// stored as a log sum plus a count of fully covered hits.
+typedef struct software_state
+{
+	float* log_transmittance;
+	uint16_t* opaque_count;
+
+	// Canvas box-filtered to APPLICATION_WIDTH x APPLICATION_HEIGHT
+	float* downsampled;
+
+	// Per-pixel error against the target and its sum
+	float* error;
+	double score;
+} software_state_t;
+
+// Scratch space for scoring a mutation against a parent's state
+typedef struct software_scratch
+{
+	// Canvas resolution changes, indexed by canvas pixel
+	float* delta_log;
+	int16_t* delta_opaque;
+	uint8_t* canvas_touched;
+	uint32_t* canvas_list;
+	size_t canvas_count;
+
+	// Output resolution changes, indexed by output pixel
+	float* downsampled;
+	uint8_t* output_flags;
+	uint32_t* downsampled_list;
+	size_t downsampled_count;
+	uint32_t* error_list;
+	size_t error_count;
+
+	// Uncached chords are rasterized here
+	chord_buffer_t chord_buffer;
+} software_scratch_t;
+
+// Index arithmetic at the configured resolution. Shifts and masks stand in
+// for division and wrapping when every dimension is a power of two.
+typedef struct software_layout
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t scale;
+	uint32_t canvas_width;
+	uint32_t width_shift;
+	uint32_t scale_shift;
+	uint32_t canvas_width_shift;
+	bool power_of_two;
+} software_layout_t;
+
+struct software_renderer;
+
+// Scores the parent with the mutation applied, writing the result to out if given
+typedef double (*software_evaluate_t)
+(
+	struct software_renderer* renderer,
+	const software_state_t* parent,
+	const mutation_t* mutation,
+	software_state_t* out
+);
+
+// Offspring scored on the pool
+typedef struct software_job
+{
+	struct software_renderer* renderer;
+	generation_t* generation;
+} software_job_t;
+
+// CPU implementation of the line, blur and difference passes so candidates
+// can be scored without a GL context.
+typedef struct software_renderer
+{
+	// Nail positions flipped into frame buffer row order
+	vector2d_t* vertices;
+	size_t vertex_count;
+
+	// Target image sampled at each output pixel centre
+	float* target;
+
+	// Separable blur weights, the GL kernel at output resolution
+	float* kernel;
+	int kernel_radius;
+
+	// Coverage of every chord, so lines are summed rather than rasterized
+	chord_cache_t chord_cache;
+
+	// State used when candidates are rendered from scratch
+	software_state_t state;
+
+	// States kept for survivors in incremental mode
+	software_state_t* states;
+	bool* state_used;
+
+	// One scratch per pool worker, so offspring can be scored in parallel
+	software_scratch_t* scratches;
+	size_t scratch_count;
+	software_job_t* jobs;
+
+	// Incremental scoring specialized for the resolution, picked at creation
+	software_layout_t layout;
+	software_evaluate_t evaluate_mutation;
+
+	// Full renders are split into horizontal bands, one per worker. Serial
+	// renderers are used from tasks already on the pool, so they run their
+	// work on the calling thread: waiting on the pool from inside a task runs
+	// other queued tasks on its stack.
+	thread_pool_t* pool;
+	bool serial;
+	size_t band_count;
+	struct software_band* bands;
+
+	// Backs every state, band row and scratch buffer above
+	arena_t arena;
+
+	// Cleared for renderers sharing another's vertices, target, kernel,
+	// chord cache and scratch
+	bool owns_tables;
+} software_renderer_t;
+
+software_state_t null_software_state(void);
+bool create_software_state(software_state_t* out);
+void destroy_software_state(software_state_t* state);
+
+software_renderer_t null_software_renderer(void);
+bool create_software_renderer
+(
+	const vector2d_t* vertices,
+	size_t vertex_count,
+	const image_t* target_image,
+	bool incremental,
+	bool huge_pages,
+	thread_pool_t* pool,
+	software_renderer_t* out
+);
+
+// Renderer with its own states that shares the source's tables, so several
+// populations can be scored at once. The source must outlive it.
+bool share_software_renderer(const software_renderer_t* source, bool serial, software_renderer_t* out);
+void destroy_software_renderer(software_renderer_t* renderer);
+
+// Renders the candidate from scratch and sets its score
+void software_render_generation(software_renderer_t* renderer, generation_t* generation);
+void software_render_state(software_renderer_t* renderer, generation_t* generation, software_state_t* state);
+
+// Score of the parent state with the mutation applied; only pixels under the
+// changed chords and their blur footprint are visited. The result is the
+// parent's score plus a delta over float state, so it drifts from a full
+// render between refreshes.
+double software_mutation_score(software_renderer_t* renderer, const software_state_t* parent, const mutation_t* mutation);
+
+// Applies the mutation to the state in place, updating its score
+void software_apply_mutation(software_renderer_t* renderer, software_state_t* state, const mutation_t* mutation);
+
+// Scores every candidate that has a parent state but none of its own
+void software_score_offspring(software_renderer_t* renderer, generation_t* candidates, size_t candidate_count);
+
+// Gives each of the first FITTEST_COUNT candidates its own state, deriving it
+// from the parent's when it has one, and frees the states of the rest.
+// States are rebuilt from scratch when refresh is set, to shed drift from
+// repeated updates.
+bool update_software_states(software_renderer_t* renderer, generation_t* candidates, size_t candidate_count, bool refresh);
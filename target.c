@@ -0,0 +1,582 @@
+#include "target.h"
+#include "reduce.h"
+#include "shared.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define X86_FILTER 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define TARGET(isa)
+#else
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+#else
+#define X86_FILTER 0
+#endif
+
+#define TARGET_CACHE_MAGIC "TCTI"
+#define TARGET_CACHE_VERSION 1
+#define TARGET_CACHE_NAME_FORMAT "target-%016llx.cache"
+
+// Long enough for the format with a 64-bit key
+#define TARGET_CACHE_NAME_LENGTH 64
+
+// FNV-1a
+#define HASH_OFFSET 14695981039346656037ull
+#define HASH_PRIME 1099511628211ull
+
+// Fills a cache line, so levels that follow stay aligned
+typedef struct target_cache_header
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t source_hash;
+	uint32_t width;
+	uint32_t height;
+	uint32_t srgb;
+	uint32_t level_count;
+	uint64_t pixel_count;
+	uint8_t padding[24];
+} target_cache_header_t;
+
+// Source texels weighed into every output texel along one axis. Each output
+// texel has up to tap_count weights, for the texels from its first on.
+typedef struct resample_axis
+{
+	int* firsts;
+	int* counts;
+	float* weights;
+	int tap_count;
+} resample_axis_t;
+
+// Rows of the output one task resamples, through a row of scratch as wide
+// as the source
+typedef struct resample_band
+{
+	const image_t* source;
+	image_t* output;
+	const resample_axis_t* across;
+	const resample_axis_t* down;
+	float* row;
+	int row_begin;
+	int row_end;
+} resample_band_t;
+
+// Rows of a level one task averages down from the level above
+typedef struct halve_band
+{
+	const image_t* source;
+	image_t* output;
+	int row_begin;
+	int row_end;
+} halve_band_t;
+
+// Adds a weighted source row into the scratch row
+typedef void (*accumulate_row_t)(float* row, const float* source, float weight, size_t count);
+
+// Averages pairs of pixels from two source rows into a row half as wide
+typedef void (*halve_row_t)(float* output, const float* top, const float* bottom, size_t count);
+
+target_t null_target(void)
+{
+	target_t result;
+	for (size_t i = 0; i < TARGET_MAXIMUM_LEVELS; ++i)
+	{
+		result.levels[i] = null_image();
+	}
+	result.level_count = 0;
+	result.file = null_mapped_file();
+	result.pixels = NULL;
+	return result;
+}
+
+static void accumulate_row_scalar(float* row, const float* source, float weight, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		row[i] += weight * source[i];
+	}
+}
+
+static void halve_row_scalar(float* output, const float* top, const float* bottom, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		output[i] = 0.25f * (top[2 * i] + top[(2 * i) + 1] + bottom[2 * i] + bottom[(2 * i) + 1]);
+	}
+}
+
+#if X86_FILTER
+TARGET("sse2")
+static void accumulate_row_sse2(float* row, const float* source, float weight, size_t count)
+{
+	const __m128 weights = _mm_set1_ps(weight);
+	const size_t whole_count = count - (count % 8);
+	for (size_t i = 0; i < whole_count; i += 8)
+	{
+		const __m128 source0 = _mm_loadu_ps(source + i);
+		const __m128 source1 = _mm_loadu_ps(source + i + 4);
+		_mm_storeu_ps(row + i, _mm_add_ps(_mm_loadu_ps(row + i), _mm_mul_ps(weights, source0)));
+		_mm_storeu_ps(row + i + 4, _mm_add_ps(_mm_loadu_ps(row + i + 4), _mm_mul_ps(weights, source1)));
+	}
+	accumulate_row_scalar(row + whole_count, source + whole_count, weight, count - whole_count);
+}
+
+TARGET("avx2")
+static void accumulate_row_avx2(float* row, const float* source, float weight, size_t count)
+{
+	const __m256 weights = _mm256_set1_ps(weight);
+	const size_t whole_count = count - (count % 16);
+	for (size_t i = 0; i < whole_count; i += 16)
+	{
+		const __m256 source0 = _mm256_loadu_ps(source + i);
+		const __m256 source1 = _mm256_loadu_ps(source + i + 8);
+		_mm256_storeu_ps(row + i, _mm256_add_ps(_mm256_loadu_ps(row + i), _mm256_mul_ps(weights, source0)));
+		_mm256_storeu_ps(row + i + 8, _mm256_add_ps(_mm256_loadu_ps(row + i + 8), _mm256_mul_ps(weights, source1)));
+	}
+	accumulate_row_scalar(row + whole_count, source + whole_count, weight, count - whole_count);
+}
+
+// Adds the rows, then splits even and odd columns apart to add those
+TARGET("sse2")
+static void halve_row_sse2(float* output, const float* top, const float* bottom, size_t count)
+{
+	const __m128 quarter = _mm_set1_ps(0.25f);
+	const size_t whole_count = count - (count % 4);
+	for (size_t i = 0; i < whole_count; i += 4)
+	{
+		const __m128 low = _mm_add_ps(_mm_loadu_ps(top + (2 * i)), _mm_loadu_ps(bottom + (2 * i)));
+		const __m128 high = _mm_add_ps(_mm_loadu_ps(top + (2 * i) + 4), _mm_loadu_ps(bottom + (2 * i) + 4));
+		const __m128 evens = _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0));
+		const __m128 odds = _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1));
+		_mm_storeu_ps(output + i, _mm_mul_ps(quarter, _mm_add_ps(evens, odds)));
+	}
+	halve_row_scalar(output + whole_count, top + (2 * whole_count), bottom + (2 * whole_count), count - whole_count);
+}
+#endif
+
+static accumulate_row_t get_accumulate_row(void)
+{
+	switch (get_simd_level())
+	{
+#if X86_FILTER
+		case SIMD_SSE2:
+			return &accumulate_row_sse2;
+
+		case SIMD_AVX2:
+		case SIMD_AVX512:
+			return &accumulate_row_avx2;
+#endif
+
+		default:
+			return &accumulate_row_scalar;
+	}
+}
+
+static halve_row_t get_halve_row(void)
+{
+#if X86_FILTER
+	if (get_simd_level() != SIMD_SCALAR)
+	{
+		return &halve_row_sse2;
+	}
+#endif
+	return &halve_row_scalar;
+}
+
+static void destroy_resample_axis(resample_axis_t* axis)
+{
+	free(axis->firsts);
+	free(axis->counts);
+	free(axis->weights);
+	axis->firsts = NULL;
+	axis->counts = NULL;
+	axis->weights = NULL;
+}
+
+static bool create_resample_axis(int source_size, int size, resample_axis_t* out)
+{
+	// Each output texel averages the source under its footprint, which is at
+	// least a texel wide so enlarging interpolates linearly
+	const double scale = (double)source_size / (double)size;
+	const double footprint = (scale > 1.0 ? scale : 1.0);
+	const int tap_count = (int)ceil(footprint) + 1;
+	out->tap_count = tap_count;
+	out->firsts = (int*)malloc((size_t)size * sizeof(int));
+	out->counts = (int*)malloc((size_t)size * sizeof(int));
+	out->weights = (float*)calloc((size_t)size * (size_t)tap_count, sizeof(float));
+	if ((out->firsts == NULL) || (out->counts == NULL) || (out->weights == NULL))
+	{
+		destroy_resample_axis(out);
+		return false;
+	}
+
+	for (int i = 0; i < size; ++i)
+	{
+		// Texels past the edges are dropped and the rest weighed up
+		const double centre = ((double)i + 0.5) * scale;
+		const double begin = centre - (0.5 * footprint);
+		const double end = centre + (0.5 * footprint);
+		int first = (int)floor(begin);
+		int last = first + tap_count - 1;
+		first = (first > 0 ? first : 0);
+		last = (last < (source_size - 1) ? last : (source_size - 1));
+
+		float* weights = out->weights + ((size_t)i * (size_t)tap_count);
+		double total = 0.0;
+		int count = 0;
+		for (int texel = first; texel <= last; ++texel, ++count)
+		{
+			const double left = (begin > (double)texel ? begin : (double)texel);
+			const double right = (end < (double)(texel + 1) ? end : (double)(texel + 1));
+			const double overlap = (right > left ? right - left : 0.0);
+			weights[count] = (float)overlap;
+			total += overlap;
+		}
+		for (int j = 0; j < count; ++j)
+		{
+			weights[j] = (float)((double)weights[j] / total);
+		}
+		out->firsts[i] = first;
+		out->counts[i] = count;
+	}
+	return true;
+}
+
+static void resample_band(void* argument)
+{
+	const resample_band_t* band = (const resample_band_t*)argument;
+	const image_t* source = band->source;
+	const image_t* output = band->output;
+	const resample_axis_t* across = band->across;
+	const resample_axis_t* down = band->down;
+	const accumulate_row_t accumulate_row = get_accumulate_row();
+	const size_t source_width = (size_t)source->width;
+	float* row = band->row;
+	for (int y = band->row_begin; y < band->row_end; ++y)
+	{
+		// Down first, over whole source rows, then across the one row
+		const float* down_weights = down->weights + ((size_t)y * (size_t)down->tap_count);
+		memset(row, 0, source_width * sizeof(float));
+		for (int i = 0; i < down->counts[y]; ++i)
+		{
+			const float* source_row = source->pixels + ((size_t)(down->firsts[y] + i) * source_width);
+			accumulate_row(row, source_row, down_weights[i], source_width);
+		}
+
+		float* output_row = output->pixels + ((size_t)y * (size_t)output->width);
+		for (int x = 0; x < output->width; ++x)
+		{
+			const float* across_weights = across->weights + ((size_t)x * (size_t)across->tap_count);
+			const float* taps = row + across->firsts[x];
+			float sum = 0.f;
+			for (int i = 0; i < across->counts[x]; ++i)
+			{
+				sum += across_weights[i] * taps[i];
+			}
+			output_row[x] = sum;
+		}
+	}
+}
+
+static void halve_band(void* argument)
+{
+	const halve_band_t* band = (const halve_band_t*)argument;
+	const image_t* source = band->source;
+	const image_t* output = band->output;
+	const halve_row_t halve_row = get_halve_row();
+	const size_t source_width = (size_t)source->width;
+	for (int y = band->row_begin; y < band->row_end; ++y)
+	{
+		// Levels a pixel high or wide repeat it rather than reach past it
+		const int top_row = 2 * y;
+		const int bottom_row = (source->height > 1 ? top_row + 1 : top_row);
+		const float* top = source->pixels + ((size_t)top_row * source_width);
+		const float* bottom = source->pixels + ((size_t)bottom_row * source_width);
+		float* output_row = output->pixels + ((size_t)y * (size_t)output->width);
+		if (source->width > 1)
+		{
+			halve_row(output_row, top, bottom, (size_t)output->width);
+		}
+		else
+		{
+			output_row[0] = 0.5f * (top[0] + bottom[0]);
+		}
+	}
+}
+
+// Sizes every level from the application size down to a pixel, like
+// glGenerateMipmap, and counts the pixels of all of them
+static int layout_levels(image_t* levels, size_t* pixel_count)
+{
+	int width = APPLICATION_WIDTH;
+	int height = APPLICATION_HEIGHT;
+	int level_count = 0;
+	*pixel_count = 0;
+	while (level_count < TARGET_MAXIMUM_LEVELS)
+	{
+		levels[level_count].width = width;
+		levels[level_count].height = height;
+		levels[level_count].pixels = NULL;
+		*pixel_count += (size_t)width * (size_t)height;
+		++level_count;
+		if ((width == 1) && (height == 1))
+		{
+			break;
+		}
+		width = (width > 1 ? width / 2 : 1);
+		height = (height > 1 ? height / 2 : 1);
+	}
+	return level_count;
+}
+
+static void place_levels(target_t* target, float* pixels)
+{
+	for (int i = 0; i < target->level_count; ++i)
+	{
+		image_t* level = &target->levels[i];
+		level->pixels = pixels;
+		pixels += (size_t)level->width * (size_t)level->height;
+	}
+}
+
+// Rows split evenly over the pool, at most a band per row
+static size_t get_band_count(thread_pool_t* pool, int row_count)
+{
+	const size_t worker_count = get_worker_count(pool);
+	return (worker_count < (size_t)row_count ? worker_count : (size_t)row_count);
+}
+
+static bool resample_image(const image_t* source, image_t* output, thread_pool_t* pool)
+{
+	resample_axis_t across;
+	resample_axis_t down;
+	if (!create_resample_axis(source->width, output->width, &across))
+	{
+		return false;
+	}
+	else if (!create_resample_axis(source->height, output->height, &down))
+	{
+		destroy_resample_axis(&across);
+		return false;
+	}
+
+	const size_t band_count = get_band_count(pool, output->height);
+	resample_band_t* bands = (resample_band_t*)malloc(band_count * sizeof(resample_band_t));
+	float* rows = (float*)malloc(band_count * (size_t)source->width * sizeof(float));
+	const bool success = ((bands != NULL) && (rows != NULL));
+	if (success)
+	{
+		for (size_t i = 0; i < band_count; ++i)
+		{
+			resample_band_t* band = &bands[i];
+			band->source = source;
+			band->output = output;
+			band->across = &across;
+			band->down = &down;
+			band->row = rows + (i * (size_t)source->width);
+			band->row_begin = (int)((i * (size_t)output->height) / band_count);
+			band->row_end = (int)(((i + 1) * (size_t)output->height) / band_count);
+		}
+		run_tasks(pool, &resample_band, bands, sizeof(resample_band_t), band_count);
+	}
+	free(rows);
+	free(bands);
+	destroy_resample_axis(&down);
+	destroy_resample_axis(&across);
+	return success;
+}
+
+static bool halve_level(const image_t* source, image_t* output, thread_pool_t* pool)
+{
+	const size_t band_count = get_band_count(pool, output->height);
+	halve_band_t* bands = (halve_band_t*)malloc(band_count * sizeof(halve_band_t));
+	if (bands == NULL)
+	{
+		return false;
+	}
+	for (size_t i = 0; i < band_count; ++i)
+	{
+		halve_band_t* band = &bands[i];
+		band->source = source;
+		band->output = output;
+		band->row_begin = (int)((i * (size_t)output->height) / band_count);
+		band->row_end = (int)(((i + 1) * (size_t)output->height) / band_count);
+	}
+	run_tasks(pool, &halve_band, bands, sizeof(halve_band_t), band_count);
+	free(bands);
+	return true;
+}
+
+bool create_target(const image_t* source, thread_pool_t* pool, target_t* out)
+{
+	*out = null_target();
+	size_t pixel_count;
+	out->level_count = layout_levels(out->levels, &pixel_count);
+	out->pixels = (float*)malloc(pixel_count * sizeof(float));
+	if (out->pixels == NULL)
+	{
+		printf("Failed to allocate target levels.\n");
+		return false;
+	}
+	place_levels(out, out->pixels);
+
+	bool success = resample_image(source, &out->levels[0], pool);
+	for (int i = 1; success && (i < out->level_count); ++i)
+	{
+		success = halve_level(&out->levels[i - 1], &out->levels[i], pool);
+	}
+	if (!success)
+	{
+		printf("Failed to prepare target.\n");
+		destroy_target(out);
+		return false;
+	}
+	return true;
+}
+
+void destroy_target(target_t* target)
+{
+	unmap_file(&target->file);
+	free(target->pixels);
+	*target = null_target();
+}
+
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= HASH_PRIME;
+	}
+	return hash;
+}
+
+static target_cache_header_t expected_header(uint64_t source_hash, bool srgb)
+{
+	image_t levels[TARGET_MAXIMUM_LEVELS];
+	size_t pixel_count;
+	target_cache_header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TARGET_CACHE_MAGIC, sizeof(header.magic));
+	header.version = TARGET_CACHE_VERSION;
+	header.source_hash = source_hash;
+	header.width = APPLICATION_WIDTH;
+	header.height = APPLICATION_HEIGHT;
+	header.srgb = (srgb ? 1 : 0);
+	header.level_count = (uint32_t)layout_levels(levels, &pixel_count);
+	header.pixel_count = pixel_count;
+	return header;
+}
+
+// Named after everything in the header, so changing a setting picks another
+// file instead of replacing the one other runs use
+static void get_cache_filename(const target_cache_header_t* header, char* out)
+{
+	const uint64_t key = hash_bytes(HASH_OFFSET, header, sizeof(target_cache_header_t));
+	snprintf(out, TARGET_CACHE_NAME_LENGTH, TARGET_CACHE_NAME_FORMAT, (unsigned long long)key);
+}
+
+static bool map_target_cache(const char* filename, const target_cache_header_t* expected, target_t* out)
+{
+	*out = null_target();
+	if (!map_file(filename, &out->file))
+	{
+		return false;
+	}
+
+	// A matching header fixes the size of everything after it
+	const size_t data_size = (size_t)expected->pixel_count * sizeof(float);
+	if ((out->file.length != (sizeof(target_cache_header_t) + data_size))
+		|| (memcmp(out->file.data, expected, sizeof(target_cache_header_t)) != 0))
+	{
+		printf("Target cache %s doesn't match, rebuilding.\n", filename);
+		destroy_target(out);
+		return false;
+	}
+	size_t pixel_count;
+	out->level_count = layout_levels(out->levels, &pixel_count);
+	place_levels(out, (float*)((const uint8_t*)out->file.data + sizeof(target_cache_header_t)));
+	return true;
+}
+
+static bool save_target_cache(const target_t* target, const target_cache_header_t* header, const char* filename)
+{
+	// Write next to the destination and move into place so readers never see
+	// a partial file; named for the process, as others may prepare the same
+	// image at once
+	char temporary_filename[TARGET_CACHE_NAME_LENGTH + 32];
+	snprintf(temporary_filename, sizeof(temporary_filename), "%s.%lu.tmp", filename, get_process_id());
+	FILE* file = fopen(temporary_filename, "wb");
+	if (file == NULL)
+	{
+		printf("Failed to open %s for write.\n", temporary_filename);
+		return false;
+	}
+
+	const size_t pixel_count = (size_t)header->pixel_count;
+	bool success = (fwrite(header, sizeof(target_cache_header_t), 1, file) == 1)
+		&& (fwrite(target->pixels, sizeof(float), pixel_count, file) == pixel_count);
+	success = (fclose(file) == 0) && success;
+
+	// POSIX rename replaces the destination atomically; Windows needs it gone
+	if (success)
+	{
+#if defined(WIN32)
+		remove(filename);
+#endif
+		success = (rename(temporary_filename, filename) == 0);
+	}
+	if (!success)
+	{
+		printf("Failed to write target cache %s.\n", filename);
+		remove(temporary_filename);
+	}
+	return success;
+}
+
+bool load_target(const char* filename, bool srgb, thread_pool_t* pool, target_t* out)
+{
+	*out = null_target();
+
+	// Hash the encoded file, which is much smaller than what it decodes to
+	mapped_file_t source_file = null_mapped_file();
+	if (!map_file(filename, &source_file))
+	{
+		printf("Failed to open target image %s.\n", filename);
+		return false;
+	}
+	const uint64_t source_hash = hash_bytes(HASH_OFFSET, source_file.data, source_file.length);
+	unmap_file(&source_file);
+
+	const target_cache_header_t header = expected_header(source_hash, srgb);
+	char cache_filename[TARGET_CACHE_NAME_LENGTH];
+	get_cache_filename(&header, cache_filename);
+	if (map_target_cache(cache_filename, &header, out))
+	{
+		printf("Loaded target from %s.\n", cache_filename);
+		return true;
+	}
+
+	image_t source = null_image();
+	if (!load_image(filename, srgb, pool, &source))
+	{
+		return false;
+	}
+	const bool success = create_target(&source, pool, out);
+	destroy_image(&source);
+	if (!success)
+	{
+		return false;
+	}
+
+	// Runs go on without the cache if it can't be written
+	save_target_cache(out, &header, cache_filename);
+	return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "file_io.h"
+#include "image.h"
+#include "thread_pool.h"
+#include <stdbool.h>
+
+#define SRGB_ARGUMENT "--srgb"
+
+// Levels down to a single pixel from any size the config allows
+#define TARGET_MAXIMUM_LEVELS 16
+
+// Target image as scored: greyscale, resampled to the application size, with
+// every level below it halved like a mipmap chain. Preparing one is cached in
+// a file named after a hash of the source image and the settings, which is
+// mapped as is on later runs.
+typedef struct target
+{
+	image_t levels[TARGET_MAXIMUM_LEVELS];
+	int level_count;
+
+	// Levels point into the mapped cache if it was loaded, otherwise into
+	// pixels. Mapped levels are read only.
+	mapped_file_t file;
+	float* pixels;
+} target_t;
+
+target_t null_target(void);
+
+// Loads the prepared target from its cache, or decodes the image, prepares
+// it on the pool and writes the cache
+bool load_target(const char* filename, bool srgb, thread_pool_t* pool, target_t* out);
+
+// Resamples a decoded image to the application size and builds its levels
+bool create_target(const image_t* source, thread_pool_t* pool, target_t* out);
+void destroy_target(target_t* target);
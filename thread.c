@@ -0,0 +1,190 @@
+#if !defined(WIN32)
+#define _GNU_SOURCE
+#endif
+#include "thread.h"
+#include <assert.h>
+#if !defined(WIN32)
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#if defined(WIN32)
+static DWORD WINAPI run_thread(LPVOID thread_pointer)
+#else
+static void* run_thread(void* thread_pointer)
+#endif
+{
+	thread_t* thread = (thread_t*)thread_pointer;
+	thread->function(thread->argument);
+
+#if defined(WIN32)
+	return 0;
+#else
+	return NULL;
+#endif
+}
+
+bool start_thread(thread_t* thread, thread_function_t function, void* argument)
+{
+	thread->function = function;
+	thread->argument = argument;
+#if defined(WIN32)
+	HANDLE thread_handle = CreateThread(NULL, 0, &run_thread, thread, 0, NULL);
+	if (thread_handle == NULL)
+	{
+		return false;
+	}
+	thread->handle = thread_handle;
+#else
+	const int result = pthread_create(&thread->handle, NULL, &run_thread, thread);
+	if (result != 0)
+	{
+		return false;
+	}
+#endif
+	return true;
+}
+
+void join_thread(thread_t* thread)
+{
+#if defined(WIN32)
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+#else
+	const int result = pthread_join(thread->handle, NULL);
+	assert(result == 0);
+	(void)result;
+#endif
+}
+
+bool pin_current_thread(size_t processor)
+{
+#if defined(WIN32)
+	const DWORD_PTR mask = (DWORD_PTR)1 << (processor % (sizeof(DWORD_PTR) * 8));
+	return (SetThreadAffinityMask(GetCurrentThread(), mask) != 0);
+#else
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(processor % CPU_SETSIZE, &set);
+	return (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0);
+#endif
+}
+
+bool create_mutex(mutex_t* mutex)
+{
+#if defined(WIN32)
+	InitializeCriticalSection(&mutex->handle);
+	return true;
+#else
+	return (pthread_mutex_init(&mutex->handle, NULL) == 0);
+#endif
+}
+
+void destroy_mutex(mutex_t* mutex)
+{
+#if defined(WIN32)
+	DeleteCriticalSection(&mutex->handle);
+#else
+	pthread_mutex_destroy(&mutex->handle);
+#endif
+}
+
+void lock_mutex(mutex_t* mutex)
+{
+#if defined(WIN32)
+	EnterCriticalSection(&mutex->handle);
+#else
+	const int result = pthread_mutex_lock(&mutex->handle);
+	assert(result == 0);
+	(void)result;
+#endif
+}
+
+void unlock_mutex(mutex_t* mutex)
+{
+#if defined(WIN32)
+	LeaveCriticalSection(&mutex->handle);
+#else
+	const int result = pthread_mutex_unlock(&mutex->handle);
+	assert(result == 0);
+	(void)result;
+#endif
+}
+
+bool create_condition(condition_t* condition)
+{
+#if defined(WIN32)
+	InitializeConditionVariable(&condition->handle);
+	return true;
+#else
+	return (pthread_cond_init(&condition->handle, NULL) == 0);
+#endif
+}
+
+void destroy_condition(condition_t* condition)
+{
+#if defined(WIN32)
+	(void)condition;
+#else
+	pthread_cond_destroy(&condition->handle);
+#endif
+}
+
+void wait_condition(condition_t* condition, mutex_t* mutex)
+{
+#if defined(WIN32)
+	SleepConditionVariableCS(&condition->handle, &mutex->handle, INFINITE);
+#else
+	const int result = pthread_cond_wait(&condition->handle, &mutex->handle);
+	assert(result == 0);
+	(void)result;
+#endif
+}
+
+void broadcast_condition(condition_t* condition)
+{
+#if defined(WIN32)
+	WakeAllConditionVariable(&condition->handle);
+#else
+	pthread_cond_broadcast(&condition->handle);
+#endif
+}
+
+long add_atomic(volatile long* value, long amount)
+{
+#if defined(WIN32)
+	return InterlockedExchangeAdd(value, amount) + amount;
+#else
+	return __atomic_add_fetch(value, amount, __ATOMIC_ACQ_REL);
+#endif
+}
+
+long load_atomic(volatile long* value)
+{
+#if defined(WIN32)
+	return InterlockedCompareExchange(value, 0, 0);
+#else
+	return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+void store_atomic(volatile long* value, long desired)
+{
+#if defined(WIN32)
+	InterlockedExchange(value, desired);
+#else
+	__atomic_store_n(value, desired, __ATOMIC_RELEASE);
+#endif
+}
+
+size_t get_processor_count(void)
+{
+#if defined(WIN32)
+	SYSTEM_INFO system_info;
+	GetSystemInfo(&system_info);
+	const long count = (long)system_info.dwNumberOfProcessors;
+#else
+	const long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return (count > 0 ? (size_t)count : 1);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#if defined(WIN32)
+#include <Windows.h>
+#else
+#include <pthread.h>
+#endif
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef void (*thread_function_t)(void* argument);
+
+// Portable wrapper around an OS thread
+typedef struct thread
+{
+#if defined(WIN32)
+	HANDLE handle;
+#else
+	pthread_t handle;
+#endif
+	thread_function_t function;
+	void* argument;
+} thread_t;
+
+typedef struct mutex
+{
+#if defined(WIN32)
+	CRITICAL_SECTION handle;
+#else
+	pthread_mutex_t handle;
+#endif
+} mutex_t;
+
+typedef struct condition
+{
+#if defined(WIN32)
+	CONDITION_VARIABLE handle;
+#else
+	pthread_cond_t handle;
+#endif
+} condition_t;
+
+bool start_thread(thread_t* thread, thread_function_t function, void* argument);
+void join_thread(thread_t* thread);
+
+// Restricts the calling thread to one logical processor
+bool pin_current_thread(size_t processor);
+
+bool create_mutex(mutex_t* mutex);
+void destroy_mutex(mutex_t* mutex);
+void lock_mutex(mutex_t* mutex);
+void unlock_mutex(mutex_t* mutex);
+
+bool create_condition(condition_t* condition);
+void destroy_condition(condition_t* condition);
+void wait_condition(condition_t* condition, mutex_t* mutex);
+void broadcast_condition(condition_t* condition);
+
+// Atomically adds to the value and returns the result
+long add_atomic(volatile long* value, long amount);
+long load_atomic(volatile long* value);
+
+// Atomically replaces the value; writes before it are seen by loads that see it
+void store_atomic(volatile long* value, long desired);
+
+// Number of logical processors available to this process
+size_t get_processor_count(void);
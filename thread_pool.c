@@ -0,0 +1,292 @@
+#include "thread_pool.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(WIN32)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+// Worker the current thread belongs to, if any
+static THREAD_LOCAL const thread_pool_worker_t* current_worker = NULL;
+
+static bool push_task(task_queue_t* queue, const task_t* task)
+{
+	lock_mutex(&queue->lock);
+	const bool pushed = ((queue->tail - queue->head) < TASK_QUEUE_CAPACITY);
+	if (pushed)
+	{
+		queue->tasks[queue->tail % TASK_QUEUE_CAPACITY] = *task;
+		++queue->tail;
+	}
+	unlock_mutex(&queue->lock);
+	return pushed;
+}
+
+static bool pop_task(task_queue_t* queue, task_t* out)
+{
+	lock_mutex(&queue->lock);
+	const bool popped = (queue->tail != queue->head);
+	if (popped)
+	{
+		--queue->tail;
+		*out = queue->tasks[queue->tail % TASK_QUEUE_CAPACITY];
+	}
+	unlock_mutex(&queue->lock);
+	return popped;
+}
+
+static bool steal_task(task_queue_t* queue, task_t* out)
+{
+	lock_mutex(&queue->lock);
+	const bool stolen = (queue->tail != queue->head);
+	if (stolen)
+	{
+		*out = queue->tasks[queue->head % TASK_QUEUE_CAPACITY];
+		++queue->head;
+	}
+	unlock_mutex(&queue->lock);
+	return stolen;
+}
+
+// Takes the newest task of the worker's own queue, or steals the oldest of
+// another's
+static bool take_task(thread_pool_t* pool, size_t index, task_t* out)
+{
+	if (load_atomic(&pool->queued_count) <= 0)
+	{
+		return false;
+	}
+
+	bool taken = pop_task(&pool->queues[index], out);
+	for (size_t i = 1; !taken && (i < pool->queue_count); ++i)
+	{
+		taken = steal_task(&pool->queues[(index + i) % pool->queue_count], out);
+	}
+	if (taken)
+	{
+		add_atomic(&pool->queued_count, -1);
+	}
+	return taken;
+}
+
+static void run_task(thread_pool_t* pool, const task_t* task)
+{
+	task->function(task->argument);
+	if (add_atomic(&task->group->pending, -1) == 0)
+	{
+		lock_mutex(&pool->lock);
+		broadcast_condition(&pool->changed);
+		unlock_mutex(&pool->lock);
+	}
+}
+
+static void run_worker(void* worker_pointer)
+{
+	thread_pool_worker_t* worker = (thread_pool_worker_t*)worker_pointer;
+	thread_pool_t* pool = worker->pool;
+	current_worker = worker;
+	if (pool->pin_threads)
+	{
+		pin_current_thread(worker->index + 1);
+	}
+
+	for (;;)
+	{
+		task_t task;
+		if (take_task(pool, worker->index, &task))
+		{
+			run_task(pool, &task);
+			continue;
+		}
+
+		lock_mutex(&pool->lock);
+		while ((load_atomic(&pool->queued_count) <= 0) && !pool->stopping)
+		{
+			wait_condition(&pool->changed, &pool->lock);
+		}
+		const bool stopping = pool->stopping;
+		unlock_mutex(&pool->lock);
+		if (stopping)
+		{
+			break;
+		}
+	}
+}
+
+thread_pool_t null_thread_pool(void)
+{
+	thread_pool_t result;
+	result.workers = NULL;
+	result.thread_count = 0;
+	result.queues = NULL;
+	result.queue_count = 0;
+	result.queued_count = 0;
+	result.stopping = false;
+	result.pin_threads = false;
+	return result;
+}
+
+bool create_thread_pool(size_t worker_count, bool pin_threads, thread_pool_t* out)
+{
+	*out = null_thread_pool();
+	const size_t thread_count = (worker_count > 1 ? worker_count - 1 : 0);
+	out->pin_threads = pin_threads;
+	out->queues = (task_queue_t*)calloc(thread_count + 1, sizeof(task_queue_t));
+	out->workers = (thread_pool_worker_t*)calloc(thread_count > 0 ? thread_count : 1, sizeof(thread_pool_worker_t));
+	if ((out->queues == NULL) || (out->workers == NULL))
+	{
+		free(out->queues);
+		free(out->workers);
+		*out = null_thread_pool();
+		printf("Failed to allocate thread pool.\n");
+		return false;
+	}
+
+	if (!create_mutex(&out->lock) || !create_condition(&out->changed))
+	{
+		free(out->queues);
+		free(out->workers);
+		*out = null_thread_pool();
+		printf("Failed to create thread pool lock.\n");
+		return false;
+	}
+
+	// Destroying a partly created pool only releases what was created
+	for (size_t i = 0; i < thread_count + 1; ++i)
+	{
+		if (!create_mutex(&out->queues[i].lock))
+		{
+			destroy_thread_pool(out);
+			printf("Failed to create task queue lock.\n");
+			return false;
+		}
+		++out->queue_count;
+	}
+
+	if (pin_threads)
+	{
+		pin_current_thread(0);
+	}
+	for (size_t i = 0; i < thread_count; ++i)
+	{
+		thread_pool_worker_t* worker = &out->workers[i];
+		worker->pool = out;
+		worker->index = i;
+		worker->started = start_thread(&worker->thread, &run_worker, worker);
+		if (!worker->started)
+		{
+			destroy_thread_pool(out);
+			printf("Failed to start thread pool worker.\n");
+			return false;
+		}
+		++out->thread_count;
+	}
+
+	printf("Thread pool using %d threads.\n", (int)get_worker_count(out));
+	return true;
+}
+
+void destroy_thread_pool(thread_pool_t* pool)
+{
+	if (pool->queues != NULL)
+	{
+		lock_mutex(&pool->lock);
+		pool->stopping = true;
+		broadcast_condition(&pool->changed);
+		unlock_mutex(&pool->lock);
+		for (size_t i = 0; i < pool->thread_count; ++i)
+		{
+			if (pool->workers[i].started)
+			{
+				join_thread(&pool->workers[i].thread);
+			}
+		}
+		for (size_t i = 0; i < pool->queue_count; ++i)
+		{
+			destroy_mutex(&pool->queues[i].lock);
+		}
+		destroy_condition(&pool->changed);
+		destroy_mutex(&pool->lock);
+	}
+	free(pool->queues);
+	free(pool->workers);
+	*pool = null_thread_pool();
+}
+
+size_t get_worker_count(const thread_pool_t* pool)
+{
+	return pool->thread_count + 1;
+}
+
+size_t get_worker_index(const thread_pool_t* pool)
+{
+	const thread_pool_worker_t* worker = current_worker;
+	if ((worker != NULL) && (worker->pool == pool))
+	{
+		return worker->index;
+	}
+	return pool->thread_count;
+}
+
+task_group_t null_task_group(void)
+{
+	task_group_t result;
+	result.pending = 0;
+	return result;
+}
+
+void submit_task(thread_pool_t* pool, task_group_t* group, thread_function_t function, void* argument)
+{
+	task_t task;
+	task.function = function;
+	task.argument = argument;
+	task.group = group;
+
+	// Nothing to share with, or the queue is full
+	add_atomic(&group->pending, 1);
+	if ((pool->thread_count == 0) || !push_task(&pool->queues[get_worker_index(pool)], &task))
+	{
+		run_task(pool, &task);
+		return;
+	}
+
+	add_atomic(&pool->queued_count, 1);
+	lock_mutex(&pool->lock);
+	broadcast_condition(&pool->changed);
+	unlock_mutex(&pool->lock);
+}
+
+void wait_task_group(thread_pool_t* pool, task_group_t* group)
+{
+	const size_t index = get_worker_index(pool);
+	while (load_atomic(&group->pending) > 0)
+	{
+		task_t task;
+		if (take_task(pool, index, &task))
+		{
+			run_task(pool, &task);
+			continue;
+		}
+
+		lock_mutex(&pool->lock);
+		while ((load_atomic(&group->pending) > 0) && (load_atomic(&pool->queued_count) <= 0))
+		{
+			wait_condition(&pool->changed, &pool->lock);
+		}
+		unlock_mutex(&pool->lock);
+	}
+}
+
+void run_tasks(thread_pool_t* pool, thread_function_t function, void* arguments, size_t stride, size_t count)
+{
+	task_group_t group = null_task_group();
+	uint8_t* argument = (uint8_t*)arguments;
+	for (size_t i = 0; i < count; ++i, argument += stride)
+	{
+		submit_task(pool, &group, function, argument);
+	}
+	wait_task_group(pool, &group);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "thread.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Tasks one queue holds; submissions past it run on the submitting thread
+#define TASK_QUEUE_CAPACITY 1024
+
+// Tasks that are waited on together
+typedef struct task_group
+{
+	volatile long pending;
+} task_group_t;
+
+typedef struct task
+{
+	thread_function_t function;
+	void* argument;
+	task_group_t* group;
+} task_t;
+
+// Owner pushes and pops the newest end; other workers steal the oldest
+typedef struct task_queue
+{
+	mutex_t lock;
+	task_t tasks[TASK_QUEUE_CAPACITY];
+	size_t head;
+	size_t tail;
+} task_queue_t;
+
+typedef struct thread_pool_worker
+{
+	struct thread_pool* pool;
+	size_t index;
+	thread_t thread;
+	bool started;
+} thread_pool_worker_t;
+
+// Persistent threads sharing submitted tasks by work stealing. Threads
+// waiting on a group run queued tasks until it completes, so the thread that
+// created the pool works as one more worker. Workers keep a pointer to the
+// pool, so it must not move once created.
+typedef struct thread_pool
+{
+	thread_pool_worker_t* workers;
+	size_t thread_count;
+
+	// One queue per pool thread, then one for threads outside the pool
+	task_queue_t* queues;
+	size_t queue_count;
+
+	// Wakes idle threads when tasks are queued or a group completes
+	mutex_t lock;
+	condition_t changed;
+	volatile long queued_count;
+	bool stopping;
+	bool pin_threads;
+} thread_pool_t;
+
+thread_pool_t null_thread_pool(void);
+
+// Starts worker_count - 1 threads, since the creating thread helps. Workers
+// are pinned to one processor each if requested.
+bool create_thread_pool(size_t worker_count, bool pin_threads, thread_pool_t* out);
+void destroy_thread_pool(thread_pool_t* pool);
+
+// Number of threads that can run tasks, including the creating thread
+size_t get_worker_count(const thread_pool_t* pool);
+
+// Index of the calling thread in [0, worker count), for per-worker scratch.
+// Every thread outside the pool shares the last index.
+size_t get_worker_index(const thread_pool_t* pool);
+
+task_group_t null_task_group(void);
+void submit_task(thread_pool_t* pool, task_group_t* group, thread_function_t function, void* argument);
+
+// Runs queued tasks until every task in the group has finished
+void wait_task_group(thread_pool_t* pool, task_group_t* group);
+
+// Runs the function on count arguments spaced stride bytes apart and waits
+void run_tasks(thread_pool_t* pool, thread_function_t function, void* arguments, size_t stride, size_t count);